@@ -0,0 +1,331 @@
+/*
+ * alsa-hotplug.c - follow a card across unplug/replug, see alsa-hotplug.h.
+ *
+ * Deviation from pipewire: alsa-udev.c receives add/remove events from
+ * libudev and recreates the SPA device; the test has no udev, so inotify
+ * on /dev/snd and raw kernel uevents only wake the wait loop, and the
+ * card list is rescanned with snd_card_next() on every wakeup. A periodic
+ * rescan covers sandboxes where neither event source is available.
+ */
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "alsa-hotplug.h"
+
+/* fallback rescan interval when no event arrives */
+#define HOTPLUG_RESCAN_MS 500
+
+/* split "hw:N,D" / "plughw:CARD=id,DEV=D" around the card token and
+ * return the card index (negative errno if it does not name a card) */
+static int split_dev_name(struct hotplug_ident *id, const char *dev) {
+	const char *colon = strchr(dev, ':');
+	if (colon == NULL)
+		return -EINVAL;
+
+	size_t plen = (size_t) (colon - dev) + 1;
+	if (plen >= sizeof(id->prefix))
+		return -EINVAL;
+	memcpy(id->prefix, dev, plen);
+	id->prefix[plen] = '\0';
+
+	const char *card = colon + 1;
+	id->card_key[0] = '\0';
+	if (strncmp(card, "CARD=", 5) == 0) {
+		snprintf(id->card_key, sizeof(id->card_key), "CARD=");
+		card += 5;
+	}
+
+	char token[32];
+	const char *comma = strchr(card, ',');
+	size_t clen = comma ? (size_t) (comma - card) : strlen(card);
+	if (clen == 0 || clen >= sizeof(token))
+		return -EINVAL;
+	memcpy(token, card, clen);
+	token[clen] = '\0';
+
+	snprintf(id->suffix, sizeof(id->suffix), "%s", comma ? comma : "");
+
+	/* accepts both the index and the card id */
+	return snd_card_get_index(token);
+}
+
+static int read_card_info(int card, char *id, size_t id_len, char *longname,
+			  size_t longname_len) {
+	snd_ctl_t *ctl;
+	snd_ctl_card_info_t *info;
+	char name[16];
+	int err;
+
+	snprintf(name, sizeof(name), "hw:%d", card);
+	if ((err = snd_ctl_open(&ctl, name, 0)) < 0)
+		return err;
+
+	snd_ctl_card_info_alloca(&info);
+	if ((err = snd_ctl_card_info(ctl, info)) >= 0) {
+		snprintf(id, id_len, "%s", snd_ctl_card_info_get_id(info));
+		snprintf(longname, longname_len, "%s",
+			 snd_ctl_card_info_get_longname(info));
+	}
+	snd_ctl_close(ctl);
+	return err;
+}
+
+/* longname match first (it carries the USB port path), id otherwise;
+ * cards whose control device cannot be opened yet are skipped */
+static int find_card(const struct hotplug_monitor *m) {
+	int card = -1;
+	int by_id = -ENOENT;
+
+	while (snd_card_next(&card) >= 0 && card >= 0) {
+		char id[32], longname[128];
+
+		if (read_card_info(card, id, sizeof(id), longname,
+				   sizeof(longname)) < 0)
+			continue;
+		if (strcmp(longname, m->ident.longname) == 0)
+			return card;
+		if (by_id < 0 && strcmp(id, m->ident.id) == 0)
+			by_id = card;
+	}
+	return by_id;
+}
+
+static void build_dev_name(struct hotplug_monitor *m) {
+	snprintf(m->dev, sizeof(m->dev), "%s%s%d%s", m->ident.prefix,
+		 m->ident.card_key, m->ident.card, m->ident.suffix);
+}
+
+static int open_uevent_socket(void) {
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_pid = 0,
+		/* group 1: kernel uevents (udevd rebroadcasts on group 2) */
+		.nl_groups = 1,
+	};
+	int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			NETLINK_KOBJECT_UEVENT);
+	if (fd < 0) {
+		log_debug("Kernel uevents are unavailable: %s",
+			  strerror(errno));
+		return -1;
+	}
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		log_debug("Kernel uevents are not permitted: %s",
+			  strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int hotplug_open(struct hotplug_monitor *m, const char *dev) {
+	int card, err;
+
+	memset(m, 0, sizeof(*m));
+	m->inotify_fd = -1;
+	m->uevent_fd = -1;
+
+	if ((card = split_dev_name(&m->ident, dev)) < 0) {
+		log_error("Cannot follow '%s' across reconnects: the name does "
+			  "not select a card (use hw:N or hw:CARD=id)",
+			  dev);
+		return card;
+	}
+	if ((err = read_card_info(card, m->ident.id, sizeof(m->ident.id),
+				  m->ident.longname,
+				  sizeof(m->ident.longname))) < 0) {
+		log_error("Could not read card %d information: %s", card,
+			  snd_strerror(err));
+		return err;
+	}
+	m->ident.card = card;
+	build_dev_name(m);
+
+	m->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m->inotify_fd < 0) {
+		log_warn("Could not watch /dev/snd: %s", strerror(errno));
+	} else if (inotify_add_watch(m->inotify_fd, "/dev/snd",
+				     IN_CREATE | IN_DELETE | IN_ATTRIB) < 0) {
+		log_warn("Could not watch /dev/snd: %s", strerror(errno));
+		close(m->inotify_fd);
+		m->inotify_fd = -1;
+	}
+	m->uevent_fd = open_uevent_socket();
+
+	log_info("Following card %d '%s' (%s) across reconnects", card,
+		 m->ident.id, m->ident.longname);
+	log_debug("Hotplug sources: inotify %s; kernel uevents %s",
+		  m->inotify_fd >= 0 ? "enabled" : "disabled",
+		  m->uevent_fd >= 0 ? "enabled" : "disabled");
+	return 0;
+}
+
+void hotplug_close(struct hotplug_monitor *m) {
+	if (m->inotify_fd >= 0)
+		close(m->inotify_fd);
+	if (m->uevent_fd >= 0)
+		close(m->uevent_fd);
+	m->inotify_fd = -1;
+	m->uevent_fd = -1;
+}
+
+bool hotplug_is_disconnect(struct alsa_state *state, int err) {
+	if (err == -ENODEV)
+		return true;
+	return state->opened &&
+	       snd_pcm_state(state->hndl) == SND_PCM_STATE_DISCONNECTED;
+}
+
+/* drain both event sources; a removal of our control device (or the
+ * matching "remove@.../sound/cardN" uevent) marks the card as gone */
+static void drain_events(struct hotplug_monitor *m) {
+	char ctl_name[16], card_path[32];
+	char buf[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+
+	snprintf(ctl_name, sizeof(ctl_name), "controlC%d", m->ident.card);
+	snprintf(card_path, sizeof(card_path), "/sound/card%d", m->ident.card);
+
+	while (m->inotify_fd >= 0 &&
+	       (len = read(m->inotify_fd, buf, sizeof(buf))) > 0) {
+		const struct inotify_event *ev;
+		for (char *p = buf; p < buf + len;
+		     p += sizeof(struct inotify_event) + ev->len) {
+			ev = (const struct inotify_event *) p;
+			if (ev->len == 0)
+				continue;
+			log_trace("/dev/snd/%s %s", ev->name,
+				  ev->mask & IN_DELETE	 ? "removed"
+				  : ev->mask & IN_CREATE ? "created"
+							 : "changed");
+			if ((ev->mask & IN_DELETE) &&
+			    strcmp(ev->name, ctl_name) == 0)
+				m->seen_gone = true;
+		}
+	}
+
+	while (m->uevent_fd >= 0 &&
+	       (len = recv(m->uevent_fd, buf, sizeof(buf) - 1, 0)) > 0) {
+		/* "ACTION@DEVPATH\0KEY=VALUE\0..."; only the header is
+		 * needed */
+		buf[len] = '\0';
+		if (strstr(buf, "/sound/") == NULL)
+			continue;
+		log_trace("Kernel uevent: %s", buf);
+		size_t hlen = strlen(buf), plen = strlen(card_path);
+		if (strncmp(buf, "remove@", 7) == 0 && hlen >= plen &&
+		    strcmp(buf + hlen - plen, card_path) == 0)
+			m->seen_gone = true;
+	}
+}
+
+/* sleep until an event arrives or the rescan interval passes */
+static int wait_events(struct hotplug_monitor *m, uint64_t end_ns) {
+	struct pollfd pfds[2];
+	nfds_t n = 0;
+	uint64_t now = now_ns();
+	int timeout_ms = HOTPLUG_RESCAN_MS;
+
+	if (now >= end_ns)
+		return -ETIMEDOUT;
+	if (end_ns != UINT64_MAX &&
+	    (end_ns - now) / 1000000 < HOTPLUG_RESCAN_MS)
+		timeout_ms = (int) ((end_ns - now) / 1000000) + 1;
+
+	if (m->inotify_fd >= 0)
+		pfds[n++] = (struct pollfd) {.fd = m->inotify_fd,
+					     .events = POLLIN};
+	if (m->uevent_fd >= 0)
+		pfds[n++] = (struct pollfd) {.fd = m->uevent_fd,
+					     .events = POLLIN};
+
+	if (poll(pfds, n, timeout_ms) < 0 && errno != EINTR) {
+		int err = -errno;
+		log_error("Hotplug polling failed: %s", strerror(errno));
+		return err;
+	}
+	drain_events(m);
+	return 0;
+}
+
+/* the old card may still be listed while it is torn down, so a card at
+ * the same index only counts once it was seen going away */
+static int wait_card(struct hotplug_monitor *m, uint64_t end_ns) {
+	int res;
+
+	while (!stop_requested()) {
+		int card = find_card(m);
+		if (card < 0) {
+			m->seen_gone = true;
+		} else if (m->seen_gone || card != m->ident.card) {
+			m->ident.card = card;
+			build_dev_name(m);
+			return 0;
+		}
+		if ((res = wait_events(m, end_ns)) < 0)
+			return res;
+	}
+	return -EINTR;
+}
+
+int hotplug_reconnect(struct hotplug_monitor *m, struct alsa_state *state,
+		      struct pcm_setup *cfg, uint64_t end_ns) {
+	uint64_t unplug_ns = now_ns();
+	int res;
+
+	log_warn("The PCM was disconnected; waiting for card '%s' to return",
+		 m->ident.id);
+	pcm_sink_stop(state);
+	m->seen_gone = false;
+
+	while ((res = wait_card(m, end_ns)) == 0) {
+		struct alsa_state next;
+
+		alsa_state_init(&next);
+		next.cycle_cb = state->cycle_cb;
+		next.cycle_data = state->cycle_data;
+		next.xrun_cb = state->xrun_cb;
+		next.xrun_data = state->xrun_data;
+		next.force_generic = state->force_generic;
+
+		cfg->dev = m->dev;
+		if ((res = pcm_sink_open(&next, cfg)) >= 0 &&
+		    (res = pcm_sink_start(&next)) >= 0) {
+			uint64_t gap = now_ns() - unplug_ns;
+
+			*state = next;
+			m->reconnects++;
+			m->gap_total_ns += gap;
+			if (gap > m->gap_max_ns)
+				m->gap_max_ns = gap;
+			log_info("Card '%s' reconnected as %s after %.3f s",
+				 m->ident.id, m->dev, gap / 1e9);
+			return 0;
+		}
+		pcm_sink_stop(&next);
+
+		/* the control device usually appears before the PCM is
+		 * usable (udev is still applying permissions); retry on
+		 * the next event */
+		log_debug("Could not reopen %s yet: %s", m->dev,
+			  snd_strerror(res));
+		if ((res = wait_events(m, end_ns)) < 0)
+			return res;
+	}
+	return res;
+}
+
+void hotplug_report(struct report_tab *t, const struct hotplug_monitor *m) {
+	report_kv(t, "Reconnects", "%u", m->reconnects);
+	if (m->reconnects > 0)
+		report_kv(t, "Reconnect gap", "%.3f s max; %.3f s total",
+			  m->gap_max_ns / 1e9, m->gap_total_ns / 1e9);
+}
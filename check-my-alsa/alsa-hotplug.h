@@ -0,0 +1,75 @@
+/*
+ * alsa-hotplug.h - follow a card across unplug/replug.
+ *
+ * PipeWire learns about cards from udev (spa/plugins/alsa/alsa-udev.c)
+ * and additionally watches /dev/snd with inotify to notice when the
+ * control device becomes accessible. check-my-alsa has no udev
+ * dependency: the monitor below watches /dev/snd with inotify and, where
+ * the sandbox permits it, reads kernel uevents from a
+ * NETLINK_KOBJECT_UEVENT socket. Both are only used as wakeup sources;
+ * the card list itself is always re-read through alsa-lib.
+ *
+ * A card is identified by its longname (which carries the USB port path)
+ * and falls back to its id, so a device that comes back with a different
+ * index is still recognised.
+ */
+
+#ifndef ALSA_HOTPLUG_H
+#define ALSA_HOTPLUG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "alsa-pcm.h"
+#include "app-common.h"
+
+struct hotplug_ident {
+	/* snd_ctl_card_info_get_id() / _get_longname() at startup */
+	char id[32];
+	char longname[128];
+	/* the -D string split around the card token, e.g. "hw:" + N +
+	 * ",0"; card_key is "CARD=" when the name used the keyed form */
+	char prefix[32];
+	char card_key[8];
+	char suffix[64];
+	/* current index, -1 while the card is gone */
+	int card;
+};
+
+struct hotplug_monitor {
+	int inotify_fd;
+	/* -1 when netlink uevents are not permitted */
+	int uevent_fd;
+	struct hotplug_ident ident;
+	/* PCM name rebuilt from ident with the current card index */
+	char dev[96];
+	/* set once the old card was observed going away */
+	bool seen_gone;
+
+	/* reconnect bookkeeping for the applet reports */
+	unsigned int reconnects;
+	uint64_t gap_total_ns;
+	uint64_t gap_max_ns;
+};
+
+/* resolve the card behind dev and start watching; returns a negative
+ * errno when dev does not name a card (e.g. "default") */
+int hotplug_open(struct hotplug_monitor *m, const char *dev);
+void hotplug_close(struct hotplug_monitor *m);
+
+/* true if err (from pcm_sink_iterate()) means the PCM went away */
+bool hotplug_is_disconnect(struct alsa_state *state, int err);
+
+/*
+ * tear down the disconnected stream, wait for the card to come back and
+ * restart it with the same hooks; cfg->dev is pointed at the rebuilt
+ * name. Returns 0 once the stream runs again, -EINTR when a stop was
+ * requested and -ETIMEDOUT when end_ns passed while waiting.
+ */
+int hotplug_reconnect(struct hotplug_monitor *m, struct alsa_state *state,
+		      struct pcm_setup *cfg, uint64_t end_ns);
+
+/* "Reconnects" / "Reconnect gap" rows for the applet summaries */
+void hotplug_report(struct report_tab *t, const struct hotplug_monitor *m);
+
+#endif
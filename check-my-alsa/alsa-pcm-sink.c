@@ -66,12 +66,19 @@ int pcm_sink_iterate(struct alsa_state *state, int timeout_ms) {
 		return -ETIMEDOUT;
 
 	/* the pipewire wakeup: alsa_do_wakeup_work() runs the sync and
-	 * the cycle hook, then the graph would call spa_alsa_write() */
+	 * the cycle hook, then the graph would call spa_alsa_write();
+	 * the cost of completed wakeups is accumulated for the reports */
+	uint64_t start = cycle_counter();
 	res = alsa_timer_wakeup(state);
 	if (res < 0)
 		return res;
 
-	return spa_alsa_write(state);
+	res = spa_alsa_write(state);
+	if (res == 0) {
+		state->wakeup_cost += cycle_counter() - start;
+		state->wakeup_count++;
+	}
+	return res;
 }
 
 /* pipewire alsa-pcm-sink.c stop sequence */
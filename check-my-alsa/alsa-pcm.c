@@ -23,6 +23,9 @@
  *  - alsa_write_frames() writes silence instead of the graph buffers;
  *    alsa_read_frames() (the capture path) is not ported, the test only
  *    exercises playback
+ *  - ALSA_PCM_SPECIALIZE adds fixed format/channel variants of
+ *    alsa_write_frames() and get_avail(), chosen once in
+ *    spa_alsa_set_format() (see struct alsa_cycle_path)
  */
 
 #include <errno.h>
@@ -154,6 +157,9 @@ static void recalc_headroom(struct alsa_state *state) {
 		state->headroom = 0;
 }
 
+/* test-only, defined with the specialised cycle paths below */
+static void select_cycle_path(struct alsa_state *state);
+
 /*
  * playback/raw/mmap/tsched subset: the format is taken from the command
  * line instead of a SPA format pod */
@@ -342,6 +348,7 @@ int spa_alsa_set_format(struct alsa_state *state, unsigned int rate,
 	state->start_delay = state->default_start_delay;
 
 	recalc_headroom(state);
+	select_cycle_path(state);
 
 	log_debug("Negotiated format: %s; rate: %d Hz; channels: %d; "
 		  "access: interleaved %s",
@@ -353,6 +360,7 @@ int spa_alsa_set_format(struct alsa_state *state, unsigned int rate,
 	log_debug("Scheduling: headroom %u frames; batch mode %s; timer "
 		  "scheduling enabled",
 		  state->headroom, state->is_batch ? "enabled" : "disabled");
+	log_debug("Cycle path: %s", alsa_cycle_path_name(state));
 
 	/* write the parameters to device */
 	CHECK(snd_pcm_hw_params(hndl, params), "set_hw_params");
@@ -631,6 +639,11 @@ int get_avail(struct alsa_state *state, uint64_t current_time,
 	int res;
 	snd_pcm_sframes_t avail;
 
+#ifdef ALSA_PCM_SPECIALIZE
+	if (state->cycle_path)
+		return state->cycle_path->get_avail(state, current_time, delay);
+#endif
+
 	if ((avail = alsa_avail(state)) < 0) {
 		if ((res = alsa_recover(state)) < 0)
 			return res;
@@ -732,6 +745,8 @@ int get_status(struct alsa_state *state, uint64_t current_time,
 	state->last_avail = *avail;
 	state->last_delay = *delay;
 	state->last_target = *target;
+	state->last_status_ns =
+		state->htimestamp ? current_time : get_time_ns();
 
 	return 0;
 }
@@ -896,6 +911,11 @@ int alsa_write_frames(struct alsa_state *state) {
 	snd_pcm_sframes_t commitres;
 	int res = 0;
 
+#ifdef ALSA_PCM_SPECIALIZE
+	if (state->cycle_path)
+		return state->cycle_path->write_frames(state);
+#endif
+
 	frames = state->buffer_frames;
 	if (state->use_mmap && frames > 0) {
 		if ((res = snd_pcm_mmap_begin(hndl, &my_areas, &offset,
@@ -949,6 +969,149 @@ int spa_alsa_write(struct alsa_state *state) {
 	return alsa_write_frames(state);
 }
 
+#ifdef ALSA_PCM_SPECIALIZE
+/*
+ * test-only: get_avail() with the branches that are constant for a
+ * specialised path folded away: alsa_avail() is snd_pcm_avail() (not
+ * matching, tsched, no resample) and htimestamp is off. The recover and
+ * log behaviour is the generic one.
+ */
+static int get_avail_fixed(struct alsa_state *state, uint64_t current_time,
+			   snd_pcm_uframes_t *delay) {
+	snd_pcm_sframes_t avail;
+	int res;
+	(void) current_time;
+
+	if ((avail = snd_pcm_avail(state->hndl)) < 0) {
+		if ((res = alsa_recover(state)) < 0)
+			return res;
+		if ((avail = snd_pcm_avail(state->hndl)) < 0) {
+			log_warn("snd_pcm_avail still fails after recovery: %s",
+				 snd_strerror(avail));
+			state->recover_fails++;
+			avail = state->threshold * 2;
+		}
+	}
+	*delay = avail;
+	return avail;
+}
+
+/*
+ * test-only: alsa_write_frames() for interleaved mmap with a compile-time
+ * frame size. Silence of the specialised formats is all-zero, so
+ * snd_pcm_areas_silence() (per-channel, per-format dispatch) becomes one
+ * memset over the contiguous mmap region.
+ */
+static inline __attribute__((always_inline)) int
+write_frames_fixed(struct alsa_state *state, const size_t frame_bytes) {
+	snd_pcm_t *hndl = state->hndl;
+	const snd_pcm_channel_area_t *my_areas;
+	snd_pcm_uframes_t frames, offset;
+	snd_pcm_sframes_t commitres;
+	int res;
+
+	frames = state->buffer_frames;
+	if ((res = snd_pcm_mmap_begin(hndl, &my_areas, &offset, &frames)) <
+	    0) {
+		log_error("snd_pcm_mmap_begin failed during playback: %s",
+			  snd_strerror(res));
+		alsa_recover(state);
+		return res;
+	}
+	memset((uint8_t *) my_areas[0].addr + my_areas[0].first / 8 +
+		       offset * frame_bytes,
+	       0, frames * frame_bytes);
+
+	if (frames > 0) {
+		if ((commitres = snd_pcm_mmap_commit(hndl, offset, frames)) <
+		    0) {
+			if (commitres == -EPIPE || commitres == -ESTRPIPE) {
+				log_warn("snd_pcm_mmap_commit reported an "
+					 "XRUN: %s",
+					 snd_strerror(commitres));
+			} else {
+				log_error("snd_pcm_mmap_commit failed during "
+					  "playback: %s",
+					  snd_strerror(commitres));
+				return commitres;
+			}
+		}
+		if (commitres > 0 && frames != (snd_pcm_uframes_t) commitres) {
+			log_warn("snd_pcm_mmap_commit wrote %ld frames instead "
+				 "of %ld",
+				 (long) commitres, (long) frames);
+		}
+	}
+
+	state->sample_count += frames;
+
+	if (!state->alsa_started)
+		do_start(state);
+
+	update_sources(state, true);
+
+	return 0;
+}
+
+#define WRITE_FRAMES_FIXED(sfx, width, channels)                              \
+	static int write_frames_##sfx(struct alsa_state *state) {             \
+		return write_frames_fixed(state, (width) / 8 * (channels));   \
+	}
+
+WRITE_FRAMES_FIXED(s16_2ch, 16, 2)
+WRITE_FRAMES_FIXED(s32_2ch, 32, 2)
+WRITE_FRAMES_FIXED(f32_8ch, 32, 8)
+
+static const struct alsa_cycle_path cycle_paths[] = {
+	{"S16_LE stereo", SND_PCM_FORMAT_S16_LE, 2, write_frames_s16_2ch,
+	 get_avail_fixed},
+	{"S32_LE stereo", SND_PCM_FORMAT_S32_LE, 2, write_frames_s32_2ch,
+	 get_avail_fixed},
+	{"FLOAT_LE 8ch", SND_PCM_FORMAT_FLOAT_LE, 8, write_frames_f32_8ch,
+	 get_avail_fixed},
+};
+#endif
+
+/* the specialised paths assume interleaved mmap and fold the
+ * htimestamp/matching/resample/disable_tsched branches, so any of those
+ * keeps the generic code */
+static void select_cycle_path(struct alsa_state *state) {
+	state->cycle_path = NULL;
+#ifdef ALSA_PCM_SPECIALIZE
+	if (state->force_generic || !state->use_mmap || state->planar ||
+	    state->htimestamp || state->matching || state->resample ||
+	    state->disable_tsched)
+		return;
+
+	for (size_t i = 0; i < sizeof(cycle_paths) / sizeof(cycle_paths[0]);
+	     i++) {
+		if (cycle_paths[i].format == state->format &&
+		    cycle_paths[i].channels == state->channels) {
+			state->cycle_path = &cycle_paths[i];
+			return;
+		}
+	}
+#endif
+}
+
+const char *alsa_cycle_path_name(const struct alsa_state *state) {
+	return state->cycle_path ? state->cycle_path->name : "generic";
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+const char *const cycle_counter_unit = "TSC cycles";
+
+uint64_t cycle_counter(void) {
+	return __builtin_ia32_rdtsc();
+}
+#else
+const char *const cycle_counter_unit = "ns";
+
+uint64_t cycle_counter(void) {
+	return get_time_ns();
+}
+#endif
+
 /*
  * triggers the graph; in the test the per-cycle hook plays the part of
  * the graph consumer */
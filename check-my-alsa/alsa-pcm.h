@@ -30,6 +30,10 @@
  *  - the test adds a per-cycle hook (state->cycle_cb) where pipewire's
  *    graph would be triggered by playback_ready(), and an xrun notify
  *    hook (state->xrun_cb) where pipewire calls spa_node_call_xrun().
+ *  - with the 'specialize' build option (ALSA_PCM_SPECIALIZE),
+ *    spa_alsa_set_format() may pick a struct alsa_cycle_path with
+ *    alsa_write_frames()/get_avail() variants compiled for one fixed
+ *    format and channel count; pipewire always runs the generic code.
  */
 
 #ifndef ALSA_PCM_H
@@ -70,6 +74,8 @@
 #define DEFAULT_USE_PERIOD_SIZE_MIN_AS_HEADROOM false
 #define DEFAULT_HTIMESTAMP false
 
+struct alsa_cycle_path;
+
 /*
  * struct alsa_state - simplified stand-in for pipewire's struct state
  * (spa/plugins/alsa/alsa-pcm.h). Only the fields used by the ported
@@ -168,6 +174,19 @@ struct alsa_state {
 	snd_pcm_uframes_t last_avail;
 	snd_pcm_uframes_t last_delay;
 	snd_pcm_uframes_t last_target;
+	/* CLOCK_MONOTONIC time last_delay refers to: the wakeup time with
+	 * htimestamp, the moment of the avail read otherwise */
+	uint64_t last_status_ns;
+
+	/* test-only: specialised write/sync path chosen by
+	 * spa_alsa_set_format(), NULL runs the generic code;
+	 * force_generic keeps it NULL for comparison runs */
+	const struct alsa_cycle_path *cycle_path;
+	bool force_generic;
+	/* test-only: completed wakeups in pcm_sink_iterate() and their
+	 * summed cost in cycle_counter() units */
+	uint64_t wakeup_count;
+	uint64_t wakeup_cost;
 
 	/* test-only hooks, see header comment:
 	 * cycle_cb: called from playback_ready(), where pipewire would
@@ -222,6 +241,27 @@ int spa_alsa_pause(struct alsa_state *state);
  * spa_alsa_open() */
 void alsa_state_init(struct alsa_state *state);
 
+/*
+ * test-only: a write/sync path specialised for one format and channel
+ * count (interleaved mmap, no htimestamp/matching/resample branches).
+ * The variants are only compiled with ALSA_PCM_SPECIALIZE.
+ */
+struct alsa_cycle_path {
+	const char *name;
+	snd_pcm_format_t format;
+	unsigned int channels;
+	int (*write_frames)(struct alsa_state *state);
+	int (*get_avail)(struct alsa_state *state, uint64_t current_time,
+			 snd_pcm_uframes_t *delay);
+};
+
+/* "generic" or the specialised path name */
+const char *alsa_cycle_path_name(const struct alsa_state *state);
+
+/* per-wakeup cost counter: TSC on x86, CLOCK_MONOTONIC ns elsewhere */
+uint64_t cycle_counter(void);
+extern const char *const cycle_counter_unit;
+
 /* alsa-pcm-sink.c: playback stream driver, the counterpart of pipewire's
  * alsa-pcm-sink.c without the SPA node plumbing */
 int pcm_sink_open(struct alsa_state *state, const struct pcm_setup *cfg);
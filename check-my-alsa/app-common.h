@@ -93,6 +93,7 @@ const struct applet *applet_find(const char *name);
 
 #define PCM_OPTSTRING "D:r:c:f:p:b:d:"
 #define CARD_OPTSTRING "c:"
+#define HOTPLUG_OPTSTRING "H"
 #define COMMON_OPTSTRING "vh"
 
 /* --- pcm test configuration --- */
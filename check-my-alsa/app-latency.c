@@ -5,6 +5,10 @@
  * get_avail path). The stream clock position is the number of frames the
  * DMA consumed: sample_count - delay (written minus in-flight), which is
  * how pipewire's clock position advances.
+ *
+ * With -H the card is followed across unplug/replug (alsa-hotplug.c);
+ * the position of the reopened stream is appended to the old one and the
+ * dead time is left out of the expected position.
  */
 
 #include <inttypes.h>
@@ -12,6 +16,7 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include "alsa-hotplug.h"
 #include "alsa-pcm.h"
 #include "app-common.h"
 
@@ -28,7 +33,14 @@ struct latency_stats {
 	 * the write-ahead pacing */
 	double drift_sum;
 	double drift_ppm;
+	uint64_t drift_count;
 	bool got_first_delay;
+	/* set after a reconnect: the next cycle only re-bases the
+	 * position of the new stream */
+	bool rebase;
+	uint64_t consumed_base;
+	uint64_t written_base;
+	uint64_t paused_ns;
 };
 
 static void on_cycle(struct alsa_state *st, void *data) {
@@ -42,18 +54,28 @@ static void on_cycle(struct alsa_state *st, void *data) {
 		s->got_first_delay = true;
 	}
 	s->delay_last = delay;
-	s->sample_count = st->sample_count;
 	s->polls++;
 
-	if (s->polls > 1) {
+	if (s->rebase) {
+		s->consumed_base = s->last_consumed - consumed;
+		s->written_base = s->sample_count;
+		s->paused_ns += now - s->last_cycle_ns;
+		s->rebase = false;
+		consumed += s->consumed_base;
+	} else if (s->polls > 1) {
+		consumed += s->consumed_base;
 		uint64_t d_consumed = consumed - s->last_consumed;
 		uint64_t d_wall = now - s->last_cycle_ns;
 		double expected = (double) d_wall * st->rate / 1e9;
-		if (expected > 0)
+		if (expected > 0) {
 			s->drift_sum +=
 				(d_consumed - expected) / expected * 1e6;
-		s->drift_ppm = s->drift_sum / (s->polls - 1);
+			s->drift_count++;
+		}
+		if (s->drift_count > 0)
+			s->drift_ppm = s->drift_sum / s->drift_count;
 	}
+	s->sample_count = s->written_base + st->sample_count;
 
 	s->last_consumed = consumed;
 	s->last_cycle_ns = now;
@@ -66,10 +88,13 @@ static void on_cycle(struct alsa_state *st, void *data) {
 
 static void print_report(const struct latency_stats *s,
 			 const struct pcm_setup *cfg,
-			 const struct alsa_state *st, double elapsed_s,
+			 const struct alsa_state *st,
+			 const struct hotplug_monitor *hp, double elapsed_s,
 			 int runtime_error) {
 	double measurement_s =
-		s->polls > 0 ? (s->last_cycle_ns - s->wall_start_ns) / 1e9
+		s->polls > 0 ? (s->last_cycle_ns - s->wall_start_ns -
+				s->paused_ns) /
+				       1e9
 			     : 0.0;
 	double wall_samples = measurement_s * st->rate;
 	double consumed = (double) s->last_consumed;
@@ -95,6 +120,8 @@ static void print_report(const struct latency_stats *s,
 		  runtime_error	     ? "runtime error"
 		  : stop_requested() ? "interrupted"
 				     : "duration reached");
+	if (hp)
+		hotplug_report(t, hp);
 	report_kv(t, "Clock samples", "%" PRIu64, s->polls);
 	report_kv(t, "Frames written", "%" PRIu64, s->sample_count);
 	report_kv(t, "Clock position", "%.0f frames", consumed);
@@ -126,6 +153,7 @@ static void print_report(const struct latency_stats *s,
 
 static void latency_usage(const char *prog) {
 	pcm_setup_usage(prog);
+	usage_opt("-H", "follow the card across unplug/replug");
 	usage_opt("-v", "increase log level (-v info, -vv debug, -vvv trace)");
 	usage_opt("-h", "help");
 }
@@ -136,10 +164,15 @@ static int latency_run(int argc, char **argv) {
 	pcm_setup_defaults(&cfg);
 
 	int verbose = 0;
+	bool hotplug = false;
 	int opt;
-	while ((opt = getopt(argc, argv, PCM_OPTSTRING COMMON_OPTSTRING)) !=
-	       -1) {
+	while ((opt = getopt(argc, argv,
+			     PCM_OPTSTRING HOTPLUG_OPTSTRING
+				     COMMON_OPTSTRING)) != -1) {
 		switch (opt) {
+		case 'H':
+			hotplug = true;
+			break;
 		case 'v':
 			verbose++;
 			break;
@@ -165,10 +198,17 @@ static int latency_run(int argc, char **argv) {
 
 	log_set_verbose(verbose);
 
+	struct hotplug_monitor hp;
+	if (hotplug && hotplug_open(&hp, cfg.dev) < 0)
+		return 1;
+
 	struct alsa_state st;
 	alsa_state_init(&st);
-	if (pcm_sink_open(&st, &cfg) < 0)
+	if (pcm_sink_open(&st, &cfg) < 0) {
+		if (hotplug)
+			hotplug_close(&hp);
 		return 1;
+	}
 
 	struct latency_stats stats = {0};
 	stats.wall_start_ns = now_ns();
@@ -178,6 +218,8 @@ static int latency_run(int argc, char **argv) {
 
 	if (pcm_sink_start(&st) < 0) {
 		pcm_sink_stop(&st);
+		if (hotplug)
+			hotplug_close(&hp);
 		return 1;
 	}
 	log_info("Playback clock measurement started for %s",
@@ -207,6 +249,16 @@ static int latency_run(int argc, char **argv) {
 				continue;
 			break;
 		}
+		if (res < 0 && res != -EAGAIN && hotplug &&
+		    hotplug_is_disconnect(&st, res)) {
+			res = hotplug_reconnect(&hp, &st, &cfg, end_ns);
+			if (res == -EINTR || res == -ETIMEDOUT)
+				break;
+			if (res == 0) {
+				stats.rebase = stats.polls > 0;
+				continue;
+			}
+		}
 		if (res < 0 && res != -EAGAIN) {
 			log_error("Clock measurement stopped: %s",
 				  snd_strerror(res));
@@ -222,7 +274,10 @@ static int latency_run(int argc, char **argv) {
 	double elapsed_s = (now_ns() - stats.wall_start_ns) / 1e9;
 	pcm_sink_stop(&st);
 
-	print_report(&stats, &cfg, &st, elapsed_s, runtime_error);
+	print_report(&stats, &cfg, &st, hotplug ? &hp : NULL, elapsed_s,
+		     runtime_error);
+	if (hotplug)
+		hotplug_close(&hp);
 	return runtime_error || stats.polls == 0 ? 1 : 0;
 }
 
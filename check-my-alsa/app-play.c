@@ -2,6 +2,11 @@
  * play applet: plain playback smoke test on the pipewire path. Writes
  * silence for the given duration and reports cycle/sample counts, the
  * negotiated hw params and any xruns encountered on the way.
+ *
+ * The summary also reports the write/sync path used (generic, or a
+ * specialised one with the 'specialize' build option) and the average
+ * cost per wakeup; -g forces the generic path so both can be compared
+ * on the same device.
  */
 
 #include <inttypes.h>
@@ -31,6 +36,7 @@ static void on_cycle(struct alsa_state *st, void *data) {
 
 static void play_usage(const char *prog) {
 	pcm_setup_usage(prog);
+	usage_opt("-g", "force the generic cycle path");
 	usage_opt("-v", "increase log level (-v info, -vv debug, -vvv trace)");
 	usage_opt("-h", "help");
 }
@@ -38,13 +44,17 @@ static void play_usage(const char *prog) {
 static int play_run(int argc, char **argv) {
 	struct pcm_setup cfg;
 	int verbose = 0;
+	bool force_generic = false;
 
 	pcm_setup_defaults(&cfg);
 
 	int opt;
-	while ((opt = getopt(argc, argv, PCM_OPTSTRING COMMON_OPTSTRING)) !=
+	while ((opt = getopt(argc, argv, PCM_OPTSTRING "g" COMMON_OPTSTRING)) !=
 	       -1) {
 		switch (opt) {
+		case 'g':
+			force_generic = true;
+			break;
 		case 'v':
 			verbose++;
 			break;
@@ -72,6 +82,7 @@ static int play_run(int argc, char **argv) {
 
 	struct alsa_state st;
 	alsa_state_init(&st);
+	st.force_generic = force_generic;
 	if (pcm_sink_open(&st, &cfg) < 0)
 		return 1;
 
@@ -148,6 +159,12 @@ static int play_run(int argc, char **argv) {
 	report_kv(t, "Early wakeups", "%" PRIu64, stats.early_wakeups);
 	report_kv(t, "Frames written", "%" PRIu64, st.sample_count);
 	report_kv(t, "XRUN loss", "%" PRIu64 " frames", st.xrun);
+	report_kv(t, "Cycle path", "%s", alsa_cycle_path_name(&st));
+	report_kv(t, "Wakeup cost", "%.0f %s avg",
+		  st.wakeup_count > 0
+			  ? (double) st.wakeup_cost / st.wakeup_count
+			  : 0.0,
+		  cycle_counter_unit);
 	report_tab_end(t);
 
 	if (runtime_error)
@@ -0,0 +1,686 @@
+/*
+ * roundtrip applet: measures the real capture-to-playback round trip
+ * through a loopback (a physical cable from output to input, or the
+ * snd-aloop driver, e.g. -D hw:Loopback,0 -C hw:Loopback,1).
+ *
+ * A maximum length sequence (MLS, order 12) is played once per
+ * interval and located in the captured signal by cross-correlation
+ * against the reference, which gives the hardware round trip with sample
+ * accuracy. The streams are linked with snd_pcm_link() so that capture
+ * frame N and playback frame N share one start instant; when the link
+ * fails (different cards) the trigger timestamps are used to correct the
+ * start offset instead.
+ *
+ * Deviation: this is a measurement, not the PipeWire path. It uses plain
+ * interleaved read/write access on both PCMs; the buffering latency on
+ * top of the hardware round trip is reported separately.
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <alsa/asoundlib.h>
+
+#include "app-common.h"
+
+#define MLS_ORDER 12
+#define MLS_LEN ((1u << MLS_ORDER) - 1)
+/* Galois LFSR feedback for x^12 + x^11 + x^10 + x^4 + 1 */
+#define MLS_TAPS 0xE08u
+#define MLS_AMPLITUDE 0.5f
+/* correlation peak over the mean absolute correlation; an MLS peak is
+ * orders of magnitude above this, noise alone stays well below */
+#define MIN_PEAK_RATIO 20.0
+
+struct roundtrip_cfg {
+	struct pcm_setup pcm;
+	const char *capture_dev;
+	unsigned int interval_ms;
+	unsigned int max_lag_ms;
+};
+
+struct roundtrip_pcm {
+	snd_pcm_t *hndl;
+	snd_pcm_uframes_t period;
+	snd_pcm_uframes_t buffer;
+};
+
+struct roundtrip_stats {
+	uint64_t measurements;
+	uint64_t missed;
+	uint64_t restarts;
+	double min_frames;
+	double max_frames;
+	double sum_frames;
+	double sum_sq_frames;
+	double last_ratio;
+};
+
+/* reference spectrum and scratch buffers for the FFT correlation */
+struct correlator {
+	size_t n;
+	double *ref_re, *ref_im;
+	double *re, *im;
+};
+
+static void mls_generate(float *dst) {
+	uint32_t lfsr = 1;
+	for (uint32_t i = 0; i < MLS_LEN; i++) {
+		dst[i] = (lfsr & 1) ? MLS_AMPLITUDE : -MLS_AMPLITUDE;
+		lfsr = (lfsr >> 1) ^ ((lfsr & 1) ? MLS_TAPS : 0);
+	}
+}
+
+/* in-place iterative radix-2 FFT, n a power of two */
+static void fft(double *re, double *im, size_t n, bool inverse) {
+	for (size_t i = 1, j = 0; i < n; i++) {
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j) {
+			double t = re[i];
+			re[i] = re[j];
+			re[j] = t;
+			t = im[i];
+			im[i] = im[j];
+			im[j] = t;
+		}
+	}
+	for (size_t len = 2; len <= n; len <<= 1) {
+		double ang = 2 * M_PI / (double) len * (inverse ? 1 : -1);
+		double wr = cos(ang), wi = sin(ang);
+		for (size_t i = 0; i < n; i += len) {
+			double cr = 1.0, ci = 0.0;
+			for (size_t k = 0; k < len / 2; k++) {
+				size_t a = i + k, b = i + k + len / 2;
+				double xr = re[b] * cr - im[b] * ci;
+				double xi = re[b] * ci + im[b] * cr;
+				re[b] = re[a] - xr;
+				im[b] = im[a] - xi;
+				re[a] += xr;
+				im[a] += xi;
+				double t = cr * wr - ci * wi;
+				ci = cr * wi + ci * wr;
+				cr = t;
+			}
+		}
+	}
+	if (inverse) {
+		for (size_t i = 0; i < n; i++) {
+			re[i] /= (double) n;
+			im[i] /= (double) n;
+		}
+	}
+}
+
+/* the window holds max_lag + MLS_LEN frames; a circular correlation of
+ * that size has no wraparound for lags 0..max_lag */
+static int correlator_init(struct correlator *c, const float *mls,
+			   size_t window) {
+	size_t n = 1;
+	while (n < window)
+		n <<= 1;
+
+	c->n = n;
+	c->ref_re = calloc(n, sizeof(double));
+	c->ref_im = calloc(n, sizeof(double));
+	c->re = calloc(n, sizeof(double));
+	c->im = calloc(n, sizeof(double));
+	if (!c->ref_re || !c->ref_im || !c->re || !c->im)
+		return -ENOMEM;
+
+	for (size_t i = 0; i < MLS_LEN; i++)
+		c->ref_re[i] = mls[i];
+	fft(c->ref_re, c->ref_im, n, false);
+	return 0;
+}
+
+static void correlator_free(struct correlator *c) {
+	free(c->ref_re);
+	free(c->ref_im);
+	free(c->re);
+	free(c->im);
+}
+
+/* returns the lag of the correlation peak in 0..max_lag, *ratio is the
+ * peak over the mean absolute correlation (polarity-independent) */
+static size_t correlate(struct correlator *c, const float *window,
+			size_t len, size_t max_lag, double *ratio) {
+	for (size_t i = 0; i < c->n; i++) {
+		c->re[i] = i < len ? window[i] : 0.0;
+		c->im[i] = 0.0;
+	}
+	fft(c->re, c->im, c->n, false);
+	/* X * conj(REF) */
+	for (size_t i = 0; i < c->n; i++) {
+		double r = c->re[i] * c->ref_re[i] + c->im[i] * c->ref_im[i];
+		double m = c->im[i] * c->ref_re[i] - c->re[i] * c->ref_im[i];
+		c->re[i] = r;
+		c->im[i] = m;
+	}
+	fft(c->re, c->im, c->n, true);
+
+	size_t best = 0;
+	double peak = 0.0, sum = 0.0;
+	for (size_t k = 0; k <= max_lag; k++) {
+		double v = fabs(c->re[k]);
+		sum += v;
+		if (v > peak) {
+			peak = v;
+			best = k;
+		}
+	}
+	double mean = sum / (double) (max_lag + 1);
+	*ratio = mean > 0.0 ? peak / mean : 0.0;
+	return best;
+}
+
+static bool format_supported(snd_pcm_format_t format) {
+	return format == SND_PCM_FORMAT_S16_LE ||
+	       format == SND_PCM_FORMAT_S32_LE ||
+	       format == SND_PCM_FORMAT_FLOAT_LE;
+}
+
+/* write one value to every channel of frame i */
+static void put_frame(void *buf, snd_pcm_uframes_t i, unsigned int channels,
+		      snd_pcm_format_t format, float v) {
+	for (unsigned int c = 0; c < channels; c++) {
+		size_t idx = (size_t) i * channels + c;
+		switch (format) {
+		case SND_PCM_FORMAT_S16_LE:
+			((int16_t *) buf)[idx] = (int16_t) (v * 32767.0f);
+			break;
+		case SND_PCM_FORMAT_S32_LE:
+			((int32_t *) buf)[idx] =
+				(int32_t) (v * 2147483647.0);
+			break;
+		default:
+			((float *) buf)[idx] = v;
+			break;
+		}
+	}
+}
+
+/* mono mixdown, so the loopback may land on any capture channel */
+static float get_frame(const void *buf, snd_pcm_uframes_t i,
+		       unsigned int channels, snd_pcm_format_t format) {
+	float sum = 0.0f;
+	for (unsigned int c = 0; c < channels; c++) {
+		size_t idx = (size_t) i * channels + c;
+		switch (format) {
+		case SND_PCM_FORMAT_S16_LE:
+			sum += ((const int16_t *) buf)[idx] / 32768.0f;
+			break;
+		case SND_PCM_FORMAT_S32_LE:
+			sum += (float) (((const int32_t *) buf)[idx] /
+					2147483648.0);
+			break;
+		default:
+			sum += ((const float *) buf)[idx];
+			break;
+		}
+	}
+	return sum;
+}
+
+static int roundtrip_open(struct roundtrip_pcm *p, const char *dev,
+			  snd_pcm_stream_t stream,
+			  const struct pcm_setup *cfg) {
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_sw_params_t *sw;
+	const char *dir =
+		stream == SND_PCM_STREAM_PLAYBACK ? "playback" : "capture";
+	unsigned int rate = cfg->rate;
+	int err, sdir = 0;
+
+	if ((err = snd_pcm_open(&p->hndl, dev, stream, 0)) < 0) {
+		log_error("Could not open the %s PCM %s: %s", dir, dev,
+			  snd_strerror(err));
+		return err;
+	}
+
+	snd_pcm_hw_params_alloca(&hw);
+	CHECK(snd_pcm_hw_params_any(p->hndl, hw), "hw_params_any");
+	CHECK(snd_pcm_hw_params_set_rate_resample(p->hndl, hw, 0),
+	      "set_rate_resample");
+	CHECK(snd_pcm_hw_params_set_access(p->hndl, hw,
+					   SND_PCM_ACCESS_RW_INTERLEAVED),
+	      "set_access");
+	CHECK(snd_pcm_hw_params_set_format(p->hndl, hw, cfg->format),
+	      "set_format");
+	CHECK(snd_pcm_hw_params_set_channels(p->hndl, hw, cfg->channels),
+	      "set_channels");
+	CHECK(snd_pcm_hw_params_set_rate_near(p->hndl, hw, &rate, 0),
+	      "set_rate_near");
+	if (rate != cfg->rate) {
+		log_error("The %s PCM runs at %u Hz instead of %u Hz", dir,
+			  rate, cfg->rate);
+		return -EINVAL;
+	}
+	p->period = cfg->period;
+	CHECK(snd_pcm_hw_params_set_period_size_near(p->hndl, hw, &p->period,
+						     &sdir),
+	      "set_period_size_near");
+	p->buffer = cfg->buffer ? cfg->buffer : p->period * 4;
+	CHECK(snd_pcm_hw_params_set_buffer_size_near(p->hndl, hw, &p->buffer),
+	      "set_buffer_size_near");
+	CHECK(snd_pcm_hw_params(p->hndl, hw), "hw_params");
+
+	/* started explicitly (linked), never by the first write */
+	snd_pcm_sw_params_alloca(&sw);
+	CHECK(snd_pcm_sw_params_current(p->hndl, sw), "sw_params_current");
+	CHECK(snd_pcm_sw_params_set_start_threshold(p->hndl, sw, LONG_MAX),
+	      "set_start_threshold");
+	CHECK(snd_pcm_sw_params_set_tstamp_mode(p->hndl, sw,
+						SND_PCM_TSTAMP_ENABLE),
+	      "set_tstamp_mode");
+	CHECK(snd_pcm_sw_params_set_tstamp_type(p->hndl, sw,
+						SND_PCM_TSTAMP_TYPE_MONOTONIC),
+	      "set_tstamp_type");
+	CHECK(snd_pcm_sw_params(p->hndl, sw), "sw_params");
+
+	log_debug("Negotiated %s: period %lu frames; buffer %lu", dir,
+		  p->period, p->buffer);
+	return 0;
+}
+
+static uint64_t trigger_ns(snd_pcm_t *hndl) {
+	snd_pcm_status_t *status;
+	snd_htimestamp_t ts;
+
+	snd_pcm_status_alloca(&status);
+	if (snd_pcm_status(hndl, status) < 0)
+		return 0;
+	snd_pcm_status_get_trigger_htstamp(status, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/*
+ * (re)start both streams from frame 0: the playback buffer is prefilled
+ * with silence, then the linked pair is started with one trigger. Without
+ * a link the start offset (playback minus capture, in frames) comes from
+ * the trigger timestamps.
+ */
+static int roundtrip_start(struct roundtrip_pcm *play,
+			   struct roundtrip_pcm *cap, bool linked,
+			   void *silence, unsigned int rate, double *offset) {
+	int err;
+
+	snd_pcm_drop(play->hndl);
+	snd_pcm_drop(cap->hndl);
+	CHECK(snd_pcm_prepare(play->hndl), "snd_pcm_prepare (playback)");
+	if (!linked)
+		CHECK(snd_pcm_prepare(cap->hndl), "snd_pcm_prepare (capture)");
+
+	/* the stream is not running yet: never write past the buffer or the
+	 * blocking write would wait forever */
+	for (snd_pcm_uframes_t done = 0; done < play->buffer;) {
+		snd_pcm_uframes_t chunk = play->buffer - done;
+		if (chunk > play->period)
+			chunk = play->period;
+		snd_pcm_sframes_t n =
+			snd_pcm_writei(play->hndl, silence, chunk);
+		if (n < 0) {
+			log_error("Could not prefill the playback buffer: %s",
+				  snd_strerror(n));
+			return (int) n;
+		}
+		done += (snd_pcm_uframes_t) n;
+	}
+
+	*offset = 0.0;
+	if (linked) {
+		CHECK(snd_pcm_start(cap->hndl), "snd_pcm_start (linked)");
+		return 0;
+	}
+
+	CHECK(snd_pcm_start(cap->hndl), "snd_pcm_start (capture)");
+	CHECK(snd_pcm_start(play->hndl), "snd_pcm_start (playback)");
+	uint64_t tc = trigger_ns(cap->hndl), tp = trigger_ns(play->hndl);
+	if (tc != 0 && tp != 0)
+		*offset = ((double) tp - (double) tc) * rate / 1e9;
+	log_debug("Unlinked start: playback started %+.2f frames after "
+		  "capture",
+		  *offset);
+	return 0;
+}
+
+static void record_measurement(struct roundtrip_stats *s, double frames,
+			       double ratio, unsigned int rate) {
+	if (s->measurements == 0 || frames < s->min_frames)
+		s->min_frames = frames;
+	if (s->measurements == 0 || frames > s->max_frames)
+		s->max_frames = frames;
+	s->measurements++;
+	s->sum_frames += frames;
+	s->sum_sq_frames += frames * frames;
+	s->last_ratio = ratio;
+
+	printf("#%-6" PRIu64 " %8.1f frames  %8.3f ms  (peak ratio %.0f)\n",
+	       s->measurements, frames, frames * 1000.0 / rate, ratio);
+	fflush(stdout);
+}
+
+static void print_report(const struct roundtrip_stats *s,
+			 const struct roundtrip_cfg *cfg,
+			 const struct roundtrip_pcm *play,
+			 const struct roundtrip_pcm *cap, bool linked,
+			 int runtime_error) {
+	unsigned int rate = cfg->pcm.rate;
+	uint64_t n = s->measurements;
+	double avg = n > 0 ? s->sum_frames / n : 0.0;
+	double var = n > 0 ? s->sum_sq_frames / n - avg * avg : 0.0;
+	double jitter = var > 0.0 ? sqrt(var) : 0.0;
+	double buffering = (double) play->buffer + (double) cap->period;
+
+	report_section("Round-Trip Latency Summary");
+
+	struct report_tab *t = report_tab_begin();
+	report_kv(t, "Playback device", "%s", cfg->pcm.dev);
+	report_kv(t, "Capture device", "%s", cfg->capture_dev);
+	report_kv(t, "Rate", "%u Hz", rate);
+	report_kv(t, "Format", "%s", snd_pcm_format_name(cfg->pcm.format));
+	report_kv(t, "Channels", "%u", cfg->pcm.channels);
+	report_kv(t, "Playback period/buffer", "%lu / %lu frames",
+		  play->period, play->buffer);
+	report_kv(t, "Capture period/buffer", "%lu / %lu frames", cap->period,
+		  cap->buffer);
+	report_kv(t, "Start alignment", "%s",
+		  linked ? "snd_pcm_link" : "trigger timestamps");
+	report_kv(t, "Termination", "%s",
+		  runtime_error	     ? "runtime error"
+		  : stop_requested() ? "interrupted"
+				     : "duration reached");
+	report_tab_end(t);
+
+	printf("Hardware round trip:\n");
+	t = report_tab_begin();
+	report_kv(t, "Measurements", "%" PRIu64, n);
+	report_kv(t, "Missed bursts", "%" PRIu64, s->missed);
+	report_kv(t, "Stream restarts", "%" PRIu64, s->restarts);
+	if (n > 0) {
+		report_kv(t, "Min", "%.1f frames (%.3f ms)", s->min_frames,
+			  s->min_frames * 1000.0 / rate);
+		report_kv(t, "Avg", "%.1f frames (%.3f ms)", avg,
+			  avg * 1000.0 / rate);
+		report_kv(t, "Max", "%.1f frames (%.3f ms)", s->max_frames,
+			  s->max_frames * 1000.0 / rate);
+		report_kv(t, "Jitter (stddev)", "%.2f frames (%.3f ms)",
+			  jitter, jitter * 1000.0 / rate);
+		report_kv(t, "With buffering", "%.1f frames (%.3f ms)",
+			  avg + buffering, (avg + buffering) * 1000.0 / rate);
+	}
+	report_tab_end(t);
+
+	if (runtime_error)
+		report_fail("round-trip measurement did not complete");
+	else if (n == 0)
+		report_fail("the test signal was never detected; check the "
+			    "loopback connection and capture levels");
+	else if (s->max_frames - s->min_frames > 1.0)
+		report_warn("the round trip varies by %.0f frames",
+			    s->max_frames - s->min_frames);
+	else
+		report_ok("round trip is stable at %.1f frames", avg);
+}
+
+static void roundtrip_usage(const char *prog) {
+	pcm_setup_usage(prog);
+	usage_opt("-C NAME", "capture PCM (default: same as -D)");
+	usage_opt("-i MS", "interval between test bursts (default 1000)");
+	usage_opt("-m MS", "longest round trip searched (default 250)");
+	usage_opt("-v", "increase log level (-v info, -vv debug, -vvv trace)");
+	usage_opt("-h", "help");
+}
+
+static int parse_ms(const char *arg, const char *what, unsigned int *out) {
+	int err;
+	long val = parse_long(arg, what, &err);
+	if (err < 0)
+		return -1;
+	if (val < 1 || val > 60000) {
+		fprintf(stderr, "invalid %s argument '%s'\n", what, arg);
+		return -1;
+	}
+	*out = (unsigned int) val;
+	return 0;
+}
+
+static int roundtrip_loop(struct roundtrip_cfg *cfg,
+			  struct roundtrip_pcm *play,
+			  struct roundtrip_pcm *cap, bool linked,
+			  struct roundtrip_stats *stats) {
+	const struct pcm_setup *pcm = &cfg->pcm;
+	size_t interval = (size_t) cfg->interval_ms * pcm->rate / 1000;
+	size_t max_lag = (size_t) cfg->max_lag_ms * pcm->rate / 1000;
+	size_t window = max_lag + MLS_LEN;
+	size_t frame_bytes = snd_pcm_format_physical_width(pcm->format) / 8 *
+			     pcm->channels;
+	struct correlator corr = {0};
+	float mls[MLS_LEN];
+	int err = 0;
+
+	/* the capture ring keeps one analysis window plus a period of
+	 * slack; bursts are analysed as soon as their window is complete */
+	size_t ring_len = 1;
+	while (ring_len < window + cap->period)
+		ring_len <<= 1;
+
+	void *play_buf = calloc(play->period, frame_bytes);
+	void *cap_buf = calloc(cap->period, frame_bytes);
+	float *ring = calloc(ring_len, sizeof(float));
+	float *win = calloc(window, sizeof(float));
+	mls_generate(mls);
+	if (!play_buf || !cap_buf || !ring || !win ||
+	    correlator_init(&corr, mls, window) < 0) {
+		log_error("Could not allocate the round-trip buffers");
+		err = -ENOMEM;
+		goto out;
+	}
+
+	uint64_t end_ns = UINT64_MAX;
+	if (pcm->duration_sec)
+		end_ns = now_ns() +
+			 (uint64_t) pcm->duration_sec * 1000000000ULL;
+
+restart:;
+	double offset;
+	memset(play_buf, 0, play->period * frame_bytes);
+	if ((err = roundtrip_start(play, cap, linked, play_buf, pcm->rate,
+				   &offset)) < 0)
+		goto out;
+
+	/* the prefill is silence, the first burst follows it; the signal
+	 * is a pure function of the frame position so that interrupted
+	 * (partial) writes simply continue where they stopped */
+	uint64_t play_pos = play->buffer;
+	uint64_t cap_pos = 0;
+	uint64_t first_burst = (play_pos + interval - 1) / interval * interval;
+	uint64_t analyse = first_burst;
+
+	while (!stop_requested() && now_ns() < end_ns) {
+		for (snd_pcm_uframes_t i = 0; i < play->period; i++) {
+			uint64_t pos = play_pos + i;
+			uint64_t rel = (pos - first_burst) % interval;
+			float v = 0.0f;
+			if (pos >= first_burst && rel < MLS_LEN)
+				v = mls[rel];
+			put_frame(play_buf, i, pcm->channels, pcm->format, v);
+		}
+
+		snd_pcm_sframes_t w =
+			snd_pcm_writei(play->hndl, play_buf, play->period);
+		if (w == -EINTR)
+			continue;
+		if (w >= 0) {
+			play_pos += (uint64_t) w;
+			w = snd_pcm_readi(cap->hndl, cap_buf, cap->period);
+			if (w == -EINTR)
+				continue;
+		}
+		if (w < 0) {
+			/* an xrun breaks the frame correspondence: restart
+			 * both streams from frame 0 */
+			log_warn("XRUN, restarting both streams: %s",
+				 snd_strerror(w));
+			stats->restarts++;
+			goto restart;
+		}
+		snd_pcm_sframes_t r = w;
+
+		for (snd_pcm_sframes_t i = 0; i < r; i++)
+			ring[(cap_pos + i) & (ring_len - 1)] = get_frame(
+				cap_buf, i, pcm->channels, pcm->format);
+		cap_pos += (uint64_t) r;
+
+		while (cap_pos >= analyse + window) {
+			for (size_t i = 0; i < window; i++)
+				win[i] = ring[(analyse + i) & (ring_len - 1)];
+
+			double ratio;
+			size_t lag = correlate(&corr, win, window, max_lag,
+					       &ratio);
+			if (ratio >= MIN_PEAK_RATIO) {
+				record_measurement(stats,
+						   (double) lag - offset,
+						   ratio, pcm->rate);
+			} else {
+				stats->missed++;
+				log_warn("No test signal found in the capture "
+					 "(peak ratio %.1f)",
+					 ratio);
+			}
+			analyse += interval;
+		}
+	}
+
+out:
+	correlator_free(&corr);
+	free(play_buf);
+	free(cap_buf);
+	free(ring);
+	free(win);
+	return err;
+}
+
+static int roundtrip_run(int argc, char **argv) {
+	struct roundtrip_cfg cfg = {
+		.capture_dev = NULL,
+		.interval_ms = 1000,
+		.max_lag_ms = 250,
+	};
+
+	pcm_setup_defaults(&cfg.pcm);
+
+	int verbose = 0;
+	int opt;
+	while ((opt = getopt(argc, argv,
+			     PCM_OPTSTRING "C:i:m:" COMMON_OPTSTRING)) != -1) {
+		switch (opt) {
+		case 'C':
+			cfg.capture_dev = optarg;
+			break;
+		case 'i':
+			if (parse_ms(optarg, "interval", &cfg.interval_ms) <
+			    0) {
+				roundtrip_usage(argv[0]);
+				return 2;
+			}
+			break;
+		case 'm':
+			if (parse_ms(optarg, "max-lag", &cfg.max_lag_ms) < 0) {
+				roundtrip_usage(argv[0]);
+				return 2;
+			}
+			break;
+		case 'v':
+			verbose++;
+			break;
+		case 'h':
+			roundtrip_usage(argv[0]);
+			return 0;
+		default:
+			if (!pcm_setup_parse_opt(&cfg.pcm, opt, optarg)) {
+				roundtrip_usage(argv[0]);
+				return 2;
+			}
+		}
+	}
+	if (optind < argc) {
+		fprintf(stderr, "unexpected argument '%s'\n", argv[optind]);
+		roundtrip_usage(argv[0]);
+		return 2;
+	}
+	if (!pcm_setup_check(&cfg.pcm)) {
+		roundtrip_usage(argv[0]);
+		return 2;
+	}
+	if (cfg.capture_dev == NULL)
+		cfg.capture_dev = cfg.pcm.dev;
+	if (!format_supported(cfg.pcm.format)) {
+		fprintf(stderr, "unsupported format: %s (use S16_LE, S32_LE "
+				"or FLOAT_LE)\n",
+			snd_pcm_format_name(cfg.pcm.format));
+		return 2;
+	}
+	if ((uint64_t) cfg.interval_ms * cfg.pcm.rate / 1000 <
+	    (uint64_t) cfg.max_lag_ms * cfg.pcm.rate / 1000 + MLS_LEN) {
+		fprintf(stderr, "the interval must exceed the max-lag plus "
+				"the %u-frame test sequence\n",
+			MLS_LEN);
+		return 2;
+	}
+
+	log_set_verbose(verbose);
+
+	struct roundtrip_pcm play = {0}, cap = {0};
+	struct roundtrip_stats stats = {0};
+	int err;
+
+	if ((err = roundtrip_open(&play, cfg.pcm.dev, SND_PCM_STREAM_PLAYBACK,
+				  &cfg.pcm)) < 0 ||
+	    (err = roundtrip_open(&cap, cfg.capture_dev,
+				  SND_PCM_STREAM_CAPTURE, &cfg.pcm)) < 0)
+		goto out;
+
+	bool linked = snd_pcm_link(cap.hndl, play.hndl) >= 0;
+	if (!linked)
+		log_info("The PCMs cannot be linked; aligning the streams "
+			 "with trigger timestamps");
+
+	log_info("Round-trip measurement started: %s -> %s, %s, %u Hz",
+		 cfg.pcm.dev, cfg.capture_dev,
+		 snd_pcm_format_name(cfg.pcm.format), cfg.pcm.rate);
+	err = roundtrip_loop(&cfg, &play, &cap, linked, &stats);
+	if (err == 0)
+		log_info("Round-trip measurement stopped %s",
+			 stop_requested() ? "after interruption"
+					  : "after the requested duration");
+
+	if (linked)
+		snd_pcm_unlink(cap.hndl);
+	print_report(&stats, &cfg, &play, &cap, linked, err);
+
+out:
+	if (play.hndl)
+		snd_pcm_close(play.hndl);
+	if (cap.hndl)
+		snd_pcm_close(cap.hndl);
+	return err < 0 || stats.measurements == 0 ? 1 : 0;
+}
+
+static struct applet roundtrip_applet = {
+	.name = "roundtrip",
+	.desc = "measure loopback round-trip latency",
+	.main = roundtrip_run,
+	.usage = roundtrip_usage,
+	.next = NULL,
+};
+
+APPLET_REGISTER(roundtrip_applet);
@@ -5,6 +5,16 @@
  * reads the status and accounts the missing frames from the trigger
  * timestamp; the xrun_cb hook fires where pipewire would call
  * spa_node_call_xrun().
+ *
+ * Every cycle also records the headroom margin: the buffer fill reported
+ * by get_status() minus what the hardware consumed between that reading
+ * and the cycle hook, i.e. the lowest fill before the buffer is refilled.
+ * A run without xruns but with a margin of a few frames is reported as a
+ * warning (threshold -m).
+ *
+ * With -H the card is followed across unplug/replug (alsa-hotplug.c):
+ * the stream is reopened on the returning card and the statistics keep
+ * accumulating, with the reconnect gap reported separately.
  */
 
 #include <inttypes.h>
@@ -12,10 +22,13 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include "alsa-hotplug.h"
 #include "alsa-pcm.h"
 #include "app-common.h"
 
 #define MAX_HISTOGRAM_BUCKETS 128
+/* headroom margin buckets, 1/16 period each like the interval histogram */
+#define MAX_MARGIN_BUCKETS 128
 
 struct xrun_stats {
 	uint64_t callback_count;
@@ -28,13 +41,56 @@ struct xrun_stats {
 	uint64_t first_xrun_ns;
 	uint64_t last_xrun_ns;
 	uint64_t start_ns;
+
+	/* headroom margin in frames; min_margin is valid once
+	 * margin_count > 0 */
+	uint64_t margin_count;
+	int64_t margin_sum;
+	int64_t min_margin;
+	uint64_t min_margin_ns;
+	uint64_t margin_histogram[MAX_MARGIN_BUCKETS];
+	/* cycles below warn_margin frames */
+	int64_t warn_margin;
+	uint64_t low_margin_count;
 };
 
+static void record_margin(struct xrun_stats *s, struct alsa_state *st,
+			  uint64_t now) {
+	int64_t consumed = 0;
+	if (now > st->last_status_ns)
+		consumed = (int64_t) ((now - st->last_status_ns) * st->rate /
+				      1000000000ULL);
+	int64_t margin = (int64_t) st->last_delay - consumed;
+
+	if (s->margin_count == 0 || margin < s->min_margin) {
+		s->min_margin = margin;
+		s->min_margin_ns = now - s->start_ns;
+	}
+	s->margin_count++;
+	s->margin_sum += margin;
+	if (margin < s->warn_margin) {
+		s->low_margin_count++;
+		log_debug("Low headroom at +%.3f s: %" PRIi64
+			  " frames (fill %lu; %" PRIi64 " consumed since the "
+			  "status read)",
+			  (now - s->start_ns) / 1e9, margin, st->last_delay,
+			  consumed);
+	}
+
+	uint64_t bucket = 0;
+	if (margin > 0 && st->threshold > 0)
+		bucket = (uint64_t) margin * 16 / st->threshold;
+	if (bucket >= MAX_MARGIN_BUCKETS)
+		bucket = MAX_MARGIN_BUCKETS - 1;
+	s->margin_histogram[bucket]++;
+}
+
 static void on_cycle(struct alsa_state *st, void *data) {
 	struct xrun_stats *s = data;
 	uint64_t now = now_ns();
 	uint64_t last = s->last_callback_ns;
 	s->last_callback_ns = now;
+	record_margin(s, st, now);
 	if (last != 0) {
 		uint64_t interval = now - last;
 		s->callback_count++;
@@ -71,7 +127,8 @@ static void on_xrun(struct alsa_state *st, uint64_t missing, void *data) {
 
 static void print_report(const struct xrun_stats *s, uint64_t test_duration_ns,
 			 const struct pcm_setup *cfg,
-			 const struct alsa_state *st, int runtime_error) {
+			 const struct alsa_state *st,
+			 const struct hotplug_monitor *hp, int runtime_error) {
 	uint64_t cb = s->callback_count;
 	uint64_t xr = s->xrun_count;
 	uint64_t sum = s->sum_ns;
@@ -97,6 +154,8 @@ static void print_report(const struct xrun_stats *s, uint64_t test_duration_ns,
 		  : stop_requested() ? "interrupted"
 				     : "duration reached");
 	report_kv(t, "Theoretical period", "%.2f us", period_us);
+	if (hp)
+		hotplug_report(t, hp);
 	report_tab_end(t);
 
 	printf("Callback statistics:\n");
@@ -116,6 +175,40 @@ static void print_report(const struct xrun_stats *s, uint64_t test_duration_ns,
 	}
 	report_tab_end(t);
 
+	double ms_per_frame = 1000.0 / st->rate;
+	printf("Headroom margin (fill before refill):\n");
+	t = report_tab_begin();
+	report_kv(t, "Cycles", "%" PRIu64, s->margin_count);
+	if (s->margin_count > 0) {
+		double avg = (double) s->margin_sum / s->margin_count;
+		report_kv(t, "Min margin", "%" PRIi64 " frames (%.2f ms) at "
+			  "+%.3f s", s->min_margin,
+			  s->min_margin * ms_per_frame,
+			  s->min_margin_ns / 1e9);
+		report_kv(t, "Avg margin", "%.1f frames (%.2f ms)", avg,
+			  avg * ms_per_frame);
+	}
+	report_kv(t, "Warning threshold", "%" PRIi64 " frames (%.2f ms)",
+		  s->warn_margin, s->warn_margin * ms_per_frame);
+	report_kv(t, "Low-margin cycles", "%" PRIu64, s->low_margin_count);
+	report_tab_end(t);
+
+	printf("Histogram (margin / theoretical period):\n");
+	for (int i = 0; i < MAX_MARGIN_BUCKETS; i++) {
+		uint64_t v = s->margin_histogram[i];
+		if (v == 0)
+			continue;
+		double lo = i * period_us / 16.0;
+		double hi = (i + 1) * period_us / 16.0;
+		if (i == 0)
+			printf("  [       < %6.1f us]: %" PRIu64 "\n", hi, v);
+		else if (i == MAX_MARGIN_BUCKETS - 1)
+			printf("  [>= %6.1f us]       : %" PRIu64 "\n", lo, v);
+		else
+			printf("  [%6.1f - %6.1f) us: %" PRIu64 "\n", lo, hi,
+			       v);
+	}
+
 	printf("Histogram (interval / theoretical period):\n");
 	for (int i = 0; i < MAX_HISTOGRAM_BUCKETS; i++) {
 		uint64_t v = s->histogram[i];
@@ -134,12 +227,20 @@ static void print_report(const struct xrun_stats *s, uint64_t test_duration_ns,
 		report_fail("XRUN monitoring did not complete");
 	else if (xr > 0)
 		report_warn("%" PRIu64 " XRUNs detected", xr);
+	else if (s->low_margin_count > 0)
+		report_warn("no XRUNs, but %" PRIu64 " cycles had less than "
+			    "%" PRIi64 " frames of headroom",
+			    s->low_margin_count, s->warn_margin);
 	else
 		report_ok("no XRUNs detected");
 }
 
 static void xrun_usage(const char *prog) {
 	pcm_setup_usage(prog);
+	usage_opt("-H", "follow the card across unplug/replug");
+	usage_opt("-m FRAMES",
+		  "warn when the headroom margin drops below FRAMES "
+		  "(default: a quarter period)");
 	usage_opt("-v", "increase log level (-v info, -vv debug, -vvv trace)");
 	usage_opt("-h", "help");
 }
@@ -150,10 +251,28 @@ static int xrun_run(int argc, char **argv) {
 	pcm_setup_defaults(&cfg);
 
 	int verbose = 0;
-	int opt;
-	while ((opt = getopt(argc, argv, PCM_OPTSTRING COMMON_OPTSTRING)) !=
-	       -1) {
+	bool hotplug = false;
+	long warn_margin = -1;
+	int opt, err;
+	while ((opt = getopt(argc, argv,
+			     PCM_OPTSTRING HOTPLUG_OPTSTRING
+				     "m:" COMMON_OPTSTRING)) != -1) {
 		switch (opt) {
+		case 'H':
+			hotplug = true;
+			break;
+		case 'm':
+			warn_margin = parse_long(optarg, "margin", &err);
+			if (err < 0 || warn_margin < 0) {
+				if (err == 0)
+					fprintf(stderr,
+						"invalid margin argument "
+						"'%s'\n",
+						optarg);
+				xrun_usage(argv[0]);
+				return 2;
+			}
+			break;
 		case 'v':
 			verbose++;
 			break;
@@ -179,13 +298,22 @@ static int xrun_run(int argc, char **argv) {
 
 	log_set_verbose(verbose);
 
+	struct hotplug_monitor hp;
+	if (hotplug && hotplug_open(&hp, cfg.dev) < 0)
+		return 1;
+
 	struct alsa_state st;
 	alsa_state_init(&st);
-	if (pcm_sink_open(&st, &cfg) < 0)
+	if (pcm_sink_open(&st, &cfg) < 0) {
+		if (hotplug)
+			hotplug_close(&hp);
 		return 1;
+	}
 
 	struct xrun_stats stats = {0};
 	stats.start_ns = now_ns();
+	stats.warn_margin = warn_margin >= 0 ? warn_margin
+					     : (int64_t) st.period_frames / 4;
 	st.cycle_cb = on_cycle;
 	st.cycle_data = &stats;
 	st.xrun_cb = on_xrun;
@@ -193,6 +321,8 @@ static int xrun_run(int argc, char **argv) {
 
 	if (pcm_sink_start(&st) < 0) {
 		pcm_sink_stop(&st);
+		if (hotplug)
+			hotplug_close(&hp);
 		return 1;
 	}
 	log_info("XRUN monitoring started: %s, %u channels, %u Hz",
@@ -221,6 +351,18 @@ static int xrun_run(int argc, char **argv) {
 				continue;
 			break;
 		}
+		if (res < 0 && res != -EAGAIN && hotplug &&
+		    hotplug_is_disconnect(&st, res)) {
+			res = hotplug_reconnect(&hp, &st, &cfg, end_ns);
+			if (res == -EINTR || res == -ETIMEDOUT)
+				break;
+			/* the gap is reported separately, it is not a
+			 * callback interval */
+			if (res == 0) {
+				stats.last_callback_ns = 0;
+				continue;
+			}
+		}
 		if (res < 0 && res != -EAGAIN) {
 			log_error("XRUN monitoring stopped: %s",
 				  snd_strerror(res));
@@ -236,7 +378,10 @@ static int xrun_run(int argc, char **argv) {
 	uint64_t end = now_ns();
 	pcm_sink_stop(&st);
 
-	print_report(&stats, end - stats.start_ns, &cfg, &st, runtime_error);
+	print_report(&stats, end - stats.start_ns, &cfg, &st,
+		     hotplug ? &hp : NULL, runtime_error);
+	if (hotplug)
+		hotplug_close(&hp);
 
 	return runtime_error || stats.xrun_count > 0 ? 1 : 0;
 }
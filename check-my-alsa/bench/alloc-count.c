@@ -0,0 +1,75 @@
+/*
+ * alloc-count.c - LD_PRELOAD shim counting heap allocations.
+ *
+ * Wraps the glibc allocator entry points through their __libc_ aliases
+ * (dlsym() would allocate itself) and, when the process exits, writes
+ * "ALLOCS FREES BYTES" to the file descriptor named by
+ * CHECK_MY_ALSA_ALLOC_FD. bench-run.c reads it back.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static uint64_t allocs;
+static uint64_t frees;
+static uint64_t bytes;
+
+static void count_alloc(size_t size) {
+	__atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&bytes, size, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size) {
+	count_alloc(size);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+	count_alloc(nmemb * size);
+	return __libc_calloc(nmemb, size);
+}
+
+/* a realloc is counted as an allocation: it may move the block */
+void *realloc(void *ptr, size_t size) {
+	count_alloc(size);
+	return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+	count_alloc(size);
+	return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+	return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+	void *p = memalign(alignment, size);
+	if (p == NULL)
+		return ENOMEM;
+	*memptr = p;
+	return 0;
+}
+
+void free(void *ptr) {
+	if (ptr)
+		__atomic_fetch_add(&frees, 1, __ATOMIC_RELAXED);
+	__libc_free(ptr);
+}
+
+__attribute__((destructor)) static void alloc_count_report(void) {
+	const char *fd = getenv("CHECK_MY_ALSA_ALLOC_FD");
+	if (fd == NULL)
+		return;
+	dprintf(atoi(fd), "%llu %llu %llu\n", (unsigned long long) allocs,
+		(unsigned long long) frees, (unsigned long long) bytes);
+}
@@ -0,0 +1,393 @@
+/*
+ * bench-run.c - run one check-my-alsa applet and compare its resource
+ * usage with a stored baseline (meson test --benchmark).
+ *
+ * The applet runs as a child for a fixed duration against a null or
+ * simulated PCM. wait4() supplies CPU time, peak RSS and voluntary
+ * context switches (one per timer wakeup of the sink driver, plus the
+ * few of startup); the cycle count is read from the applet report row
+ * named with -k, the allocation count from the alloc-count.c shim.
+ *
+ * The baseline file has one line per benchmark:
+ *   NAME CPU-US-PER-CYCLE PEAK-RSS-KB ALLOCS WAKEUPS-PER-S
+ * A metric that exceeds its baseline by more than its tolerance fails
+ * the benchmark. With CHECK_MY_ALSA_BENCH_UPDATE=1 in the environment
+ * the line is written instead.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../app-common.h"
+
+/* app-common.c polls it; the runner is never interrupted early */
+volatile sig_atomic_t g_stop = 0;
+
+#define OUTPUT_MAX (64 * 1024)
+
+/* allowed growth over the baseline; CPU time is the noisiest */
+#define TOL_CPU 0.50
+#define TOL_RSS 0.20
+#define TOL_ALLOCS 0.10
+#define TOL_WAKEUPS 0.20
+
+struct bench_result {
+	double cpu_us_per_cycle;
+	long peak_rss_kb;
+	uint64_t allocs;
+	double wakeups_per_s;
+};
+
+struct bench_run {
+	const char *name;
+	const char *cycle_key;
+	const char *baseline;
+	const char *shim;
+	char **argv;
+
+	uint64_t cycles;
+	uint64_t wall_ns;
+	uint64_t cpu_ns;
+	uint64_t frees;
+	uint64_t alloc_bytes;
+	bool have_allocs;
+	struct bench_result res;
+};
+
+static void bench_usage(const char *prog) {
+	usage_header(prog,
+		     "-n NAME -k KEY [-b FILE] [-a SHIM] -- CMD [ARGS...]");
+	usage_opt("-n NAME", "benchmark name (baseline key)");
+	usage_opt("-k KEY", "report row that holds the cycle count");
+	usage_opt("-b FILE", "baseline file");
+	usage_opt("-a SHIM", "alloc-count.c module to preload");
+	usage_opt("-v", "increase log level (-v info, -vv debug, -vvv trace)");
+	usage_opt("-h", "help");
+}
+
+/* "  KEY<pad> : VALUE" as written by report_tab_end() */
+static bool find_row(const char *out, const char *key, uint64_t *val) {
+	size_t klen = strlen(key);
+
+	for (const char *p = out; p && *p; p = strchr(p, '\n')) {
+		if (*p == '\n')
+			p++;
+		if (strncmp(p, "  ", 2) != 0 || strncmp(p + 2, key, klen) != 0)
+			continue;
+		const char *q = p + 2 + klen;
+		while (*q == ' ')
+			q++;
+		if (*q != ':')
+			continue;
+		*val = strtoull(q + 1, NULL, 10);
+		return true;
+	}
+	return false;
+}
+
+/* read until EOF; what does not fit into buf is discarded so that the
+ * child never blocks on a full pipe */
+static void read_all(int fd, char *buf, size_t size) {
+	char drop[4096];
+	size_t len = 0;
+	ssize_t n;
+
+	for (;;) {
+		if (len + 1 < size)
+			n = read(fd, buf + len, size - len - 1);
+		else
+			n = read(fd, drop, sizeof(drop));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		if (len + 1 < size)
+			len += (size_t) n;
+	}
+	buf[len] = '\0';
+}
+
+static int run_child(struct bench_run *b) {
+	int out[2], acc[2];
+	char fdstr[16];
+
+	if (pipe2(out, O_CLOEXEC) < 0 || pipe2(acc, O_CLOEXEC) < 0) {
+		int err = -errno;
+		log_error("Could not create pipes: %s", strerror(errno));
+		return err;
+	}
+
+	uint64_t start = now_ns();
+	pid_t pid = fork();
+	if (pid < 0) {
+		int err = -errno;
+		log_error("Could not fork: %s", strerror(errno));
+		return err;
+	}
+	if (pid == 0) {
+		dup2(out[1], STDOUT_FILENO);
+		/* dup2() drops O_CLOEXEC, the shim writes to this copy */
+		int afd = dup(acc[1]);
+		snprintf(fdstr, sizeof(fdstr), "%d", afd);
+		setenv("CHECK_MY_ALSA_ALLOC_FD", fdstr, 1);
+		if (b->shim)
+			setenv("LD_PRELOAD", b->shim, 1);
+		execvp(b->argv[0], b->argv);
+		fprintf(stderr, "cannot execute '%s': %s\n", b->argv[0],
+			strerror(errno));
+		_exit(127);
+	}
+	close(out[1]);
+	close(acc[1]);
+
+	static char output[OUTPUT_MAX];
+	read_all(out[0], output, sizeof(output));
+	close(out[0]);
+
+	int status;
+	struct rusage ru;
+	while (wait4(pid, &status, 0, &ru) < 0)
+		if (errno != EINTR) {
+			int err = -errno;
+			log_error("wait4 failed: %s", strerror(errno));
+			close(acc[0]);
+			return err;
+		}
+	b->wall_ns = now_ns() - start;
+
+	char counts[128];
+	unsigned long long allocs, frees, bytes;
+	read_all(acc[0], counts, sizeof(counts));
+	close(acc[0]);
+	if (sscanf(counts, "%llu %llu %llu", &allocs, &frees, &bytes) == 3) {
+		b->have_allocs = true;
+		b->res.allocs = allocs;
+		b->frees = frees;
+		b->alloc_bytes = bytes;
+	}
+
+	/* pass the applet report through for the benchmark log */
+	fputs(output, stdout);
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		log_error("'%s' %s %d", b->argv[0],
+			  WIFEXITED(status) ? "exited with status"
+					    : "was killed by signal",
+			  WIFEXITED(status) ? WEXITSTATUS(status)
+					    : WTERMSIG(status));
+		return -ECHILD;
+	}
+	if (!find_row(output, b->cycle_key, &b->cycles) || b->cycles == 0) {
+		log_error("The report has no cycle count in row '%s'",
+			  b->cycle_key);
+		return -EINVAL;
+	}
+
+	b->cpu_ns = (uint64_t) ru.ru_utime.tv_sec * 1000000000ULL +
+		    (uint64_t) ru.ru_utime.tv_usec * 1000ULL +
+		    (uint64_t) ru.ru_stime.tv_sec * 1000000000ULL +
+		    (uint64_t) ru.ru_stime.tv_usec * 1000ULL;
+	b->res.cpu_us_per_cycle = b->cpu_ns / 1e3 / b->cycles;
+	b->res.peak_rss_kb = ru.ru_maxrss;
+	b->res.wakeups_per_s = ru.ru_nvcsw / (b->wall_ns / 1e9);
+	return 0;
+}
+
+/* returns 1 when name was found, 0 otherwise (also for a missing file) */
+static int baseline_load(const char *path, const char *name,
+			 struct bench_result *r) {
+	FILE *f = fopen(path, "r");
+	char line[256], key[64];
+	int found = 0;
+
+	if (f == NULL)
+		return 0;
+	while (!found && fgets(line, sizeof(line), f)) {
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "%63s %lf %ld %" SCNu64 " %lf", key,
+			   &r->cpu_us_per_cycle, &r->peak_rss_kb, &r->allocs,
+			   &r->wakeups_per_s) == 5 &&
+		    strcmp(key, name) == 0)
+			found = 1;
+	}
+	fclose(f);
+	return found;
+}
+
+/* rewrite path with the line for name replaced (or appended) */
+static int baseline_store(const char *path, const char *name,
+			  const struct bench_result *r) {
+	char tmp[4096], line[256], key[64];
+	FILE *in = fopen(path, "r");
+	FILE *out;
+	bool written = false;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if ((out = fopen(tmp, "w")) == NULL) {
+		int err = -errno;
+		log_error("Could not write %s: %s", tmp, strerror(errno));
+		if (in)
+			fclose(in);
+		return err;
+	}
+	while (in && fgets(line, sizeof(line), in)) {
+		if (line[0] != '#' && sscanf(line, "%63s", key) == 1 &&
+		    strcmp(key, name) == 0) {
+			if (written)
+				continue;
+			fprintf(out, "%s %.2f %ld %" PRIu64 " %.1f\n", name,
+				r->cpu_us_per_cycle, r->peak_rss_kb, r->allocs,
+				r->wakeups_per_s);
+			written = true;
+			continue;
+		}
+		fputs(line, out);
+	}
+	if (!written)
+		fprintf(out, "%s %.2f %ld %" PRIu64 " %.1f\n", name,
+			r->cpu_us_per_cycle, r->peak_rss_kb, r->allocs,
+			r->wakeups_per_s);
+	if (in)
+		fclose(in);
+	if (fclose(out) != 0 || rename(tmp, path) < 0) {
+		int err = -errno;
+		log_error("Could not update %s: %s", path, strerror(errno));
+		return err;
+	}
+	return 0;
+}
+
+/* one "value (baseline; +x%)" row; returns true when over tolerance */
+static bool compare(struct report_tab *t, const char *key, const char *unit,
+		    double val, double base, double tol) {
+	const char *sep = *unit ? " " : "";
+
+	if (base <= 0) {
+		report_kv(t, key, "%.6g%s%s (baseline 0)", val, sep, unit);
+		return val > 0;
+	}
+	double change = (val - base) / base;
+	report_kv(t, key, "%.6g%s%s (baseline %.6g; %+.1f%%; limit +%.0f%%)",
+		  val, sep, unit, base, change * 100.0, tol * 100.0);
+	return change > tol;
+}
+
+static int bench_report(struct bench_run *b) {
+	const struct bench_result *r = &b->res;
+	struct bench_result base;
+	bool update = getenv("CHECK_MY_ALSA_BENCH_UPDATE") != NULL;
+	int found = 0;
+
+	if (b->baseline && !update)
+		found = baseline_load(b->baseline, b->name, &base);
+
+	report_section("Benchmark '%s'", b->name);
+
+	struct report_tab *t = report_tab_begin();
+	report_kv(t, "Duration", "%.3f s", b->wall_ns / 1e9);
+	report_kv(t, "Cycles", "%" PRIu64, b->cycles);
+	report_kv(t, "CPU time", "%.3f s", b->cpu_ns / 1e9);
+	if (b->have_allocs)
+		report_kv(t, "Heap", "%" PRIu64 " allocations; %" PRIu64
+			  " frees; %" PRIu64 " bytes",
+			  r->allocs, b->frees, b->alloc_bytes);
+	report_tab_end(t);
+
+	if (!found) {
+		t = report_tab_begin();
+		report_kv(t, "CPU per cycle", "%.2f us", r->cpu_us_per_cycle);
+		report_kv(t, "Peak RSS", "%ld kB", r->peak_rss_kb);
+		if (b->have_allocs)
+			report_kv(t, "Allocations", "%" PRIu64, r->allocs);
+		report_kv(t, "Wakeups", "%.1f /s", r->wakeups_per_s);
+		report_tab_end(t);
+
+		if (b->baseline && update) {
+			if (baseline_store(b->baseline, b->name, r) < 0)
+				return 1;
+			report_ok("baseline for '%s' written to %s", b->name,
+				  b->baseline);
+		} else {
+			report_note("no baseline for '%s'; set "
+				    "CHECK_MY_ALSA_BENCH_UPDATE=1 to record "
+				    "one",
+				    b->name);
+		}
+		return 0;
+	}
+
+	int regressions = 0;
+	t = report_tab_begin();
+	regressions += compare(t, "CPU per cycle", "us", r->cpu_us_per_cycle,
+			       base.cpu_us_per_cycle, TOL_CPU);
+	regressions += compare(t, "Peak RSS", "kB", r->peak_rss_kb,
+			       base.peak_rss_kb, TOL_RSS);
+	if (b->have_allocs)
+		regressions += compare(t, "Allocations", "", r->allocs,
+				       base.allocs, TOL_ALLOCS);
+	regressions += compare(t, "Wakeups", "/s", r->wakeups_per_s,
+			       base.wakeups_per_s, TOL_WAKEUPS);
+	report_tab_end(t);
+
+	if (regressions > 0) {
+		report_fail("%d metrics regressed against the baseline",
+			    regressions);
+		return 1;
+	}
+	report_ok("within the baseline tolerances");
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	struct bench_run b = {0};
+	int verbose = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:k:b:a:" COMMON_OPTSTRING)) != -1) {
+		switch (opt) {
+		case 'n':
+			b.name = optarg;
+			break;
+		case 'k':
+			b.cycle_key = optarg;
+			break;
+		case 'b':
+			b.baseline = optarg;
+			break;
+		case 'a':
+			b.shim = optarg;
+			break;
+		case 'v':
+			verbose++;
+			break;
+		case 'h':
+			bench_usage(argv[0]);
+			return 0;
+		default:
+			bench_usage(argv[0]);
+			return 2;
+		}
+	}
+	if (b.name == NULL || b.cycle_key == NULL || optind >= argc) {
+		fprintf(stderr,
+			"missing required -n, -k or command argument\n");
+		bench_usage(argv[0]);
+		return 2;
+	}
+	b.argv = argv + optind;
+
+	log_set_verbose(verbose);
+	log_info("Running %s for benchmark '%s'", b.argv[0], b.name);
+
+	if (run_child(&b) < 0)
+		return 1;
+	return bench_report(&b);
+}
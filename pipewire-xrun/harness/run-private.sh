@@ -0,0 +1,118 @@
+#!/bin/bash
+# run-private.sh - run pipewire-xrun against a private PipeWire instance
+#
+# usage: run-private.sh [-x PATH] [-w] [-k] [--] [pipewire-xrun options]
+#
+#   -x PATH  pipewire-xrun binary (default: $PIPEWIRE_XRUN,
+#            ../build/pipewire-xrun or pipewire-xrun from $PATH)
+#   -w       also start wireplumber, so streams link to the null sink
+#            (needed for -m capture and -m duplex)
+#   -k       keep the runtime directory with pipewire.log
+#
+# The instance lives in a temporary PIPEWIRE_RUNTIME_DIR with its own XDG
+# directories, so neither the desktop session nor user configuration can
+# change the result. The exit status is the one of pipewire-xrun.
+
+set -euo pipefail
+export LC_ALL=C
+
+usage() {
+	sed -n 's/^# \{0,1\}//; 4,11p' "$0"
+}
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+XRUN=${PIPEWIRE_XRUN:-}
+SESSION_MANAGER=0
+KEEP=0
+
+while getopts "x:wkh" opt; do
+	case "$opt" in
+	x) XRUN=$OPTARG ;;
+	w) SESSION_MANAGER=1 ;;
+	k) KEEP=1 ;;
+	h)
+		usage
+		exit 0
+		;;
+	*)
+		usage >&2
+		exit 2
+		;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [[ -z "$XRUN" ]]; then
+	if [[ -x "$HERE/../build/pipewire-xrun" ]]; then
+		XRUN=$HERE/../build/pipewire-xrun
+	else
+		XRUN=$(command -v pipewire-xrun || true)
+	fi
+fi
+if [[ -z "$XRUN" || ! -x "$XRUN" ]]; then
+	echo "error: pipewire-xrun not found, use -x or PIPEWIRE_XRUN" >&2
+	exit 2
+fi
+if ! command -v pipewire >/dev/null; then
+	echo "error: pipewire is not installed" >&2
+	exit 2
+fi
+
+RUNTIME=$(mktemp -d "${TMPDIR:-/tmp}/pipewire-xrun.XXXXXX")
+PIDS=()
+
+cleanup() {
+	for pid in "${PIDS[@]}"; do
+		kill "$pid" 2>/dev/null || true
+	done
+	wait 2>/dev/null || true
+	if [[ $KEEP -eq 1 ]]; then
+		echo "runtime directory kept: $RUNTIME" >&2
+	else
+		rm -rf "$RUNTIME"
+	fi
+}
+trap cleanup EXIT
+trap 'exit 130' INT TERM
+
+mkdir -p "$RUNTIME/config" "$RUNTIME/state" "$RUNTIME/data"
+export PIPEWIRE_RUNTIME_DIR=$RUNTIME
+export XDG_RUNTIME_DIR=$RUNTIME
+export XDG_CONFIG_HOME=$RUNTIME/config
+export XDG_STATE_HOME=$RUNTIME/state
+export XDG_DATA_HOME=$RUNTIME/data
+export PIPEWIRE_REMOTE=pipewire-0
+unset PIPEWIRE_CONFIG_DIR PIPEWIRE_CONFIG_NAME DBUS_SESSION_BUS_ADDRESS
+
+pipewire -c "$HERE/pipewire-xrun.conf" >"$RUNTIME/pipewire.log" 2>&1 &
+PIDS+=($!)
+
+# the socket appears once the daemon is ready for clients
+for _ in $(seq 50); do
+	[[ -S "$RUNTIME/pipewire-0" ]] && break
+	if ! kill -0 "${PIDS[0]}" 2>/dev/null; then
+		echo "error: pipewire exited, see below" >&2
+		cat "$RUNTIME/pipewire.log" >&2
+		exit 2
+	fi
+	sleep 0.1
+done
+if [[ ! -S "$RUNTIME/pipewire-0" ]]; then
+	echo "error: pipewire did not create its socket" >&2
+	exit 2
+fi
+
+if [[ $SESSION_MANAGER -eq 1 ]]; then
+	if ! command -v wireplumber >/dev/null; then
+		echo "error: -w needs wireplumber" >&2
+		exit 2
+	fi
+	wireplumber >"$RUNTIME/wireplumber.log" 2>&1 &
+	PIDS+=($!)
+	# give it time to pick up the null sink as the default
+	sleep 1
+fi
+
+status=0
+"$XRUN" "$@" || status=$?
+exit $status
@@ -1,21 +1,88 @@
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <math.h>
+#include <sched.h>
 #include <signal.h>
+#include <stddef.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <pipewire/extensions/profiler.h>
 #include <pipewire/pipewire.h>
+#include <spa/node/io.h>
 #include <spa/param/audio/format-utils.h>
 #include <spa/param/audio/raw-types.h>
+#include <spa/param/buffers.h>
+#include <spa/param/profiler.h>
+#include <spa/pod/builder.h>
+#include <spa/pod/iter.h>
+#include <spa/pod/parser.h>
+
+#include "results.h"
+#include "sched-trace.h"
+#include "trace.h"
 
 #define MAX_HISTOGRAM_BUCKETS 128
+#define MAX_STREAMS 256
+#define MAX_SWEEP 32
+#define MAX_FORMATS 32
+/* late callbacks a stream can queue for the -K collector between two
+ * drains of the main loop (SCHED_DRAIN_NS) */
+#define LATE_QUEUE 64
+#define SCHED_DRAIN_NS 100000000ULL
+
+/* -C: a change counts as a regression at this z score (one-sided p
+ * about 0.0013), for percentiles only if it is also above the histogram
+ * resolution; the maximum uses the equivalent tail probability */
+#define COMPARE_Z 3.0
+#define COMPARE_ALPHA 0.0013
+#define COMPARE_MIN_CHANGE 0.05
+
+/* graph nodes tracked from the profiler, and the follower status of a
+ * node that completed its cycle (PW_NODE_ACTIVATION_FINISHED) */
+#define MAX_GRAPH_NODES 64
+#define PROFILER_STATUS_FINISHED 3
+
+/* test tone played by output streams and expected on capture */
+#define TONE_FREQ 440.0
+/* envelope below which captured audio counts as silence (-60 dBFS) */
+#define TONE_FLOOR 1e-3f
+/* residual, relative to the envelope, that marks a discontinuity */
+#define TONE_TOLERANCE 0.02f
+/* clean predictions needed before the input counts as the tone */
+#define TONE_LOCK 64
+
+/*
+ * Log-linear (HDR-style) interval histogram: values below 2^HDR_SUB_BITS ns
+ * are counted exactly, above that every power of two is split into
+ * 2^HDR_SUB_BITS linear buckets. The relative error is below
+ * 2^-HDR_SUB_BITS (0.8%), memory is fixed and independent of the run
+ * duration, and the whole uint64 range is covered.
+ */
+#define HDR_SUB_BITS 7
+#define HDR_SUB_COUNT (1u << HDR_SUB_BITS)
+#define HDR_BUCKETS ((64 - HDR_SUB_BITS + 1) * HDR_SUB_COUNT)
+
+/* the same layout, coarser (3%) and capped at 2^LIVE_MAX_BITS ns, for the
+ * live window that is copied to the main loop every second */
+#define LIVE_SUB_BITS 5
+#define LIVE_MAX_BITS 36
+#define LIVE_BUCKETS ((LIVE_MAX_BITS - LIVE_SUB_BITS + 1) << LIVE_SUB_BITS)
+
+enum bench_mode {
+	MODE_PLAYBACK,
+	MODE_CAPTURE,
+	MODE_DUPLEX,
+};
 
 struct bench_config {
 	uint32_t rate;
@@ -26,59 +93,423 @@ struct bench_config {
 	double threshold_1;
 	double threshold_2;
 	double threshold_3;
+	/* synthetic per-cycle CPU load in percent of the period, and the
+	 * step added every second while ramping (0 = fixed load) */
+	double load_pct;
+	double ramp_step_pct;
+	/* -B: time the synth kernels instead of connecting */
+	bool synth_bench;
+	/* -D: unlinked streams in one group, driven by the first stream from
+	 * its own timer instead of a device */
+	bool driver;
+	/* -k/-z/-a/-t: SPA_PARAM_Buffers to request once the format is
+	 * known, 0 leaves the choice to PipeWire; data_types is a mask of
+	 * 1 << SPA_DATA_* */
+	uint32_t n_buffers;
+	uint32_t buffer_size;
+	uint32_t buffer_align;
+	uint32_t data_types;
+	/* -M: connect without PW_STREAM_FLAG_MAP_BUFFERS */
+	bool no_map;
+	/* -L: live window rows as CSV ("-" for stdout) */
+	const char *live_path;
+	/* -T: per-cycle trace file, see trace.h */
+	const char *trace_path;
+	/* -K: scheduler events around every late callback, see
+	 * sched-trace.h */
+	const char *sched_path;
+	/* -o json: results.h document on stdout instead of the report */
+	bool json;
+	/* -C: -o json output of an earlier run to compare against */
+	const char *compare_path;
+	/* -s/-S: quanta (ascending) and rates to sweep, one run each, or a
+	 * binary search (-b) for the smallest stable quantum per rate whose
+	 * p99.9 interval stays below sweep_p999 periods */
+	uint32_t sweep_quanta[MAX_SWEEP];
+	uint32_t n_sweep_quanta;
+	uint32_t sweep_rates[MAX_SWEEP];
+	uint32_t n_sweep_rates;
+	bool sweep_search;
+	double sweep_p999;
+	/* -F: formats to run one after another, also the -B kernel list */
+	uint32_t matrix_formats[MAX_FORMATS];
+	uint32_t n_matrix_formats;
+	enum bench_mode mode;
+	/* concurrent playback and capture streams, resolved from -m, -n
+	 * and -I by parse_args() */
+	uint32_t n_output;
+	uint32_t n_input;
 };
 
+/*
+ * written only by on_process() on the data thread: plain single-writer
+ * counters without locked instructions. While the stream runs the main
+ * loop only sees struct stats_snapshot; the full set is read once the
+ * stream is disconnected.
+ */
 struct rt_stats {
-	atomic_uint_least64_t callback_count;
-	atomic_uint_least64_t last_callback_ns;
+	uint64_t callback_count;
+	uint64_t last_callback_ns;
 
-	atomic_uint_least64_t sum_ns;
-	atomic_uint_least64_t sum_sq_ns;
-	atomic_uint_least64_t max_ns;
-	uint64_t p95_ns;
-	uint64_t p99_ns;
+	uint64_t sum_ns;
+	/* double: squared intervals overflow 64 bits within minutes */
+	double sum_sq_ns;
+	uint64_t max_ns;
 
-	atomic_uint_least64_t over_threshold_1;
-	atomic_uint_least64_t over_threshold_2;
-	atomic_uint_least64_t over_threshold_3;
+	uint64_t over_threshold_1;
+	uint64_t over_threshold_2;
+	uint64_t over_threshold_3;
 
-	atomic_uint_least64_t dequeue_fail;
-	atomic_uint_least64_t null_buffer;
-	atomic_uint_least64_t state_errors;
-	atomic_uint_least64_t zero_interval;
+	uint64_t dequeue_fail;
+	uint64_t null_buffer;
+	/* -M: buffers without a CPU mapping, queued untouched */
+	uint64_t unmapped;
+	uint64_t zero_interval;
+
+	/* time spent inside on_process(), synthetic load included */
+	uint64_t busy_sum_ns;
+	uint64_t busy_max_ns;
+	uint64_t busy_count;
+	uint64_t busy_hdr[HDR_BUCKETS];
+
+	/* cost of the recording itself (stats + snapshot publish) */
+	uint64_t record_sum_ns;
+	uint64_t record_max_ns;
 
-	atomic_uint_least64_t histogram[MAX_HISTOGRAM_BUCKETS];
+	/* graph timing from pw_stream_get_time_n(), see stats_record_time() */
+	uint64_t time_count;
+	uint64_t time_unavailable;
+	uint64_t last_ticks;
+	uint64_t last_graph_ns;
+	/* graph quantum (clock.duration) of the last cycle, in ticks */
+	uint64_t last_duration;
+	/* ticks advancing by more than one quantum: skipped graph cycles */
+	uint64_t tick_gaps;
+	uint64_t skipped_cycles;
+	/* cycles the gap check ran on, none without a position io */
+	uint64_t gap_checks;
+	/* late callbacks (> threshold_3) that coincide with a tick gap */
+	uint64_t late_graph;
+	/* elapsed graph clock vs elapsed CLOCK_MONOTONIC over the same
+	 * cycles, for the drift */
+	double graph_span_ns;
+	double mono_span_ns;
+	/* graph cycle start (pw_time.now) to on_process() entry */
+	uint64_t wake_sum_ns;
+	uint64_t wake_max_ns;
+	uint64_t wake_hdr[HDR_BUCKETS];
+	/* pw_time.delay converted to ns */
+	uint64_t delay_max_ns;
+	uint64_t delay_hdr[HDR_BUCKETS];
 
-	uint64_t *raw_intervals;
-	uint64_t raw_capacity;
-	atomic_uint_least64_t raw_count;
+	/* capture: continuity of the test tone, see tone_check_run() */
+	uint64_t capture_frames;
+	uint64_t tone_frames;
+	uint64_t silent_buffers;
+	uint64_t discontinuities;
+
+	/* duplex: capture entry minus playback entry in the same graph
+	 * cycle, recorded by whichever stream of the pair runs second */
+	uint64_t align_count;
+	int64_t align_sum_ns;
+	int64_t align_min_ns;
+	int64_t align_max_ns;
+	uint64_t align_hdr[HDR_BUCKETS];
+
+	uint64_t histogram[MAX_HISTOGRAM_BUCKETS];
+	uint64_t hdr[HDR_BUCKETS];
+
+	/* live window, closed by window_publish() */
+	unsigned int win_epoch;
+	uint64_t win_max_ns;
+	uint64_t live_hist[LIVE_BUCKETS];
 
 	uint64_t test_start_ns;
 	uint64_t test_end_ns;
+};
 
-	atomic_uint_least32_t actual_rate;
-	atomic_uint_least32_t actual_quantum;
-	atomic_uint_least32_t actual_format;
+/*
+ * seqlock: the counters the main loop needs while the stream runs. There
+ * is a single writer, so the sequence is advanced with plain stores
+ * (odd while the fields change) and the reader retries until it sees the
+ * same even value before and after copying.
+ */
+struct stats_snapshot {
+	atomic_uint seq;
+	atomic_uint_least64_t callback_count;
+	atomic_uint_least64_t over_threshold_3;
+	atomic_uint_least64_t max_ns;
+	atomic_uint_least64_t busy_max_ns;
+	atomic_uint_least64_t dequeue_fail;
+	atomic_uint_least64_t null_buffer;
+};
+
+/*
+ * live window: once per tick the main loop bumps epoch, and the next
+ * callback publishes its cumulative counters, live histogram and the max
+ * since the previous window under their own sequence. The tick then
+ * diffs two publications, so the RT side copies the histogram once per
+ * window and the main loop never writes RT-owned state.
+ */
+struct window_snapshot {
+	/* written by the main loop only */
+	atomic_uint epoch;
+
+	atomic_uint seq;
+	atomic_uint closed_epoch;
+	atomic_uint_least64_t callback_count;
+	atomic_uint_least64_t over_threshold_3;
+	atomic_uint_least64_t errors;
+	atomic_uint_least64_t max_ns;
+	atomic_uint_least64_t hist[LIVE_BUCKETS];
+};
+
+struct window_view {
+	unsigned int closed_epoch;
+	uint64_t callback_count;
+	uint64_t over_threshold_3;
+	uint64_t errors;
+	uint64_t max_ns;
+	uint64_t hist[LIVE_BUCKETS];
 };
 
+struct stats_view {
+	uint64_t callback_count;
+	uint64_t over_threshold_3;
+	uint64_t max_ns;
+	uint64_t busy_max_ns;
+	uint64_t dequeue_fail;
+	uint64_t null_buffer;
+};
+
+/*
+ * Recursive-rotation oscillator: SYNTH_LANES phasors at consecutive
+ * sample phases are rotated by SYNTH_LANES steps at a time, so the inner
+ * loop is a complex multiply per lane that the compiler vectorises.
+ * Samples are rendered a block at a time and handed out across callbacks;
+ * every SYNTH_RESEED blocks the lanes are re-seeded from the double phase
+ * with sin()/cos(), which bounds the float rounding drift.
+ */
+#define SYNTH_LANES 16
+#define SYNTH_BLOCK 1024
+#define SYNTH_RESEED 64
+
 struct synth_state {
 	double phase;
 	double phase_increment;
 	double freq;
+
+	float re[SYNTH_LANES];
+	float im[SYNTH_LANES];
+	float rot_re;
+	float rot_im;
+	/* mono samples of the current block, consumed from block_pos */
+	float block[SYNTH_BLOCK];
+	uint32_t block_pos;
+	uint32_t block_count;
+};
+
+/*
+ * continuity check for captured audio: a pure tone satisfies
+ * x[n] = 2 cos(w) x[n-1] - x[n-2], so the prediction residual stays near
+ * zero until samples are dropped, repeated or zeroed. A phase jump below
+ * about TONE_TOLERANCE radians (or by whole periods) goes unnoticed.
+ */
+struct tone_check {
+	float coeff;
+	float x1;
+	float x2;
+	float envelope;
+	float decay;
+	/* clean samples since the tone (re)appeared, up to TONE_LOCK */
+	uint32_t primed;
+	/* samples left before the next discontinuity can be counted: one
+	 * glitch disturbs three residuals */
+	uint32_t holdoff;
+};
+
+struct bench_context;
+
+/* the buffer set a stream negotiated, from its add_buffer events; main
+ * loop only */
+struct buffer_layout {
+	/* buffers added and not yet removed, and the size of the last set */
+	uint32_t live;
+	uint32_t count;
+	/* renegotiations replace the whole set */
+	uint32_t sets;
+	uint32_t datas;
+	uint32_t type;
+	uint32_t maxsize;
+	bool mapped;
+	/* largest power of two dividing every data pointer of the set */
+	uint32_t align;
+};
+
+/*
+ * one pw_stream (a separate client, pw_stream_new_simple()) with its own
+ * RT-owned stats; the stream events get it as their data pointer
+ */
+struct bench_stream {
+	struct bench_context *ctx;
+	uint32_t index;
+	enum pw_direction direction;
+	struct pw_stream *stream;
+
+	struct rt_stats stats;
+	struct stats_snapshot snapshot;
+	struct window_snapshot window;
+	struct synth_state synth;
+	struct tone_check tone;
+	/* set by on_io_changed(); the graph quantum the data thread
+	 * compares tick deltas against */
+	struct spa_io_position *position;
+
+	/* this stream's region of the trace mapping, NULL without -T */
+	struct trace_record *trace;
+	struct trace_stream *trace_info;
+	uint64_t trace_capacity;
+
+	/* -K: late callbacks for the main loop, a single-producer ring
+	 * indexed by the free-running head (data thread) and tail (main
+	 * loop); late_dropped and rt_tid belong to the data thread */
+	struct sched_late late_queue[LATE_QUEUE];
+	atomic_uint late_head;
+	atomic_uint late_tail;
+	uint64_t late_dropped;
+	int32_t rt_tid;
+
+	/* duplex: the stream of the other direction with the same index */
+	struct bench_stream *peer;
+	/* graph cycle (pw_time.now) and entry time of the last callback,
+	 * written like a seqlock: cycle_graph_ns is zero while it changes */
+	atomic_uint_least64_t cycle_graph_ns;
+	atomic_uint_least64_t cycle_entry_ns;
+	/* last cycle whose alignment was recorded; the playback stream's
+	 * copy is shared by the pair */
+	atomic_uint_least64_t aligned_graph_ns;
+
+	/* main loop only */
+	uint64_t state_errors;
+	uint32_t node_id;
+	struct buffer_layout layout;
+	/* negotiated format, set by on_param_changed(); on_process() reads
+	 * actual_format */
+	atomic_uint_least32_t actual_rate;
+	atomic_uint_least32_t actual_format;
+	/* the graph quantum of the last cycle, stored by the data thread */
+	atomic_uint_least32_t actual_quantum;
+};
+
+struct graph_node {
+	uint32_t id;
+	char name[64];
+	/* cumulative xrun counter from the follower block, -1 until the
+	 * server reports one */
+	int32_t xrun_count;
+	/* graph xruns attributed to this node */
+	uint64_t late;
+};
+
+/*
+ * per-cycle driver and follower timing from module-profiler, for the
+ * driver cycles that run one of our nodes; main loop only
+ */
+struct graph_monitor {
+	struct pw_context *context;
+	struct pw_core *core;
+	struct pw_registry *registry;
+	struct spa_hook registry_listener;
+	struct pw_profiler *profiler;
+	struct spa_hook profiler_listener;
+
+	uint32_t driver_id;
+	char driver_name[64];
+	uint64_t cycles;
+	/* increments of the driver's xrun counter */
+	uint64_t xruns;
+	int32_t driver_xrun_count;
+
+	/* our follower blocks: signal to awake, awake to finish, and
+	 * cycles that ended before our node finished */
+	uint64_t own_count;
+	uint64_t own_wake_sum_ns;
+	uint64_t own_wake_max_ns;
+	uint64_t own_busy_max_ns;
+	uint64_t own_unfinished;
+
+	struct graph_node nodes[MAX_GRAPH_NODES];
+	uint32_t n_nodes;
+};
+
+/*
+ * -D: a timer on the data loop of the first stream fills the clock of
+ * the graph position and triggers one cycle per period, the way
+ * module-pipe-tunnel drives a graph; data loop only once armed
+ */
+struct driver_timer {
+	struct bench_stream *stream;
+	struct pw_loop *loop;
+	struct spa_source *source;
+	/* set by on_io_changed() before the stream starts */
+	struct spa_io_position *position;
+
+	uint32_t rate;
+	uint32_t duration;
+	uint64_t period_ns;
+	uint64_t next_ns;
+	uint64_t frames;
+
+	uint64_t ticks;
+	/* periods skipped because the timer woke more than a period late */
+	uint64_t missed;
+	/* ticks while the graph picked another driver */
+	uint64_t not_driving;
+	/* timer wakeup after the programmed time */
+	uint64_t wake_sum_ns;
+	uint64_t wake_max_ns;
+	uint64_t wake_hist[LIVE_BUCKETS];
 };
 
 struct bench_context {
 	struct bench_config config;
-	struct rt_stats stats;
 
 	struct pw_main_loop *loop;
-	struct pw_stream *stream;
+	struct graph_monitor monitor;
 
-	struct synth_state synth;
+	/* n_output playback streams first, then n_input capture streams */
+	struct bench_stream *streams;
+	uint32_t n_streams;
+	/* all streams merged, filled after the run */
+	struct rt_stats *total;
+	/* -D only */
+	struct driver_timer *driver;
 
 	atomic_bool should_stop;
 	uint64_t run_start_ns;
 	int remaining_width;
+
+	/* live window state, main loop only: the previous publication of
+	 * every stream and the optional -L output */
+	struct window_view *live_prev;
+	FILE *live_file;
+
+	struct trace_header *trace;
+	size_t trace_size;
+
+	/* -K only */
+	struct sched_trace *sched;
+
+	/* synthetic load read by on_process(); the ramp state is only
+	 * touched from the main loop */
+	atomic_uint_least64_t load_ns;
+	double ramp_load_pct;
+	/* xruns up to the start of the current step */
+	uint64_t ramp_xruns;
+	bool ramp_started;
+	bool ramp_done;
+	bool ramp_limit_found;
+	double ramp_limit_pct;
 };
 
 static uint64_t now_ns(void) {
@@ -87,29 +518,324 @@ static uint64_t now_ns(void) {
 	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
+static double period_ns(const struct bench_config *cfg) {
+	return 1e9 * (double) cfg->quantum / (double) cfg->rate;
+}
+
+static void load_set(struct bench_context *ctx, double pct) {
+	atomic_store(&ctx->load_ns,
+		     (uint64_t) (period_ns(&ctx->config) * pct / 100.0));
+}
+
+/* spin until the deadline, standing in for per-cycle DSP work */
+static void load_burn(uint64_t until_ns) {
+	while (now_ns() < until_ns)
+		;
+}
+
 static void synth_init(struct synth_state *s, uint32_t rate, double freq) {
 	s->phase = 0.0;
 	s->freq = freq;
 	s->phase_increment = 2.0 * M_PI * freq / (double) rate;
+	s->rot_re = (float) cos(s->phase_increment * SYNTH_LANES);
+	s->rot_im = (float) sin(s->phase_increment * SYNTH_LANES);
+	s->block_pos = SYNTH_BLOCK;
+	s->block_count = 0;
 }
 
-static void synth_fill_f32(struct synth_state *s, float *dst, uint32_t n_frames,
-			   uint32_t channels) {
-	for (uint32_t i = 0; i < n_frames; i++) {
-		float sample = (float) sin(s->phase);
-		s->phase += s->phase_increment;
-		if (s->phase >= 2.0 * M_PI)
-			s->phase -= 2.0 * M_PI;
+/* render the next SYNTH_BLOCK mono samples into s->block */
+static void synth_render(struct synth_state *s) {
+	float *restrict out = s->block;
+	const float rr = s->rot_re, ri = s->rot_im;
+	/* local copies stay in vector registers across the block */
+	float re[SYNTH_LANES], im[SYNTH_LANES];
+
+	if (s->block_count++ % SYNTH_RESEED == 0) {
+		for (uint32_t k = 0; k < SYNTH_LANES; k++) {
+			double phase = s->phase + k * s->phase_increment;
+			s->re[k] = (float) cos(phase);
+			s->im[k] = (float) sin(phase);
+		}
+	}
+	memcpy(re, s->re, sizeof(re));
+	memcpy(im, s->im, sizeof(im));
+
+	for (uint32_t i = 0; i < SYNTH_BLOCK; i += SYNTH_LANES) {
+		for (uint32_t k = 0; k < SYNTH_LANES; k++) {
+			float r = re[k], m = im[k];
+			out[i + k] = m;
+			re[k] = r * rr - m * ri;
+			im[k] = r * ri + m * rr;
+		}
+	}
+	memcpy(s->re, re, sizeof(re));
+	memcpy(s->im, im, sizeof(im));
+
+	s->phase =
+		fmod(s->phase + SYNTH_BLOCK * s->phase_increment, 2.0 * M_PI);
+	s->block_pos = 0;
+}
 
+/*
+ * interleave one mono block into n_frames frames of `channels` samples.
+ * Common channel counts get loops with a constant inner trip count (one
+ * broadcast vector store per frame); other counts use the generic loop.
+ */
+#define FILL_CHANNELS(dst, src, n_frames, convert, type, ch)                   \
+	for (uint32_t i = 0; i < (n_frames); i++) {                            \
+		type v = convert((src)[i]);                                    \
+		for (uint32_t c = 0; c < (ch); c++)                            \
+			(dst)[i * (ch) + c] = v;                               \
+	}
+
+#define DEFINE_FILL(name, type, convert)                                       \
+	static void name(type *restrict dst, const float *restrict src,        \
+			 uint32_t n_frames, uint32_t channels) {               \
+		switch (channels) {                                            \
+		case 1:                                                        \
+			FILL_CHANNELS(dst, src, n_frames, convert, type, 1)    \
+			break;                                                 \
+		case 2:                                                        \
+			FILL_CHANNELS(dst, src, n_frames, convert, type, 2)    \
+			break;                                                 \
+		case 4:                                                        \
+			FILL_CHANNELS(dst, src, n_frames, convert, type, 4)    \
+			break;                                                 \
+		case 6:                                                        \
+			FILL_CHANNELS(dst, src, n_frames, convert, type, 6)    \
+			break;                                                 \
+		case 8:                                                        \
+			FILL_CHANNELS(dst, src, n_frames, convert, type, 8)    \
+			break;                                                 \
+		default:                                                       \
+			FILL_CHANNELS(dst, src, n_frames, convert, type,       \
+				      channels)                                \
+			break;                                                 \
+		}                                                              \
+	}
+
+#define CONVERT_F32(x) (x)
+#define CONVERT_F64(x) ((double) (x))
+#define CONVERT_S8(x) ((int8_t) ((x) * 127.0f))
+#define CONVERT_S16(x) ((int16_t) ((x) * 32767.0f))
+#define CONVERT_S24(x) ((int32_t) ((x) * 8388607.0f))
+/* 2147483520 is the largest float below 2^31 */
+#define CONVERT_S32(x) ((int32_t) ((x) * 2147483520.0f))
+/* unsigned samples are the signed ones with the sign bit flipped */
+#define CONVERT_U8(x) ((uint8_t) (CONVERT_S8(x) ^ 0x80))
+#define CONVERT_U16(x) ((uint16_t) (CONVERT_S16(x) ^ 0x8000))
+#define CONVERT_U24_32(x) ((uint32_t) ((CONVERT_S24(x) & 0xffffff) ^ 0x800000))
+#define CONVERT_U32(x) ((uint32_t) CONVERT_S32(x) ^ 0x80000000u)
+
+DEFINE_FILL(fill_f32, float, CONVERT_F32)
+DEFINE_FILL(fill_f64, double, CONVERT_F64)
+DEFINE_FILL(fill_s8, int8_t, CONVERT_S8)
+DEFINE_FILL(fill_u8, uint8_t, CONVERT_U8)
+DEFINE_FILL(fill_s16, int16_t, CONVERT_S16)
+DEFINE_FILL(fill_u16, uint16_t, CONVERT_U16)
+DEFINE_FILL(fill_s24_32, int32_t, CONVERT_S24)
+DEFINE_FILL(fill_u24_32, uint32_t, CONVERT_U24_32)
+DEFINE_FILL(fill_s32, int32_t, CONVERT_S32)
+DEFINE_FILL(fill_u32, uint32_t, CONVERT_U32)
+
+/* packed 3-byte samples in host byte order */
+static void fill_s24(uint8_t *restrict dst, const float *restrict src,
+		     uint32_t n_frames, uint32_t channels, uint32_t flip) {
+	for (uint32_t i = 0; i < n_frames; i++) {
+		uint32_t v = (uint32_t) CONVERT_S24(src[i]) ^ flip;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		uint8_t b[3] = {(uint8_t) (v >> 16), (uint8_t) (v >> 8),
+				(uint8_t) v};
+#else
+		uint8_t b[3] = {(uint8_t) v, (uint8_t) (v >> 8),
+				(uint8_t) (v >> 16)};
+#endif
 		for (uint32_t c = 0; c < channels; c++)
-			dst[i * channels + c] = sample;
+			memcpy(dst + ((size_t) i * channels + c) * 3, b, 3);
 	}
 }
 
-static void synth_fill_s16(struct synth_state *s, int16_t *dst,
-			   uint32_t n_frames, uint32_t channels) {
+/* the sample types the synth writes, in host byte order */
+enum synth_kind {
+	SYNTH_F32,
+	SYNTH_F64,
+	SYNTH_S8,
+	SYNTH_U8,
+	SYNTH_S16,
+	SYNTH_U16,
+	SYNTH_S24_32,
+	SYNTH_U24_32,
+	SYNTH_S32,
+	SYNTH_U32,
+	SYNTH_S24,
+	SYNTH_U24,
+};
+
+struct format_desc {
+	uint32_t format;
+	enum synth_kind kind;
+	/* bytes per sample */
+	uint32_t size;
+	/* the other byte order than the host's */
+	bool swap;
+	/* one data plane per channel */
+	bool planar;
+};
+
+static const struct format_desc format_descs[] = {
+	{SPA_AUDIO_FORMAT_F32, SYNTH_F32, 4, false, false},
+	{SPA_AUDIO_FORMAT_F32_OE, SYNTH_F32, 4, true, false},
+	{SPA_AUDIO_FORMAT_F64, SYNTH_F64, 8, false, false},
+	{SPA_AUDIO_FORMAT_F64_OE, SYNTH_F64, 8, true, false},
+	{SPA_AUDIO_FORMAT_S8, SYNTH_S8, 1, false, false},
+	{SPA_AUDIO_FORMAT_U8, SYNTH_U8, 1, false, false},
+	{SPA_AUDIO_FORMAT_S16, SYNTH_S16, 2, false, false},
+	{SPA_AUDIO_FORMAT_S16_OE, SYNTH_S16, 2, true, false},
+	{SPA_AUDIO_FORMAT_U16, SYNTH_U16, 2, false, false},
+	{SPA_AUDIO_FORMAT_U16_OE, SYNTH_U16, 2, true, false},
+	{SPA_AUDIO_FORMAT_S24_32, SYNTH_S24_32, 4, false, false},
+	{SPA_AUDIO_FORMAT_S24_32_OE, SYNTH_S24_32, 4, true, false},
+	{SPA_AUDIO_FORMAT_U24_32, SYNTH_U24_32, 4, false, false},
+	{SPA_AUDIO_FORMAT_U24_32_OE, SYNTH_U24_32, 4, true, false},
+	{SPA_AUDIO_FORMAT_S32, SYNTH_S32, 4, false, false},
+	{SPA_AUDIO_FORMAT_S32_OE, SYNTH_S32, 4, true, false},
+	{SPA_AUDIO_FORMAT_U32, SYNTH_U32, 4, false, false},
+	{SPA_AUDIO_FORMAT_U32_OE, SYNTH_U32, 4, true, false},
+	{SPA_AUDIO_FORMAT_S24, SYNTH_S24, 3, false, false},
+	{SPA_AUDIO_FORMAT_S24_OE, SYNTH_S24, 3, true, false},
+	{SPA_AUDIO_FORMAT_U24, SYNTH_U24, 3, false, false},
+	{SPA_AUDIO_FORMAT_U24_OE, SYNTH_U24, 3, true, false},
+	{SPA_AUDIO_FORMAT_F32P, SYNTH_F32, 4, false, true},
+	{SPA_AUDIO_FORMAT_F64P, SYNTH_F64, 8, false, true},
+	{SPA_AUDIO_FORMAT_S8P, SYNTH_S8, 1, false, true},
+	{SPA_AUDIO_FORMAT_U8P, SYNTH_U8, 1, false, true},
+	{SPA_AUDIO_FORMAT_S16P, SYNTH_S16, 2, false, true},
+	{SPA_AUDIO_FORMAT_S24_32P, SYNTH_S24_32, 4, false, true},
+	{SPA_AUDIO_FORMAT_S32P, SYNTH_S32, 4, false, true},
+	{SPA_AUDIO_FORMAT_S24P, SYNTH_S24, 3, false, true},
+};
+
+#define N_FORMATS (sizeof(format_descs) / sizeof(format_descs[0]))
+
+static const struct format_desc *format_desc_for(uint32_t format) {
+	for (size_t i = 0; i < N_FORMATS; i++)
+		if (format_descs[i].format == format)
+			return &format_descs[i];
+	return NULL;
+}
+
+static uint32_t format_sample_size(uint32_t format) {
+	const struct format_desc *fd = format_desc_for(format);
+	return fd ? fd->size : 0;
+}
+
+/* bytes per frame in one data plane */
+static uint32_t format_stride(uint32_t format, uint32_t channels) {
+	const struct format_desc *fd = format_desc_for(format);
+
+	if (fd == NULL)
+		return 0;
+	return fd->planar ? fd->size : fd->size * channels;
+}
+
+static void fill_kind(enum synth_kind kind, void *dst, size_t offset,
+		      const float *src, uint32_t n_frames,
+		      uint32_t channels) {
+	switch (kind) {
+	case SYNTH_F32:
+		fill_f32((float *) dst + offset, src, n_frames, channels);
+		break;
+	case SYNTH_F64:
+		fill_f64((double *) dst + offset, src, n_frames, channels);
+		break;
+	case SYNTH_S8:
+		fill_s8((int8_t *) dst + offset, src, n_frames, channels);
+		break;
+	case SYNTH_U8:
+		fill_u8((uint8_t *) dst + offset, src, n_frames, channels);
+		break;
+	case SYNTH_S16:
+		fill_s16((int16_t *) dst + offset, src, n_frames, channels);
+		break;
+	case SYNTH_U16:
+		fill_u16((uint16_t *) dst + offset, src, n_frames, channels);
+		break;
+	case SYNTH_S24_32:
+		fill_s24_32((int32_t *) dst + offset, src, n_frames, channels);
+		break;
+	case SYNTH_U24_32:
+		fill_u24_32((uint32_t *) dst + offset, src, n_frames,
+			    channels);
+		break;
+	case SYNTH_S32:
+		fill_s32((int32_t *) dst + offset, src, n_frames, channels);
+		break;
+	case SYNTH_U32:
+		fill_u32((uint32_t *) dst + offset, src, n_frames, channels);
+		break;
+	case SYNTH_S24:
+		fill_s24((uint8_t *) dst + offset * 3, src, n_frames, channels,
+			 0);
+		break;
+	case SYNTH_U24:
+		fill_s24((uint8_t *) dst + offset * 3, src, n_frames, channels,
+			 0x800000);
+		break;
+	}
+}
+
+/* the other-endian formats take a second pass, as a converter would */
+static void swap_samples(void *data, uint32_t size, size_t count) {
+	uint8_t *p = data;
+
+	for (size_t i = 0; i < count; i++, p += size) {
+		for (uint32_t lo = 0, hi = size - 1; lo < hi; lo++, hi--) {
+			uint8_t t = p[lo];
+			p[lo] = p[hi];
+			p[hi] = t;
+		}
+	}
+}
+
+/*
+ * n_frames frames into every plane: `channels` interleaved samples per
+ * frame, or one per plane for planar formats with a plane per channel
+ */
+static void synth_fill(struct synth_state *s, const struct format_desc *fd,
+		       void *const *planes, uint32_t n_planes,
+		       uint32_t n_frames, uint32_t channels) {
+	uint32_t done = 0;
+
+	while (done < n_frames) {
+		if (s->block_pos == SYNTH_BLOCK)
+			synth_render(s);
+
+		uint32_t n = n_frames - done;
+		if (n > SYNTH_BLOCK - s->block_pos)
+			n = SYNTH_BLOCK - s->block_pos;
+
+		const float *src = s->block + s->block_pos;
+		size_t offset = (size_t) done * channels;
+		for (uint32_t p = 0; p < n_planes; p++)
+			fill_kind(fd->kind, planes[p], offset, src, n,
+				  channels);
+		s->block_pos += n;
+		done += n;
+	}
+
+	if (fd->swap) {
+		for (uint32_t p = 0; p < n_planes; p++)
+			swap_samples(planes[p], fd->size,
+				     (size_t) n_frames * channels);
+	}
+}
+
+/* the previous per-frame sin() fill, kept as the micro-benchmark
+ * reference */
+static void synth_fill_libm_f32(struct synth_state *s, float *dst,
+				uint32_t n_frames, uint32_t channels) {
 	for (uint32_t i = 0; i < n_frames; i++) {
-		int16_t sample = (int16_t) (sin(s->phase) * 32767.0);
+		float sample = (float) sin(s->phase);
 		s->phase += s->phase_increment;
 		if (s->phase >= 2.0 * M_PI)
 			s->phase -= 2.0 * M_PI;
@@ -119,245 +845,1628 @@ static void synth_fill_s16(struct synth_state *s, int16_t *dst,
 	}
 }
 
-static uint32_t format_sample_size(uint32_t format) {
-	switch (format) {
-	case SPA_AUDIO_FORMAT_S16_LE:
-	case SPA_AUDIO_FORMAT_S16_BE:
-	case SPA_AUDIO_FORMAT_U16_LE:
-	case SPA_AUDIO_FORMAT_U16_BE:
-		return 2;
-	case SPA_AUDIO_FORMAT_F32_LE:
-	case SPA_AUDIO_FORMAT_F32_BE:
-	case SPA_AUDIO_FORMAT_S32_LE:
-	case SPA_AUDIO_FORMAT_S32_BE:
-	case SPA_AUDIO_FORMAT_U32_LE:
-	case SPA_AUDIO_FORMAT_U32_BE:
-	case SPA_AUDIO_FORMAT_S24_32_LE:
-	case SPA_AUDIO_FORMAT_S24_32_BE:
-	case SPA_AUDIO_FORMAT_U24_32_LE:
-	case SPA_AUDIO_FORMAT_U24_32_BE:
-		return 4;
-	case SPA_AUDIO_FORMAT_F64_LE:
-	case SPA_AUDIO_FORMAT_F64_BE:
-		return 8;
-	case SPA_AUDIO_FORMAT_S8:
-	case SPA_AUDIO_FORMAT_U8:
-		return 1;
-	default:
+static const struct {
+	const char *name;
+	uint32_t type;
+} data_types[] = {
+	{"memptr", SPA_DATA_MemPtr},
+	{"memfd", SPA_DATA_MemFd},
+	{"dmabuf", SPA_DATA_DmaBuf},
+};
+
+static const char *data_type_name(uint32_t type) {
+	for (size_t i = 0; i < sizeof(data_types) / sizeof(data_types[0]); i++)
+		if (data_types[i].type == type)
+			return data_types[i].name;
+	return type == SPA_DATA_MemId ? "memid" : "unknown";
+}
+
+static uint32_t loglin_index(uint64_t value, uint32_t sub_bits) {
+	uint32_t sub_count = 1u << sub_bits;
+
+	if (value < sub_count)
+		return (uint32_t) value;
+
+	uint32_t msb = 63 - (uint32_t) __builtin_clzll(value);
+	uint32_t shift = msb - sub_bits;
+	uint64_t mantissa = value >> shift;
+
+	return (shift + 1) * sub_count + (uint32_t) (mantissa - sub_count);
+}
+
+/* highest value that lands in bucket idx */
+static uint64_t loglin_highest_value(uint32_t idx, uint32_t sub_bits) {
+	uint32_t sub_count = 1u << sub_bits;
+
+	if (idx < sub_count)
+		return idx;
+
+	uint32_t shift = idx / sub_count - 1;
+	uint64_t mantissa = idx % sub_count + sub_count;
+
+	return ((mantissa + 1) << shift) - 1;
+}
+
+static uint64_t loglin_value_at_percentile(const uint64_t *hist,
+					   uint32_t n_buckets,
+					   uint32_t sub_bits, uint64_t count,
+					   double percentile) {
+	if (count == 0)
 		return 0;
+
+	uint64_t rank = (uint64_t) ceil(percentile / 100.0 * (double) count);
+	if (rank == 0)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < n_buckets; i++) {
+		seen += hist[i];
+		if (seen >= rank)
+			return loglin_highest_value(i, sub_bits);
 	}
+	return loglin_highest_value(n_buckets - 1, sub_bits);
 }
 
-static void stats_alloc(struct rt_stats *s, const struct bench_config *cfg) {
-	uint64_t max_callbacks =
-		(uint64_t) cfg->duration_sec * cfg->rate / cfg->quantum + 4096;
+static uint32_t hdr_index(uint64_t value) {
+	return loglin_index(value, HDR_SUB_BITS);
+}
 
-	s->raw_intervals = calloc(max_callbacks, sizeof(uint64_t));
-	s->raw_capacity = max_callbacks;
+static uint64_t hdr_value_at_percentile(const uint64_t *hdr, uint64_t count,
+					double percentile) {
+	return loglin_value_at_percentile(hdr, HDR_BUCKETS, HDR_SUB_BITS,
+					  count, percentile);
 }
 
-static void stats_free(struct rt_stats *s) {
-	free(s->raw_intervals);
-	s->raw_intervals = NULL;
-	s->raw_capacity = 0;
+static uint32_t live_index(uint64_t value) {
+	if (value >> LIVE_MAX_BITS)
+		return LIVE_BUCKETS - 1;
+	return loglin_index(value, LIVE_SUB_BITS);
 }
 
 static void stats_record_interval(struct rt_stats *s, uint64_t interval_ns,
 				  const struct bench_config *cfg) {
-	double expected_period_ns =
-		1e9 * (double) cfg->quantum / (double) cfg->rate;
+	double expected_period_ns = period_ns(cfg);
 
-	atomic_fetch_add(&s->callback_count, 1);
-	atomic_fetch_add(&s->sum_ns, interval_ns);
-	atomic_fetch_add(&s->sum_sq_ns, interval_ns * interval_ns);
+	s->callback_count++;
+	s->sum_ns += interval_ns;
+	s->sum_sq_ns += (double) interval_ns * (double) interval_ns;
 
 	if (interval_ns == 0)
-		atomic_fetch_add(&s->zero_interval, 1);
+		s->zero_interval++;
 
-	uint64_t old_max;
-	do {
-		old_max = atomic_load(&s->max_ns);
-	} while (interval_ns > old_max &&
-		 !atomic_compare_exchange_weak(&s->max_ns, &old_max,
-					       interval_ns));
+	if (interval_ns > s->max_ns)
+		s->max_ns = interval_ns;
 
 	if (interval_ns > (uint64_t) (expected_period_ns * cfg->threshold_3))
-		atomic_fetch_add(&s->over_threshold_3, 1);
+		s->over_threshold_3++;
 	else if (interval_ns >
 		 (uint64_t) (expected_period_ns * cfg->threshold_2))
-		atomic_fetch_add(&s->over_threshold_2, 1);
+		s->over_threshold_2++;
 	else if (interval_ns >
 		 (uint64_t) (expected_period_ns * cfg->threshold_1))
-		atomic_fetch_add(&s->over_threshold_1, 1);
+		s->over_threshold_1++;
 
 	uint64_t bucket = (uint64_t) (interval_ns * 16.0 / expected_period_ns);
 	if (bucket >= MAX_HISTOGRAM_BUCKETS)
 		bucket = MAX_HISTOGRAM_BUCKETS - 1;
-	atomic_fetch_add(&s->histogram[bucket], 1);
+	s->histogram[bucket]++;
+	s->hdr[hdr_index(interval_ns)]++;
 
-	uint64_t idx = atomic_fetch_add(&s->raw_count, 1);
-	if (idx < s->raw_capacity)
-		s->raw_intervals[idx] = interval_ns;
+	if (interval_ns > s->win_max_ns)
+		s->win_max_ns = interval_ns;
+	s->live_hist[live_index(interval_ns)]++;
 }
 
-static int cmp_u64(const void *a, const void *b) {
-	uint64_t x = *(const uint64_t *) a;
-	uint64_t y = *(const uint64_t *) b;
-	if (x < y)
-		return -1;
-	if (x > y)
-		return 1;
-	return 0;
+static void stats_record_busy(struct rt_stats *s, uint64_t busy_ns) {
+	s->busy_count++;
+	s->busy_sum_ns += busy_ns;
+	if (busy_ns > s->busy_max_ns)
+		s->busy_max_ns = busy_ns;
+	s->busy_hdr[hdr_index(busy_ns)]++;
 }
 
-static void stats_compute_percentiles(struct rt_stats *s) {
-	uint64_t count = atomic_load(&s->raw_count);
-	if (count > s->raw_capacity)
-		count = s->raw_capacity;
-
-	if (count == 0) {
-		s->p95_ns = 0;
-		s->p99_ns = 0;
+/*
+ * pw_time.now is the CLOCK_MONOTONIC start of the graph cycle and ticks
+ * count the graph clock in rate units, so a late callback with ticks
+ * advancing by a single quantum was late in this client while the graph
+ * kept time; a tick gap means the driver itself skipped cycles. The
+ * quantum is the one the graph ran the previous cycle with (duration,
+ * 0 without a position io), not the requested one: the server clamps
+ * and forces it.
+ */
+static void stats_record_time(struct rt_stats *s, const struct pw_time *t,
+			      uint64_t now, bool late, uint64_t duration) {
+	if (t->rate.num == 0 || t->rate.denom == 0 || t->now <= 0) {
+		s->time_unavailable++;
 		return;
 	}
 
-	qsort(s->raw_intervals, count, sizeof(uint64_t), cmp_u64);
+	double tick_ns = 1e9 * t->rate.num / t->rate.denom;
+	uint64_t graph_ns = (uint64_t) t->now;
+	s->time_count++;
 
-	uint64_t p95_idx = (count - 1) * 95 / 100;
-	uint64_t p99_idx = (count - 1) * 99 / 100;
-	s->p95_ns = s->raw_intervals[p95_idx];
-	s->p99_ns = s->raw_intervals[p99_idx];
+	uint64_t wake_ns = now > graph_ns ? now - graph_ns : 0;
+	s->wake_sum_ns += wake_ns;
+	if (wake_ns > s->wake_max_ns)
+		s->wake_max_ns = wake_ns;
+	s->wake_hdr[hdr_index(wake_ns)]++;
+
+	uint64_t delay_ns = t->delay > 0 ? (uint64_t) (t->delay * tick_ns) : 0;
+	if (delay_ns > s->delay_max_ns)
+		s->delay_max_ns = delay_ns;
+	s->delay_hdr[hdr_index(delay_ns)]++;
+
+	/* a reset (driver or rate change) just restarts the span */
+	if (s->last_graph_ns != 0 && t->ticks > s->last_ticks &&
+	    graph_ns > s->last_graph_ns) {
+		uint64_t ticks = t->ticks - s->last_ticks;
+		uint64_t quantum = s->last_duration;
+
+		if (quantum > 0)
+			s->gap_checks++;
+		if (quantum > 0 && ticks > quantum + quantum / 2) {
+			s->tick_gaps++;
+			s->skipped_cycles +=
+				(ticks + quantum / 2) / quantum - 1;
+			if (late)
+				s->late_graph++;
+		}
+		s->graph_span_ns += ticks * tick_ns;
+		s->mono_span_ns += (double) (graph_ns - s->last_graph_ns);
+	}
+	s->last_ticks = t->ticks;
+	s->last_graph_ns = graph_ns;
+	s->last_duration = duration;
 }
 
-static void report_results(const struct bench_context *ctx) {
-	const struct bench_config *cfg = &ctx->config;
-	const struct rt_stats *s = &ctx->stats;
+static void snapshot_publish(struct stats_snapshot *snap,
+			     const struct rt_stats *s) {
+	unsigned int seq =
+		atomic_load_explicit(&snap->seq, memory_order_relaxed);
 
-	uint64_t callback_count = atomic_load(&s->callback_count);
-	double expected_period_us =
-		1e6 * (double) cfg->quantum / (double) cfg->rate;
+	atomic_store_explicit(&snap->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
 
-	uint64_t sum_ns = atomic_load(&s->sum_ns);
-	uint64_t max_ns = atomic_load(&s->max_ns);
-	uint64_t p95_ns = s->p95_ns;
-	uint64_t p99_ns = s->p99_ns;
+	atomic_store_explicit(&snap->callback_count, s->callback_count,
+			      memory_order_relaxed);
+	atomic_store_explicit(&snap->over_threshold_3, s->over_threshold_3,
+			      memory_order_relaxed);
+	atomic_store_explicit(&snap->max_ns, s->max_ns, memory_order_relaxed);
+	atomic_store_explicit(&snap->busy_max_ns, s->busy_max_ns,
+			      memory_order_relaxed);
+	atomic_store_explicit(&snap->dequeue_fail, s->dequeue_fail,
+			      memory_order_relaxed);
+	atomic_store_explicit(&snap->null_buffer, s->null_buffer,
+			      memory_order_relaxed);
 
-	uint64_t over_1 = atomic_load(&s->over_threshold_1);
-	uint64_t over_2 = atomic_load(&s->over_threshold_2);
-	uint64_t over_3 = atomic_load(&s->over_threshold_3);
+	atomic_store_explicit(&snap->seq, seq + 2, memory_order_release);
+}
 
-	uint64_t dequeue_fail = atomic_load(&s->dequeue_fail);
-	uint64_t null_buffer = atomic_load(&s->null_buffer);
-	uint64_t state_errors = atomic_load(&s->state_errors);
+static void snapshot_read(struct stats_snapshot *snap, struct stats_view *v) {
+	for (;;) {
+		unsigned int seq =
+			atomic_load_explicit(&snap->seq, memory_order_acquire);
+		if (seq & 1)
+			continue;
 
-	uint32_t actual_rate = atomic_load(&s->actual_rate);
-	uint32_t actual_quantum = atomic_load(&s->actual_quantum);
+		v->callback_count = atomic_load_explicit(
+			&snap->callback_count, memory_order_relaxed);
+		v->over_threshold_3 = atomic_load_explicit(
+			&snap->over_threshold_3, memory_order_relaxed);
+		v->max_ns = atomic_load_explicit(&snap->max_ns,
+						 memory_order_relaxed);
+		v->busy_max_ns = atomic_load_explicit(&snap->busy_max_ns,
+						      memory_order_relaxed);
+		v->dequeue_fail = atomic_load_explicit(&snap->dequeue_fail,
+						       memory_order_relaxed);
+		v->null_buffer = atomic_load_explicit(&snap->null_buffer,
+						      memory_order_relaxed);
 
-	if (actual_rate == 0)
-		actual_rate = cfg->rate;
-	if (actual_quantum == 0)
-		actual_quantum = cfg->quantum;
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&snap->seq, memory_order_relaxed) ==
+		    seq)
+			return;
+	}
+}
 
-	double avg_us = callback_count > 0
-				? (double) sum_ns / callback_count / 1000.0
-				: 0.0;
+static void window_publish(struct window_snapshot *w, struct rt_stats *s,
+			   unsigned int epoch) {
+	unsigned int seq = atomic_load_explicit(&w->seq, memory_order_relaxed);
 
-	double pct_1 = callback_count > 0 ? 100.0 * (double) over_1 /
-						    (double) callback_count
-					  : 0.0;
-	double pct_2 = callback_count > 0 ? 100.0 * (double) over_2 /
-						    (double) callback_count
-					  : 0.0;
-	double pct_3 = callback_count > 0 ? 100.0 * (double) over_3 /
-						    (double) callback_count
-					  : 0.0;
+	atomic_store_explicit(&w->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
 
-	printf("PipeWire Playback Benchmark Summary\n");
-	printf("====================================\n");
-	printf("Duration:           %.3f s\n",
-	       (double) (s->test_end_ns - s->test_start_ns) / 1e9);
-	uint32_t actual_format = atomic_load(&s->actual_format);
-	const char *actual_format_name =
-		actual_format != 0
-			? spa_type_audio_format_to_short_name(actual_format)
-			: "UNKNOWN";
+	atomic_store_explicit(&w->closed_epoch, epoch, memory_order_relaxed);
+	atomic_store_explicit(&w->callback_count, s->callback_count,
+			      memory_order_relaxed);
+	atomic_store_explicit(&w->over_threshold_3, s->over_threshold_3,
+			      memory_order_relaxed);
+	atomic_store_explicit(&w->errors, s->dequeue_fail + s->null_buffer,
+			      memory_order_relaxed);
+	atomic_store_explicit(&w->max_ns, s->win_max_ns, memory_order_relaxed);
+	for (uint32_t i = 0; i < LIVE_BUCKETS; i++)
+		atomic_store_explicit(&w->hist[i], s->live_hist[i],
+				      memory_order_relaxed);
 
-	printf("Requested rate:     %u Hz\n", cfg->rate);
-	printf("Requested quantum:  %u frames\n", cfg->quantum);
-	printf("Requested format:   %s\n",
-	       spa_type_audio_format_to_short_name(cfg->format));
-	printf("Actual rate:        %u Hz\n", actual_rate);
-	printf("Actual quantum:     %u frames\n", actual_quantum);
-	printf("Actual format:      %s\n", actual_format_name);
-	printf("Theoretical period: %.2f us\n", expected_period_us);
-	printf("\n");
-	printf("Callback statistics:\n");
-	printf("  Total callbacks:  %lu\n", (unsigned long) callback_count);
-	printf("  Avg interval:     %.2f us\n", avg_us);
-	printf("  p95 interval:     %.2f us\n", (double) p95_ns / 1000.0);
-	printf("  p99 interval:     %.2f us\n", (double) p99_ns / 1000.0);
-	printf("  Max interval:     %.2f us\n", (double) max_ns / 1000.0);
-	printf("\n");
-	printf("Threshold violations:\n");
-	printf("  >%.1fx period:    %lu  (%.2f%%)\n", cfg->threshold_1,
-	       (unsigned long) over_1, pct_1);
-	printf("  >%.1fx period:    %lu  (%.2f%%)\n", cfg->threshold_2,
-	       (unsigned long) over_2, pct_2);
-	printf("  >%.1fx period:    %lu  (%.2f%%)\n", cfg->threshold_3,
-	       (unsigned long) over_3, pct_3);
-	printf("\n");
-	printf("Errors:\n");
-	printf("  dequeue failures: %lu\n", (unsigned long) dequeue_fail);
-	printf("  null buffers:     %lu\n", (unsigned long) null_buffer);
-	printf("  state errors:     %lu\n", (unsigned long) state_errors);
-}
+	atomic_store_explicit(&w->seq, seq + 2, memory_order_release);
 
-static void on_signal(void *data, int signal_number) {
-	(void) signal_number;
-	struct bench_context *ctx = data;
-	atomic_store(&ctx->should_stop, true);
-	pw_main_loop_quit(ctx->loop);
+	s->win_epoch = epoch;
+	s->win_max_ns = 0;
 }
 
-static void on_duration_timeout(void *data, uint64_t expirations) {
-	(void) expirations;
-	struct bench_context *ctx = data;
-	atomic_store(&ctx->should_stop, true);
-	pw_main_loop_quit(ctx->loop);
+static void window_read(struct window_snapshot *w, struct window_view *v) {
+	for (;;) {
+		unsigned int seq =
+			atomic_load_explicit(&w->seq, memory_order_acquire);
+		if (seq & 1)
+			continue;
+
+		v->closed_epoch = atomic_load_explicit(&w->closed_epoch,
+						       memory_order_relaxed);
+		v->callback_count = atomic_load_explicit(
+			&w->callback_count, memory_order_relaxed);
+		v->over_threshold_3 = atomic_load_explicit(
+			&w->over_threshold_3, memory_order_relaxed);
+		v->errors = atomic_load_explicit(&w->errors,
+						 memory_order_relaxed);
+		v->max_ns = atomic_load_explicit(&w->max_ns,
+						 memory_order_relaxed);
+		for (uint32_t i = 0; i < LIVE_BUCKETS; i++)
+			v->hist[i] = atomic_load_explicit(
+				&w->hist[i], memory_order_relaxed);
+
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&w->seq, memory_order_relaxed) == seq)
+			return;
+	}
 }
 
-static void on_progress_tick(void *data, uint64_t expirations) {
-	(void) expirations;
-	struct bench_context *ctx = data;
+/* fold src into dst once both streams have stopped */
+static void stats_merge(struct rt_stats *dst, const struct rt_stats *src) {
+	dst->callback_count += src->callback_count;
+	dst->sum_ns += src->sum_ns;
+	dst->sum_sq_ns += src->sum_sq_ns;
+	if (src->max_ns > dst->max_ns)
+		dst->max_ns = src->max_ns;
 
-	uint64_t now = now_ns();
-	uint64_t elapsed_ns = now - ctx->run_start_ns;
-	uint64_t total_ns = (uint64_t) ctx->config.duration_sec * 1000000000ULL;
+	dst->over_threshold_1 += src->over_threshold_1;
+	dst->over_threshold_2 += src->over_threshold_2;
+	dst->over_threshold_3 += src->over_threshold_3;
+
+	dst->dequeue_fail += src->dequeue_fail;
+	dst->null_buffer += src->null_buffer;
+	dst->unmapped += src->unmapped;
+	dst->zero_interval += src->zero_interval;
+
+	dst->busy_sum_ns += src->busy_sum_ns;
+	dst->busy_count += src->busy_count;
+	if (src->busy_max_ns > dst->busy_max_ns)
+		dst->busy_max_ns = src->busy_max_ns;
+	dst->record_sum_ns += src->record_sum_ns;
+	if (src->record_max_ns > dst->record_max_ns)
+		dst->record_max_ns = src->record_max_ns;
+
+	dst->time_count += src->time_count;
+	dst->time_unavailable += src->time_unavailable;
+	dst->tick_gaps += src->tick_gaps;
+	dst->skipped_cycles += src->skipped_cycles;
+	dst->gap_checks += src->gap_checks;
+	dst->late_graph += src->late_graph;
+	dst->graph_span_ns += src->graph_span_ns;
+	dst->mono_span_ns += src->mono_span_ns;
+	dst->wake_sum_ns += src->wake_sum_ns;
+	if (src->wake_max_ns > dst->wake_max_ns)
+		dst->wake_max_ns = src->wake_max_ns;
+	if (src->delay_max_ns > dst->delay_max_ns)
+		dst->delay_max_ns = src->delay_max_ns;
+
+	dst->capture_frames += src->capture_frames;
+	dst->tone_frames += src->tone_frames;
+	dst->silent_buffers += src->silent_buffers;
+	dst->discontinuities += src->discontinuities;
+
+	if (src->align_count > 0) {
+		bool first = dst->align_count == 0;
+		if (first || src->align_min_ns < dst->align_min_ns)
+			dst->align_min_ns = src->align_min_ns;
+		if (first || src->align_max_ns > dst->align_max_ns)
+			dst->align_max_ns = src->align_max_ns;
+		dst->align_count += src->align_count;
+		dst->align_sum_ns += src->align_sum_ns;
+	}
+
+	for (uint32_t i = 0; i < MAX_HISTOGRAM_BUCKETS; i++)
+		dst->histogram[i] += src->histogram[i];
+	for (uint32_t i = 0; i < HDR_BUCKETS; i++) {
+		dst->hdr[i] += src->hdr[i];
+		dst->busy_hdr[i] += src->busy_hdr[i];
+		dst->wake_hdr[i] += src->wake_hdr[i];
+		dst->delay_hdr[i] += src->delay_hdr[i];
+		dst->align_hdr[i] += src->align_hdr[i];
+	}
+
+	uint64_t start = src->test_start_ns;
+	if (start != 0 &&
+	    (dst->test_start_ns == 0 || start < dst->test_start_ns))
+		dst->test_start_ns = start;
+	if (src->test_end_ns > dst->test_end_ns)
+		dst->test_end_ns = src->test_end_ns;
+}
+
+static double stats_stddev_ns(const struct rt_stats *s) {
+	if (s->callback_count < 2)
+		return 0.0;
+
+	double n = (double) s->callback_count;
+	double mean = (double) s->sum_ns / n;
+	double var = s->sum_sq_ns / n - mean * mean;
+	return var > 0 ? sqrt(var) : 0.0;
+}
+
+static void report_graph_time(const struct rt_stats *s) {
+	uint64_t count = s->time_count;
+
+	printf("Graph timing (pw_stream_get_time_n):\n");
+	if (count == 0) {
+		printf("  Samples:          none (no graph time available)\n");
+		printf("\n");
+		return;
+	}
+
+	printf("  Samples:          %lu  (%lu without graph time)\n",
+	       (unsigned long) count, (unsigned long) s->time_unavailable);
+	printf("  Wakeup latency:   %.2f us avg, %.2f us p99, %.2f us p99.9, "
+	       "%.2f us max\n",
+	       (double) s->wake_sum_ns / count / 1000.0,
+	       hdr_value_at_percentile(s->wake_hdr, count, 99.0) / 1000.0,
+	       hdr_value_at_percentile(s->wake_hdr, count, 99.9) / 1000.0,
+	       s->wake_max_ns / 1000.0);
+	printf("  Delay:            %.2f us p50, %.2f us p99, %.2f us max\n",
+	       hdr_value_at_percentile(s->delay_hdr, count, 50.0) / 1000.0,
+	       hdr_value_at_percentile(s->delay_hdr, count, 99.0) / 1000.0,
+	       s->delay_max_ns / 1000.0);
+	if (s->gap_checks > 0)
+		printf("  Skipped cycles:   %lu  (%lu tick gaps)\n",
+		       (unsigned long) s->skipped_cycles,
+		       (unsigned long) s->tick_gaps);
+	else
+		printf("  Skipped cycles:   gap check unavailable (no graph "
+		       "position)\n");
+	if (s->mono_span_ns > 0)
+		printf("  Clock drift:      %+.2f ppm  (graph vs monotonic)\n",
+		       (s->graph_span_ns - s->mono_span_ns) / s->mono_span_ns *
+			       1e6);
+
+	uint64_t late = s->over_threshold_3;
+	uint64_t late_graph = s->late_graph < late ? s->late_graph : late;
+	if (s->gap_checks > 0)
+		printf("  Late callbacks:   %lu with skipped graph cycles, %lu "
+		       "with the graph on time\n",
+		       (unsigned long) late_graph,
+		       (unsigned long) (late - late_graph));
+	printf("\n");
+}
+
+static void report_capture(const struct bench_context *ctx,
+			   const struct rt_stats *s) {
+	if (ctx->config.n_input == 0)
+		return;
+
+	printf("Capture continuity (%.0f Hz test tone):\n", TONE_FREQ);
+	printf("  Frames:           %lu  (%.1f%% with the tone)\n",
+	       (unsigned long) s->capture_frames,
+	       s->capture_frames > 0
+		       ? 100.0 * s->tone_frames / s->capture_frames
+		       : 0.0);
+	printf("  Silent buffers:   %lu\n", (unsigned long) s->silent_buffers);
+	printf("  Discontinuities:  %lu\n", (unsigned long) s->discontinuities);
+	if (s->capture_frames > 0 && s->tone_frames == 0)
+		printf("  (no tone captured: nothing to validate)\n");
+	printf("\n");
+}
+
+static void report_align(const struct bench_context *ctx,
+			 const struct rt_stats *s) {
+	if (ctx->config.mode != MODE_DUPLEX)
+		return;
+
+	uint64_t playback = 0;
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		if (ctx->streams[i].direction == PW_DIRECTION_OUTPUT)
+			playback += ctx->streams[i].stats.callback_count;
+	}
+
+	printf("Duplex alignment (capture entry - playback entry):\n");
+	printf("  Paired cycles:    %lu of %lu\n",
+	       (unsigned long) s->align_count, (unsigned long) playback);
+	if (s->align_count > 0) {
+		printf("  Avg offset:       %.2f us\n",
+		       (double) s->align_sum_ns / s->align_count / 1000.0);
+		printf("  Range:            %.2f .. %.2f us\n",
+		       s->align_min_ns / 1000.0, s->align_max_ns / 1000.0);
+		printf("  p99 |offset|:     %.2f us\n",
+		       hdr_value_at_percentile(s->align_hdr, s->align_count,
+					       99.0) /
+			       1000.0);
+	}
+	printf("\n");
+}
+
+static bool is_own_node(const struct bench_context *ctx, uint32_t id) {
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		if (ctx->streams[i].node_id == id && id != 0)
+			return true;
+	}
+	return false;
+}
+
+static int compare_late(const void *a, const void *b) {
+	const struct graph_node *na = a, *nb = b;
+	return na->late < nb->late ? 1 : na->late > nb->late ? -1 : 0;
+}
+
+static void report_monitor(const struct bench_context *ctx) {
+	const struct graph_monitor *m = &ctx->monitor;
+
+	printf("Graph xruns (profiler):\n");
+	if (m->profiler == NULL) {
+		printf("  not available (is module-profiler loaded?)\n");
+		printf("\n");
+		return;
+	}
+	if (m->cycles == 0) {
+		printf("  no profiled cycle ran our nodes\n");
+		printf("\n");
+		return;
+	}
+
+	printf("  Driver:           %s (id %u)\n", m->driver_name,
+	       m->driver_id);
+	printf("  Driver cycles:    %lu\n", (unsigned long) m->cycles);
+	printf("  Graph xruns:      %lu\n", (unsigned long) m->xruns);
+	if (m->own_count > 0) {
+		printf("  Own wakeup:       %.2f us avg, %.2f us max  (signal "
+		       "to awake)\n",
+		       (double) m->own_wake_sum_ns / m->own_count / 1000.0,
+		       m->own_wake_max_ns / 1000.0);
+		printf("  Own processing:   %.2f us max  (awake to finish)\n",
+		       m->own_busy_max_ns / 1000.0);
+		printf("  Own unfinished:   %lu cycles\n",
+		       (unsigned long) m->own_unfinished);
+	}
+
+	struct graph_node late[MAX_GRAPH_NODES];
+	memcpy(late, m->nodes, m->n_nodes * sizeof(late[0]));
+	qsort(late, m->n_nodes, sizeof(late[0]), compare_late);
+	for (uint32_t i = 0; i < m->n_nodes && i < 5 && late[i].late > 0;
+	     i++)
+		printf("  %-18s%s (id %u%s): %lu\n",
+		       i == 0 ? "Late nodes:" : "", late[i].name, late[i].id,
+		       is_own_node(ctx, late[i].id) ? ", ours" : "",
+		       (unsigned long) late[i].late);
+	printf("\n");
+}
+
+static const char *stream_dir_name(const struct bench_stream *bs) {
+	return bs->direction == PW_DIRECTION_OUTPUT ? "out" : "in";
+}
+
+static void report_load(const struct bench_context *ctx,
+			const struct rt_stats *s) {
+	const struct bench_config *cfg = &ctx->config;
+	uint64_t count = s->busy_count;
+	double period = period_ns(cfg);
+
+	if (count == 0)
+		return;
+
+	double avg_ns = (double) s->busy_sum_ns / count;
+	double max_ns = (double) s->busy_max_ns;
+	double p99_ns =
+		(double) hdr_value_at_percentile(s->busy_hdr, count, 99.0);
+	double p999_ns =
+		(double) hdr_value_at_percentile(s->busy_hdr, count, 99.9);
+
+	printf("Callback load (busy time / period):\n");
+	printf("  Avg busy:         %.2f us  (%.1f%%)\n", avg_ns / 1000.0,
+	       100.0 * avg_ns / period);
+	printf("  p99 busy:         %.2f us  (%.1f%%)\n", p99_ns / 1000.0,
+	       100.0 * p99_ns / period);
+	printf("  p99.9 busy:       %.2f us  (%.1f%%)\n", p999_ns / 1000.0,
+	       100.0 * p999_ns / period);
+	printf("  Max busy:         %.2f us  (%.1f%%)\n", max_ns / 1000.0,
+	       100.0 * max_ns / period);
+	printf("  Stats overhead:   %.0f ns avg, %.0f ns max\n",
+	       (double) s->record_sum_ns / count, (double) s->record_max_ns);
+
+	if (cfg->load_pct > 0 || cfg->ramp_step_pct > 0) {
+		printf("  Synthetic load:   %.1f%% -> %.1f%%", cfg->load_pct,
+		       ctx->ramp_load_pct);
+		if (cfg->ramp_step_pct > 0)
+			printf("  (+%.1f%%/s)", cfg->ramp_step_pct);
+		printf("\n");
+	}
+	if (cfg->ramp_step_pct > 0) {
+		if (ctx->ramp_limit_found && ctx->ramp_limit_pct >= 0)
+			printf("  Max sustainable:  %.1f%%  (%.2f us)\n",
+			       ctx->ramp_limit_pct,
+			       period * ctx->ramp_limit_pct / 100.0 / 1000.0);
+		else if (ctx->ramp_limit_found)
+			printf("  Max sustainable:  below the start load\n");
+		else if (ctx->ramp_done)
+			printf("  Max sustainable:  no xruns up to 100%%\n");
+		else
+			printf("  Max sustainable:  not reached within the "
+			       "run\n");
+	}
+	printf("\n");
+}
+
+static void report_jitter(const char *label, const struct rt_stats *s) {
+	uint64_t n = s->callback_count;
+
+	printf("  %-18s%.2f us stddev, p99 %.2f us, max %.2f us\n", label,
+	       stats_stddev_ns(s) / 1000.0,
+	       hdr_value_at_percentile(s->hdr, n, 99.0) / 1000.0,
+	       s->max_ns / 1000.0);
+}
+
+static void report_driver(const struct bench_context *ctx) {
+	const struct driver_timer *d = ctx->driver;
+
+	if (d == NULL)
+		return;
+
+	printf("Driver timer (out 0 drives the graph):\n");
+	printf("  Timer ticks:      %lu  (%lu periods missed)\n",
+	       (unsigned long) d->ticks, (unsigned long) d->missed);
+	if (d->not_driving > 0)
+		printf("  Not driving:      %lu ticks\n",
+		       (unsigned long) d->not_driving);
+	if (d->ticks > 0) {
+		uint64_t p99 = loglin_value_at_percentile(
+			d->wake_hist, LIVE_BUCKETS, LIVE_SUB_BITS, d->ticks,
+			99.0);
+
+		printf("  Timer wakeup:     avg %.2f us, p99 %.2f us, max "
+		       "%.2f us\n",
+		       (double) d->wake_sum_ns / d->ticks / 1000.0,
+		       p99 / 1000.0, d->wake_max_ns / 1000.0);
+	}
+
+	/* the followers see the driver's wakeup plus the graph signalling */
+	report_jitter("Driver jitter:", &d->stream->stats);
+	if (ctx->n_streams > 1) {
+		struct rt_stats *followers = calloc(1, sizeof(*followers));
+
+		if (followers) {
+			for (uint32_t i = 1; i < ctx->n_streams; i++)
+				stats_merge(followers, &ctx->streams[i].stats);
+			report_jitter("Follower jitter:", followers);
+			free(followers);
+		}
+	}
+	printf("\n");
+}
+
+static void report_buffers(const struct bench_context *ctx,
+			   const struct rt_stats *s) {
+	const struct bench_config *cfg = &ctx->config;
+	const struct buffer_layout *l = &ctx->streams[0].layout;
+	const char *sep = "";
+	uint32_t differ = 0;
+
+	printf("Buffers:\n");
+	printf("  Requested:        ");
+	if (cfg->n_buffers > 0) {
+		printf("%u buffers", cfg->n_buffers);
+		sep = ", ";
+	}
+	if (cfg->buffer_size > 0) {
+		printf("%s%u bytes", sep, cfg->buffer_size);
+		sep = ", ";
+	}
+	if (cfg->buffer_align > 0) {
+		printf("%salign %u", sep, cfg->buffer_align);
+		sep = ", ";
+	}
+	size_t n_types = sizeof(data_types) / sizeof(data_types[0]);
+	for (size_t i = 0; i < n_types; i++) {
+		if (cfg->data_types & (1u << data_types[i].type)) {
+			printf("%s%s", sep, data_types[i].name);
+			sep = "|";
+		}
+	}
+	if (*sep == '\0')
+		printf("PipeWire defaults");
+	printf("%s\n", cfg->no_map ? ", not mapped" : "");
+
+	if (l->sets == 0) {
+		printf("  Negotiated:       none\n\n");
+		return;
+	}
+
+	uint32_t stride = format_stride(cfg->format, cfg->channels);
+	printf("  Negotiated:       %u x %u data, %s, %u bytes", l->count,
+	       l->datas, data_type_name(l->type), l->maxsize);
+	if (stride > 0)
+		printf(" (%u frames)", l->maxsize / stride);
+	printf("\n");
+	if (l->mapped)
+		printf("  Mapping:          mapped, aligned to %u bytes\n",
+		       l->align);
+	else
+		printf("  Mapping:          not mapped\n");
+	if (l->sets > 1)
+		printf("  Renegotiations:   %u\n", l->sets - 1);
+	if (cfg->no_map)
+		printf("  Unmapped cycles:  %lu\n",
+		       (unsigned long) s->unmapped);
+
+	for (uint32_t i = 1; i < ctx->n_streams; i++) {
+		const struct buffer_layout *o = &ctx->streams[i].layout;
+		if (o->count != l->count || o->type != l->type ||
+		    o->maxsize != l->maxsize || o->mapped != l->mapped)
+			differ++;
+	}
+	if (differ > 0)
+		printf("  Other layouts:    %u streams\n", differ);
+	printf("\n");
+}
+
+static uint64_t bench_state_errors(const struct bench_context *ctx) {
+	uint64_t state_errors = 0;
+	for (uint32_t i = 0; i < ctx->n_streams; i++)
+		state_errors += ctx->streams[i].state_errors;
+	return state_errors;
+}
+
+static void report_streams(const struct bench_context *ctx) {
+	const struct bench_config *cfg = &ctx->config;
+	const struct rt_stats *t = ctx->total;
+	const struct bench_stream *worst = NULL;
+	uint64_t worst_p999 = 0;
+
+	printf("Per-stream statistics:\n");
+	printf("  stream   callbacks    avg us    p99 us  p99.9 us    max us"
+	       "    >%.1fx  errors\n",
+	       cfg->threshold_3);
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		const struct bench_stream *bs = &ctx->streams[i];
+		const struct rt_stats *s = &bs->stats;
+		uint64_t n = s->callback_count;
+		uint64_t p99 = hdr_value_at_percentile(s->hdr, n, 99.0);
+		uint64_t p999 = hdr_value_at_percentile(s->hdr, n, 99.9);
+
+		if (worst == NULL || p999 > worst_p999) {
+			worst = bs;
+			worst_p999 = p999;
+		}
+		printf("  %-3s %3u  %10lu  %8.2f  %8.2f  %8.2f  %8.2f  %7lu  "
+		       "%6lu\n",
+		       stream_dir_name(bs), bs->index, (unsigned long) n,
+		       n > 0 ? (double) s->sum_ns / n / 1000.0 : 0.0,
+		       p99 / 1000.0, p999 / 1000.0, s->max_ns / 1000.0,
+		       (unsigned long) s->over_threshold_3,
+		       (unsigned long) (s->dequeue_fail + s->null_buffer +
+					bs->state_errors));
+	}
+	printf("\n");
+
+	double minutes = (double) (t->test_end_ns - t->test_start_ns) / 60e9;
+	printf("Stream scaling (%u streams):\n", ctx->n_streams);
+	printf("  Jitter (stddev):  %.2f us\n", stats_stddev_ns(t) / 1000.0);
+	printf("  XRUN rate:        %.3f%% of callbacks; %.2f per "
+	       "stream-minute\n",
+	       t->callback_count > 0 ? 100.0 * t->over_threshold_3 /
+					       t->callback_count
+				     : 0.0,
+	       minutes > 0 ? t->over_threshold_3 / minutes / ctx->n_streams
+			   : 0.0);
+	if (worst)
+		printf("  Worst p99.9:      %.2f us  (%s %u)\n",
+		       worst_p999 / 1000.0, stream_dir_name(worst),
+		       worst->index);
+	printf("\n");
+}
+
+static void report_results(const struct bench_context *ctx) {
+	const struct bench_config *cfg = &ctx->config;
+	const struct rt_stats *s = ctx->total;
+	const struct bench_stream *first = &ctx->streams[0];
+
+	uint64_t callback_count = s->callback_count;
+	double expected_period_us =
+		1e6 * (double) cfg->quantum / (double) cfg->rate;
+
+	uint64_t sum_ns = s->sum_ns;
+	uint64_t max_ns = s->max_ns;
+	uint64_t p50_ns = hdr_value_at_percentile(s->hdr, callback_count, 50.0);
+	uint64_t p95_ns = hdr_value_at_percentile(s->hdr, callback_count, 95.0);
+	uint64_t p99_ns = hdr_value_at_percentile(s->hdr, callback_count, 99.0);
+	uint64_t p999_ns =
+		hdr_value_at_percentile(s->hdr, callback_count, 99.9);
+	uint64_t p9999_ns =
+		hdr_value_at_percentile(s->hdr, callback_count, 99.99);
+
+	uint64_t over_1 = s->over_threshold_1;
+	uint64_t over_2 = s->over_threshold_2;
+	uint64_t over_3 = s->over_threshold_3;
+
+	uint64_t dequeue_fail = s->dequeue_fail;
+	uint64_t null_buffer = s->null_buffer;
+	uint64_t state_errors = bench_state_errors(ctx);
+
+	uint32_t actual_rate = atomic_load(&first->actual_rate);
+	uint32_t actual_quantum = atomic_load(&first->actual_quantum);
+
+	if (actual_rate == 0)
+		actual_rate = cfg->rate;
+
+	double avg_us = callback_count > 0
+				? (double) sum_ns / callback_count / 1000.0
+				: 0.0;
+
+	double pct_1 = callback_count > 0 ? 100.0 * (double) over_1 /
+						    (double) callback_count
+					  : 0.0;
+	double pct_2 = callback_count > 0 ? 100.0 * (double) over_2 /
+						    (double) callback_count
+					  : 0.0;
+	double pct_3 = callback_count > 0 ? 100.0 * (double) over_3 /
+						    (double) callback_count
+					  : 0.0;
+
+	const char *title = cfg->mode == MODE_CAPTURE  ? "Capture"
+			    : cfg->mode == MODE_DUPLEX ? "Duplex"
+						       : "Playback";
+	printf("PipeWire %s Benchmark Summary\n", title);
+	printf("====================================\n");
+	printf("Duration:           %.3f s\n",
+	       (double) (s->test_end_ns - s->test_start_ns) / 1e9);
+	uint32_t actual_format = atomic_load(&first->actual_format);
+	const char *actual_format_name =
+		actual_format != 0
+			? spa_type_audio_format_to_short_name(actual_format)
+			: "UNKNOWN";
+
+	printf("Requested rate:     %u Hz\n", cfg->rate);
+	printf("Requested quantum:  %u frames\n", cfg->quantum);
+	printf("Requested format:   %s\n",
+	       spa_type_audio_format_to_short_name(cfg->format));
+	printf("Actual rate:        %u Hz\n", actual_rate);
+	if (actual_quantum > 0)
+		printf("Actual quantum:     %u frames\n", actual_quantum);
+	else
+		printf("Actual quantum:     unknown (no graph position)\n");
+	printf("Actual format:      %s\n", actual_format_name);
+	printf("Theoretical period: %.2f us\n", expected_period_us);
+	printf("Streams:            %u playback, %u capture\n",
+	       cfg->n_output, cfg->n_input);
+	if (ctx->trace) {
+		uint64_t records = 0, dropped = 0;
+		for (uint32_t i = 0; i < ctx->trace->n_streams; i++) {
+			records += ctx->trace->streams[i].count;
+			dropped += ctx->trace->streams[i].dropped;
+		}
+		printf("Trace:              %s (%lu records, %lu dropped)\n",
+		       cfg->trace_path, (unsigned long) records,
+		       (unsigned long) dropped);
+	}
+	printf("\n");
+	printf("Callback statistics:\n");
+	printf("  Total callbacks:  %lu\n", (unsigned long) callback_count);
+	printf("  Avg interval:     %.2f us\n", avg_us);
+	printf("  Jitter (stddev):  %.2f us\n", stats_stddev_ns(s) / 1000.0);
+	printf("  p50 interval:     %.2f us\n", (double) p50_ns / 1000.0);
+	printf("  p95 interval:     %.2f us\n", (double) p95_ns / 1000.0);
+	printf("  p99 interval:     %.2f us\n", (double) p99_ns / 1000.0);
+	printf("  p99.9 interval:   %.2f us\n", (double) p999_ns / 1000.0);
+	printf("  p99.99 interval:  %.2f us\n", (double) p9999_ns / 1000.0);
+	printf("  Max interval:     %.2f us\n", (double) max_ns / 1000.0);
+	printf("\n");
+	report_load(ctx, s);
+	report_buffers(ctx, s);
+	report_driver(ctx);
+	report_graph_time(s);
+	report_monitor(ctx);
+	if (ctx->sched) {
+		uint64_t unqueued = 0;
+		for (uint32_t i = 0; i < ctx->n_streams; i++)
+			unqueued += ctx->streams[i].late_dropped;
+		sched_trace_report(ctx->sched, unqueued);
+	}
+	report_capture(ctx, s);
+	report_align(ctx, s);
+	if (ctx->n_streams > 1)
+		report_streams(ctx);
+	printf("Threshold violations:\n");
+	printf("  >%.1fx period:    %lu  (%.2f%%)\n", cfg->threshold_1,
+	       (unsigned long) over_1, pct_1);
+	printf("  >%.1fx period:    %lu  (%.2f%%)\n", cfg->threshold_2,
+	       (unsigned long) over_2, pct_2);
+	printf("  >%.1fx period:    %lu  (%.2f%%)\n", cfg->threshold_3,
+	       (unsigned long) over_3, pct_3);
+	printf("\n");
+	printf("Errors:\n");
+	printf("  dequeue failures: %lu\n", (unsigned long) dequeue_fail);
+	printf("  null buffers:     %lu\n", (unsigned long) null_buffer);
+	printf("  state errors:     %lu\n", (unsigned long) state_errors);
+}
+
+static const char *const mode_names[] = {
+	[MODE_PLAYBACK] = "playback",
+	[MODE_CAPTURE] = "capture",
+	[MODE_DUPLEX] = "duplex",
+};
+
+/*
+ * confidence bounds of a percentile from the histogram alone: the rank
+ * of a sample quantile is binomial, so the order statistics COMPARE_Z
+ * standard deviations around it bound the true percentile
+ */
+static void percentile_bounds(const uint64_t *hdr, uint64_t count,
+			      double percentile, uint64_t *lo, uint64_t *hi) {
+	double q = percentile / 100.0;
+	double n = (double) count;
+	double sd = sqrt(n * q * (1.0 - q));
+	double lo_pct = (n * q - COMPARE_Z * sd) / n * 100.0;
+	double hi_pct = (n * q + COMPARE_Z * sd) / n * 100.0;
+
+	*lo = hdr_value_at_percentile(hdr, count, lo_pct > 0 ? lo_pct : 0);
+	*hi = hdr_value_at_percentile(hdr, count,
+				      hi_pct < 100 ? hi_pct : 100);
+}
+
+static void json_percentile(struct json_writer *w, const char *key,
+			    const uint64_t *hdr, uint64_t count,
+			    double percentile) {
+	char name[32];
+	uint64_t lo, hi;
+
+	percentile_bounds(hdr, count, percentile, &lo, &hi);
+	json_uint(w, key, hdr_value_at_percentile(hdr, count, percentile));
+	snprintf(name, sizeof(name), "%s_lo", key);
+	json_uint(w, name, lo);
+	snprintf(name, sizeof(name), "%s_hi", key);
+	json_uint(w, name, hi);
+}
+
+/* null until the stream ran a cycle with a position io */
+static void json_quantum(struct json_writer *w, const struct bench_stream *bs) {
+	uint32_t quantum = atomic_load(&bs->actual_quantum);
+
+	if (quantum > 0)
+		json_uint(w, "quantum", quantum);
+	else
+		json_double(w, "quantum", NAN);
+}
+
+static void json_stream(struct json_writer *w, const struct bench_stream *bs) {
+	const struct rt_stats *s = &bs->stats;
+	const struct buffer_layout *l = &bs->layout;
+	uint64_t n = s->callback_count;
+	uint32_t format = atomic_load(&bs->actual_format);
+
+	json_object(w, NULL);
+	json_string(w, "direction", stream_dir_name(bs));
+	json_uint(w, "index", bs->index);
+	json_uint(w, "node_id", bs->node_id);
+	json_uint(w, "rate", atomic_load(&bs->actual_rate));
+	json_quantum(w, bs);
+	json_string(w, "format",
+		    format != 0 ? spa_type_audio_format_to_short_name(format)
+				: "UNKNOWN");
+	json_uint(w, "buffers", l->count);
+	json_uint(w, "buffer_datas", l->datas);
+	json_string(w, "buffer_type", data_type_name(l->type));
+	json_uint(w, "buffer_size", l->maxsize);
+	json_bool(w, "buffer_mapped", l->mapped);
+	json_uint(w, "callbacks", n);
+	json_double(w, "avg_ns", n > 0 ? (double) s->sum_ns / n : 0.0);
+	json_uint(w, "p99_ns", hdr_value_at_percentile(s->hdr, n, 99.0));
+	json_uint(w, "p999_ns", hdr_value_at_percentile(s->hdr, n, 99.9));
+	json_uint(w, "max_ns", s->max_ns);
+	json_uint(w, "over_threshold_3", s->over_threshold_3);
+	json_uint(w, "errors",
+		  s->dequeue_fail + s->null_buffer + bs->state_errors);
+	json_close(w, '}');
+}
+
+/* -o json: everything report_results() prints, on stdout */
+static void report_json(const struct bench_context *ctx) {
+	const struct bench_config *cfg = &ctx->config;
+	const struct rt_stats *s = ctx->total;
+	const struct bench_stream *first = &ctx->streams[0];
+	uint64_t n = s->callback_count;
+	struct json_writer w;
+
+	json_begin(&w, stdout);
+	json_uint(&w, "version", RESULTS_VERSION);
+
+	json_object(&w, "config");
+	json_string(&w, "mode", mode_names[cfg->mode]);
+	json_uint(&w, "rate", cfg->rate);
+	json_uint(&w, "quantum", cfg->quantum);
+	json_uint(&w, "channels", cfg->channels);
+	json_string(&w, "format",
+		    spa_type_audio_format_to_short_name(cfg->format));
+	json_uint(&w, "duration_s", cfg->duration_sec);
+	json_uint(&w, "playback_streams", cfg->n_output);
+	json_uint(&w, "capture_streams", cfg->n_input);
+	json_double(&w, "load_pct", cfg->load_pct);
+	json_double(&w, "ramp_step_pct", cfg->ramp_step_pct);
+	json_bool(&w, "driver", cfg->driver);
+	json_double(&w, "threshold_1", cfg->threshold_1);
+	json_double(&w, "threshold_2", cfg->threshold_2);
+	json_double(&w, "threshold_3", cfg->threshold_3);
+	json_close(&w, '}');
+
+	uint32_t actual_format = atomic_load(&first->actual_format);
+	json_object(&w, "negotiated");
+	json_uint(&w, "rate", atomic_load(&first->actual_rate));
+	json_quantum(&w, first);
+	json_string(&w, "format",
+		    actual_format != 0
+			    ? spa_type_audio_format_to_short_name(actual_format)
+			    : "UNKNOWN");
+	json_close(&w, '}');
+
+	json_double(&w, "duration_s",
+		    (double) (s->test_end_ns - s->test_start_ns) / 1e9);
+	json_double(&w, "period_ns", period_ns(cfg));
+
+	json_object(&w, "intervals");
+	json_uint(&w, "count", n);
+	json_double(&w, "avg_ns", n > 0 ? (double) s->sum_ns / n : 0.0);
+	json_double(&w, "stddev_ns", stats_stddev_ns(s));
+	json_uint(&w, "p50_ns", hdr_value_at_percentile(s->hdr, n, 50.0));
+	json_uint(&w, "p95_ns", hdr_value_at_percentile(s->hdr, n, 95.0));
+	json_percentile(&w, "p99_ns", s->hdr, n, 99.0);
+	json_percentile(&w, "p999_ns", s->hdr, n, 99.9);
+	json_uint(&w, "p9999_ns", hdr_value_at_percentile(s->hdr, n, 99.99));
+	json_uint(&w, "max_ns", s->max_ns);
+	json_close(&w, '}');
+
+	uint64_t busy = s->busy_count;
+	json_object(&w, "busy");
+	json_double(&w, "avg_ns",
+		    busy > 0 ? (double) s->busy_sum_ns / busy : 0.0);
+	json_uint(&w, "p99_ns",
+		  hdr_value_at_percentile(s->busy_hdr, busy, 99.0));
+	json_uint(&w, "p999_ns",
+		  hdr_value_at_percentile(s->busy_hdr, busy, 99.9));
+	json_uint(&w, "max_ns", s->busy_max_ns);
+	json_double(&w, "ramp_load_pct", ctx->ramp_load_pct);
+	json_close(&w, '}');
+
+	uint64_t t = s->time_count;
+	json_object(&w, "graph");
+	json_uint(&w, "samples", t);
+	json_uint(&w, "unavailable", s->time_unavailable);
+	json_double(&w, "wakeup_avg_ns",
+		    t > 0 ? (double) s->wake_sum_ns / t : 0.0);
+	json_uint(&w, "wakeup_p99_ns",
+		  hdr_value_at_percentile(s->wake_hdr, t, 99.0));
+	json_uint(&w, "wakeup_max_ns", s->wake_max_ns);
+	/* null: no position io, the gap check never ran */
+	json_uint(&w, "gap_checks", s->gap_checks);
+	json_double(&w, "skipped_cycles",
+		    s->gap_checks > 0 ? (double) s->skipped_cycles : NAN);
+	json_double(&w, "tick_gaps",
+		    s->gap_checks > 0 ? (double) s->tick_gaps : NAN);
+	json_double(&w, "late_graph",
+		    s->gap_checks > 0 ? (double) s->late_graph : NAN);
+	if (ctx->monitor.profiler) {
+		json_uint(&w, "profiler_cycles", ctx->monitor.cycles);
+		json_uint(&w, "profiler_xruns", ctx->monitor.xruns);
+	}
+	json_close(&w, '}');
+
+	json_object(&w, "violations");
+	json_uint(&w, "over_threshold_1", s->over_threshold_1);
+	json_uint(&w, "over_threshold_2", s->over_threshold_2);
+	json_uint(&w, "over_threshold_3", s->over_threshold_3);
+	json_close(&w, '}');
+
+	json_object(&w, "errors");
+	json_uint(&w, "dequeue_fail", s->dequeue_fail);
+	json_uint(&w, "null_buffer", s->null_buffer);
+	json_uint(&w, "state_errors", bench_state_errors(ctx));
+	json_uint(&w, "discontinuities", s->discontinuities);
+	json_close(&w, '}');
+
+	json_array(&w, "streams");
+	for (uint32_t i = 0; i < ctx->n_streams; i++)
+		json_stream(&w, &ctx->streams[i]);
+	json_close(&w, ']');
+
+	json_end(&w);
+}
+
+/*
+ * P(X >= k) for X ~ Poisson(lambda). The terms are built in log space:
+ * exp(-lambda) alone underflows for lambda above ~745, a run several
+ * hundred times longer than its baseline
+ */
+static double poisson_tail(double lambda, uint64_t k) {
+	double below = 0.0;
+
+	if (k == 0)
+		return 1.0;
+	if (lambda <= 0.0)
+		return 0.0;
+	/* far out in either tail the sum only loses precision */
+	if ((double) k > lambda + 40.0 * sqrt(lambda) + 40.0)
+		return 0.0;
+	if ((double) k < lambda - 40.0 * sqrt(lambda))
+		return 1.0;
+	double log_lambda = log(lambda);
+	for (uint64_t i = 0; i < k; i++)
+		below += exp((double) i * log_lambda - lambda -
+			     lgamma((double) i + 1.0));
+	return below < 1.0 ? 1.0 - below : 0.0;
+}
+
+/* intervals of this run strictly above value */
+static uint64_t count_above(const struct rt_stats *s, uint64_t value) {
+	uint64_t above = 0;
+
+	for (uint32_t i = hdr_index(value) + 1; i < HDR_BUCKETS; i++)
+		above += s->hdr[i];
+	return above;
+}
+
+static void compare_config(FILE *out, const struct result_file *base,
+			   const struct bench_config *cfg) {
+	static const struct {
+		const char *key;
+		size_t offset;
+	} fields[] = {
+		{"config.rate", offsetof(struct bench_config, rate)},
+		{"config.quantum", offsetof(struct bench_config, quantum)},
+		{"config.channels", offsetof(struct bench_config, channels)},
+		{"config.playback_streams",
+		 offsetof(struct bench_config, n_output)},
+		{"config.capture_streams",
+		 offsetof(struct bench_config, n_input)},
+	};
+	double v;
+
+	for (size_t i = 0; i < SPA_N_ELEMENTS(fields); i++) {
+		uint32_t ours;
+		memcpy(&ours, (const char *) cfg + fields[i].offset,
+		       sizeof(ours));
+		if (result_number(base, fields[i].key, &v) && v != ours)
+			fprintf(out, "  warning: baseline %s %.0f, this run "
+				     "%u\n",
+				fields[i].key + strlen("config."), v, ours);
+	}
+
+	const char *format = result_text(base, "config.format");
+	const char *ours = spa_type_audio_format_to_short_name(cfg->format);
+	if (format && strcmp(format, ours) != 0)
+		fprintf(out, "  warning: baseline format %s, this run %s\n",
+			format, ours);
+}
+
+/* both percentile estimates differ by more than their uncertainty, and
+ * by more than the histogram resolution */
+static bool compare_percentile(FILE *out, const struct result_file *base,
+			       const struct rt_stats *s, const char *key,
+			       const char *label, double percentile) {
+	char name[64];
+	double b, b_hi;
+	uint64_t n = s->callback_count;
+
+	snprintf(name, sizeof(name), "intervals.%s", key);
+	if (!result_number(base, name, &b))
+		return false;
+	snprintf(name, sizeof(name), "intervals.%s_hi", key);
+	if (!result_number(base, name, &b_hi))
+		b_hi = b;
+
+	uint64_t cur = hdr_value_at_percentile(s->hdr, n, percentile);
+	uint64_t lo, hi;
+	percentile_bounds(s->hdr, n, percentile, &lo, &hi);
+
+	bool regressed =
+		lo > b_hi && cur > b * (1.0 + COMPARE_MIN_CHANGE);
+	fprintf(out, "  %-18s%.2f us vs %.2f us  (%+.1f%%)%s\n", label,
+		cur / 1000.0, b / 1000.0, b > 0 ? 100.0 * (cur - b) / b : 0.0,
+		regressed ? "  REGRESSION" : "");
+	return regressed;
+}
+
+/*
+ * a single maximum has no spread to test, but the number of intervals
+ * above the baseline maximum does: from the same distribution, each of
+ * n intervals exceeds the maximum of m with probability 1 / (m + 1)
+ */
+static bool compare_max(FILE *out, const struct result_file *base,
+			const struct rt_stats *s) {
+	double b, m;
+
+	if (!result_number(base, "intervals.max_ns", &b) ||
+	    !result_number(base, "intervals.count", &m) || b < 0)
+		return false;
+
+	uint64_t above = count_above(s, (uint64_t) b);
+	double expected = (double) s->callback_count / (m + 1.0);
+	bool regressed = poisson_tail(expected, above) < COMPARE_ALPHA;
+
+	fprintf(out, "  %-18s%.2f us vs %.2f us  (%lu above, %.1f "
+		     "expected)%s\n",
+		"Max interval:", s->max_ns / 1000.0, b / 1000.0,
+		(unsigned long) above, expected,
+		regressed ? "  REGRESSION" : "");
+	return regressed;
+}
+
+/* one-sided two-proportion z-test on the violation rate */
+static bool compare_rate(FILE *out, const struct result_file *base,
+			 const struct rt_stats *s, int which, double factor) {
+	char key[64], label[32];
+	double b_count, b_n, b_factor;
+	uint64_t counts[] = {s->over_threshold_1, s->over_threshold_2,
+			     s->over_threshold_3};
+	uint64_t count = counts[which - 1];
+	double n = (double) s->callback_count;
+
+	snprintf(label, sizeof(label), ">%.1fx rate:", factor);
+	snprintf(key, sizeof(key), "violations.over_threshold_%d", which);
+	if (!result_number(base, key, &b_count) ||
+	    !result_number(base, "intervals.count", &b_n) || b_n <= 0 ||
+	    n <= 0)
+		return false;
+	snprintf(key, sizeof(key), "config.threshold_%d", which);
+	if (result_number(base, key, &b_factor) &&
+	    fabs(b_factor - factor) > 1e-9) {
+		fprintf(out, "  %-18sbaseline used %.1fx, not compared\n",
+			label, b_factor);
+		return false;
+	}
+
+	double p_base = b_count / b_n;
+	double p_cur = (double) count / n;
+	double pooled = (b_count + (double) count) / (b_n + n);
+	double se = sqrt(pooled * (1.0 - pooled) * (1.0 / b_n + 1.0 / n));
+	double z = se > 0 ? (p_cur - p_base) / se : 0.0;
+	bool regressed = z >= COMPARE_Z;
+
+	fprintf(out, "  %-18s%.3f%% vs %.3f%%  (z %.1f)%s\n", label,
+		100.0 * p_cur, 100.0 * p_base, z,
+		regressed ? "  REGRESSION" : "");
+	return regressed;
+}
+
+/* -C: regressions against a -o json baseline, negative errno if it
+ * cannot be read */
+static int compare_baseline(const struct bench_context *ctx, FILE *out) {
+	const struct bench_config *cfg = &ctx->config;
+	const struct rt_stats *s = ctx->total;
+	struct result_file base;
+	double version;
+	int res, regressions = 0;
+
+	if ((res = result_load(&base, cfg->compare_path)) < 0)
+		return res;
+	if (!result_number(&base, "version", &version) ||
+	    version != RESULTS_VERSION) {
+		result_free(&base);
+		return -EINVAL;
+	}
+
+	fprintf(out, "Baseline comparison (%s):\n", cfg->compare_path);
+	compare_config(out, &base, cfg);
+	regressions += compare_percentile(out, &base, s, "p99_ns",
+					  "p99 interval:", 99.0);
+	regressions += compare_percentile(out, &base, s, "p999_ns",
+					  "p99.9 interval:", 99.9);
+	regressions += compare_max(out, &base, s);
+	regressions += compare_rate(out, &base, s, 1, cfg->threshold_1);
+	regressions += compare_rate(out, &base, s, 2, cfg->threshold_2);
+	regressions += compare_rate(out, &base, s, 3, cfg->threshold_3);
+	fprintf(out, "  Regressions:      %d\n", regressions);
+	fprintf(out, "\n");
+
+	result_free(&base);
+	return regressions;
+}
+
+static void on_signal(void *data, int signal_number) {
+	(void) signal_number;
+	struct bench_context *ctx = data;
+	atomic_store(&ctx->should_stop, true);
+	pw_main_loop_quit(ctx->loop);
+}
+
+static void on_duration_timeout(void *data, uint64_t expirations) {
+	(void) expirations;
+	struct bench_context *ctx = data;
+	atomic_store(&ctx->should_stop, true);
+	pw_main_loop_quit(ctx->loop);
+}
+
+/*
+ * one ramp step per progress tick: an xrun (interval above threshold_3 or
+ * a stream error) during the step ends the ramp, and the load of the
+ * previous step is the maximum sustainable one. The first tick with
+ * callbacks only takes the xrun count, so start-up xruns do not count
+ * against the base load.
+ */
+static void load_ramp_step(struct bench_context *ctx) {
+	const struct bench_config *cfg = &ctx->config;
+	uint64_t callbacks = 0, xruns = 0;
+
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		struct bench_stream *bs = &ctx->streams[i];
+		struct stats_view v;
+
+		snapshot_read(&bs->snapshot, &v);
+		callbacks += v.callback_count;
+		xruns += v.over_threshold_3 + bs->state_errors;
+	}
+	if (ctx->ramp_done || callbacks == 0)
+		return;
+
+	if (!ctx->ramp_started) {
+		ctx->ramp_started = true;
+		ctx->ramp_xruns = xruns;
+		return;
+	}
+	if (xruns > ctx->ramp_xruns) {
+		ctx->ramp_done = true;
+		ctx->ramp_limit_found = true;
+		ctx->ramp_limit_pct = ctx->ramp_load_pct - cfg->ramp_step_pct;
+		if (ctx->ramp_limit_pct < cfg->load_pct)
+			ctx->ramp_limit_pct = -1.0;
+		atomic_store(&ctx->should_stop, true);
+		pw_main_loop_quit(ctx->loop);
+		return;
+	}
+	if (ctx->ramp_load_pct + cfg->ramp_step_pct > 100.0) {
+		ctx->ramp_done = true;
+		return;
+	}
+	ctx->ramp_load_pct += cfg->ramp_step_pct;
+	load_set(ctx, ctx->ramp_load_pct);
+	ctx->ramp_xruns = xruns;
+}
+
+struct live_row {
+	uint64_t callbacks;
+	uint64_t p99_ns;
+	uint64_t max_ns;
+	uint64_t xruns;
+	uint64_t errors;
+};
+
+/*
+ * the window shown is the one closed by the first callbacks after the
+ * previous tick, i.e. the last complete second; cumulative rows come from
+ * the same publications, so both are exact at live resolution
+ */
+static void live_collect(struct bench_context *ctx, struct live_row *win,
+			 struct live_row *all) {
+	static uint64_t win_hist[LIVE_BUCKETS], all_hist[LIVE_BUCKETS];
+	struct window_view v;
+
+	memset(win, 0, sizeof(*win));
+	memset(all, 0, sizeof(*all));
+	memset(win_hist, 0, sizeof(win_hist));
+	memset(all_hist, 0, sizeof(all_hist));
+
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		struct bench_stream *bs = &ctx->streams[i];
+		struct window_view *prev = &ctx->live_prev[i];
+		struct stats_view sv;
+
+		window_read(&bs->window, &v);
+		snapshot_read(&bs->snapshot, &sv);
+
+		if (v.closed_epoch != prev->closed_epoch) {
+			win->callbacks +=
+				v.callback_count - prev->callback_count;
+			win->xruns +=
+				v.over_threshold_3 - prev->over_threshold_3;
+			win->errors += v.errors - prev->errors;
+			if (v.max_ns > win->max_ns)
+				win->max_ns = v.max_ns;
+			for (uint32_t b = 0; b < LIVE_BUCKETS; b++)
+				win_hist[b] += v.hist[b] - prev->hist[b];
+		}
+		for (uint32_t b = 0; b < LIVE_BUCKETS; b++)
+			all_hist[b] += v.hist[b];
+
+		all->callbacks += v.callback_count;
+		all->xruns += sv.over_threshold_3;
+		all->errors += sv.dequeue_fail + sv.null_buffer;
+		if (sv.max_ns > all->max_ns)
+			all->max_ns = sv.max_ns;
+
+		*prev = v;
+		atomic_fetch_add_explicit(&bs->window.epoch, 1,
+					  memory_order_relaxed);
+	}
+
+	win->p99_ns = loglin_value_at_percentile(
+		win_hist, LIVE_BUCKETS, LIVE_SUB_BITS, win->callbacks, 99.0);
+	all->p99_ns = loglin_value_at_percentile(
+		all_hist, LIVE_BUCKETS, LIVE_SUB_BITS, all->callbacks, 99.0);
+}
+
+static void live_write(FILE *f, double elapsed_s, const struct live_row *win,
+		       const struct live_row *all) {
+	fprintf(f, "%.1f,%lu,%.2f,%.2f,%lu,%lu,%lu,%.2f,%.2f,%lu,%lu\n",
+		elapsed_s, (unsigned long) win->callbacks,
+		win->p99_ns / 1000.0, win->max_ns / 1000.0,
+		(unsigned long) win->xruns, (unsigned long) win->errors,
+		(unsigned long) all->callbacks, all->p99_ns / 1000.0,
+		all->max_ns / 1000.0, (unsigned long) all->xruns,
+		(unsigned long) all->errors);
+	fflush(f);
+}
+
+static int live_open(struct bench_context *ctx) {
+	const char *path = ctx->config.live_path;
+
+	ctx->live_prev = calloc(ctx->n_streams, sizeof(*ctx->live_prev));
+	if (!ctx->live_prev)
+		return -ENOMEM;
+	if (path == NULL)
+		return 0;
+
+	/* appended, so every step of a sweep lands in the same file */
+	ctx->live_file = strcmp(path, "-") == 0 ? stdout : fopen(path, "a");
+	if (!ctx->live_file)
+		return -errno;
+	if (ctx->live_file == stdout || ftell(ctx->live_file) == 0)
+		fprintf(ctx->live_file,
+			"elapsed_s,callbacks,p99_us,max_us,xruns,errors,"
+			"total_callbacks,total_p99_us,total_max_us,"
+			"total_xruns,total_errors\n");
+	return 0;
+}
+
+static void live_close(struct bench_context *ctx) {
+	if (ctx->live_file && ctx->live_file != stdout)
+		fclose(ctx->live_file);
+	ctx->live_file = NULL;
+	free(ctx->live_prev);
+	ctx->live_prev = NULL;
+}
+
+/* stdout belongs to -L - rows or the -o json document otherwise */
+static bool progress_shown(const struct bench_context *ctx) {
+	return ctx->live_file != stdout && !ctx->config.json;
+}
+
+static void on_progress_tick(void *data, uint64_t expirations) {
+	(void) expirations;
+	struct bench_context *ctx = data;
+
+	if (ctx->config.ramp_step_pct > 0)
+		load_ramp_step(ctx);
+
+	uint64_t now = now_ns();
+	uint64_t elapsed_ns = now - ctx->run_start_ns;
+	uint64_t total_ns = (uint64_t) ctx->config.duration_sec * 1000000000ULL;
 	uint64_t remaining_ns =
 		elapsed_ns < total_ns ? total_ns - elapsed_ns : 0;
 	int remaining_sec = (int) (remaining_ns / 1000000000ULL);
 
-	printf("\rremaining: %*d s", ctx->remaining_width, remaining_sec);
-	fflush(stdout);
+	struct live_row win, all;
+	live_collect(ctx, &win, &all);
+
+	if (ctx->live_file)
+		live_write(ctx->live_file, elapsed_ns / 1e9, &win, &all);
+	if (!progress_shown(ctx))
+		return;
+
+	printf("\rremaining: %*d s | 1 s: p99 %7.1f us, max %7.1f us | "
+	       "xruns %lu/%lu",
+	       ctx->remaining_width, remaining_sec, win.p99_ns / 1000.0,
+	       win.max_ns / 1000.0, (unsigned long) win.xruns,
+	       (unsigned long) all.xruns);
+	if (all.errors > 0)
+		printf(", errors %lu/%lu", (unsigned long) win.errors,
+		       (unsigned long) all.errors);
+	fflush(stdout);
+}
+
+/* the kernel samples first, so the history covers every queued window */
+static void sched_drain(struct bench_context *ctx) {
+	sched_trace_poll(ctx->sched);
+
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		struct bench_stream *bs = &ctx->streams[i];
+		unsigned int tail = atomic_load_explicit(&bs->late_tail,
+							 memory_order_relaxed);
+		unsigned int head = atomic_load_explicit(&bs->late_head,
+							 memory_order_acquire);
+		char label[32];
+
+		snprintf(label, sizeof(label), "%s %u", stream_dir_name(bs),
+			 bs->index);
+		for (; tail != head; tail++)
+			sched_trace_explain(ctx->sched,
+					    &bs->late_queue[tail % LATE_QUEUE],
+					    label);
+		atomic_store_explicit(&bs->late_tail, tail,
+				      memory_order_release);
+	}
+}
+
+static void on_sched_drain(void *data, uint64_t expirations) {
+	(void) expirations;
+	sched_drain(data);
+}
+
+static void driver_set_timer(struct driver_timer *d, uint64_t time_ns) {
+	struct timespec ts = {
+		.tv_sec = (time_t) (time_ns / SPA_NSEC_PER_SEC),
+		.tv_nsec = (long) (time_ns % SPA_NSEC_PER_SEC),
+	};
+
+	/* an absolute zero disarms */
+	pw_loop_update_timer(d->loop, d->source, &ts, NULL, true);
+}
+
+static void on_driver_timer(void *data, uint64_t expirations) {
+	(void) expirations;
+	struct driver_timer *d = data;
+	struct spa_io_position *pos = d->position;
+	uint64_t now = now_ns();
+	uint64_t wake = now > d->next_ns ? now - d->next_ns : 0;
+	uint64_t missed = wake / d->period_ns;
+
+	d->ticks++;
+	d->wake_sum_ns += wake;
+	if (wake > d->wake_max_ns)
+		d->wake_max_ns = wake;
+	d->wake_hist[live_index(wake)]++;
+	d->missed += missed;
+	d->frames += missed * d->duration;
+
+	/* the server's quantum and rate decisions reach the driver as the
+	 * clock targets */
+	if (pos && pos->clock.target_rate.denom > 0 &&
+	    pos->clock.target_duration > 0) {
+		d->rate = pos->clock.target_rate.denom;
+		d->duration = (uint32_t) pos->clock.target_duration;
+		d->period_ns = d->duration * SPA_NSEC_PER_SEC / d->rate;
+	}
+	d->next_ns += (missed + 1) * d->period_ns;
+
+	if (!pw_stream_is_driving(d->stream->stream)) {
+		d->not_driving++;
+	} else {
+		if (pos) {
+			pos->clock.nsec = now;
+			pos->clock.rate = SPA_FRACTION(1, d->rate);
+			pos->clock.position = d->frames;
+			pos->clock.duration = d->duration;
+			pos->clock.delay = 0;
+			pos->clock.rate_diff = 1.0;
+			pos->clock.next_nsec = d->next_ns;
+		}
+		pw_stream_trigger_process(d->stream->stream);
+	}
+	d->frames += d->duration;
+	driver_set_timer(d, d->next_ns);
+}
+
+static int do_driver_arm(struct spa_loop *loop, bool async, uint32_t seq,
+			 const void *data, size_t size, void *user_data) {
+	(void) loop;
+	(void) async;
+	(void) seq;
+	(void) size;
+	struct driver_timer *d = user_data;
+
+	if (*(const bool *) data) {
+		d->next_ns = now_ns() + d->period_ns;
+		driver_set_timer(d, d->next_ns);
+	} else {
+		driver_set_timer(d, 0);
+	}
+	return 0;
+}
+
+/* the timer belongs to the data loop, so it is (dis)armed there */
+static void driver_arm(struct driver_timer *d, bool start) {
+	if (d && d->source)
+		pw_loop_invoke(d->loop, do_driver_arm, 0, &start, sizeof(start),
+			       true, d);
+}
+
+static void on_io_changed(void *data, uint32_t id, void *area,
+			  uint32_t size) {
+	(void) size;
+	struct bench_stream *bs = data;
+	struct driver_timer *d = bs->ctx->driver;
+
+	if (id != SPA_IO_Position)
+		return;
+	/* the server assigns it before the node is scheduled, and like
+	 * pw_stream itself the data thread reads it without a handoff */
+	bs->position = area;
+	if (d && d->stream == bs)
+		d->position = area;
 }
 
 static void on_stream_state_changed(void *data, enum pw_stream_state old,
 				    enum pw_stream_state state,
 				    const char *error) {
 	(void) old;
-	struct bench_context *ctx = data;
+	struct bench_stream *bs = data;
+
+	if (state == PW_STREAM_STATE_STREAMING)
+		bs->node_id = pw_stream_get_node_id(bs->stream);
+
+	struct driver_timer *d = bs->ctx->driver;
+	if (d && d->stream == bs && (state == PW_STREAM_STATE_STREAMING ||
+				     old == PW_STREAM_STATE_STREAMING))
+		driver_arm(d, state == PW_STREAM_STATE_STREAMING);
 
 	if (state == PW_STREAM_STATE_ERROR) {
-		atomic_fetch_add(&ctx->stats.state_errors, 1);
-		fprintf(stderr, "stream error: %s\n",
+		bs->state_errors++;
+		fprintf(stderr, "stream %s %u error: %s\n",
+			stream_dir_name(bs), bs->index,
 			error ? error : "unknown");
-		pw_main_loop_quit(ctx->loop);
+		pw_main_loop_quit(bs->ctx->loop);
 	}
 }
 
+/* buffers are negotiated after the format, so the request goes out from
+ * on_param_changed(); fields left at 0 stay PipeWire's choice */
+static void stream_update_buffers(struct bench_stream *bs, uint32_t format) {
+	const struct bench_config *cfg = &bs->ctx->config;
+	const struct format_desc *fd = format_desc_for(format);
+	uint32_t stride = format_stride(format, cfg->channels);
+	/* planar formats carry one block per channel */
+	uint32_t blocks = fd && fd->planar ? cfg->channels : 1;
+	uint8_t buffer[256];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod_frame f;
+	const struct spa_pod *params[1];
+
+	if (cfg->n_buffers == 0 && cfg->buffer_size == 0 &&
+	    cfg->buffer_align == 0 && cfg->data_types == 0)
+		return;
+
+	spa_pod_builder_push_object(&b, &f, SPA_TYPE_OBJECT_ParamBuffers,
+				    SPA_PARAM_Buffers);
+	if (cfg->n_buffers > 0)
+		spa_pod_builder_add(&b, SPA_PARAM_BUFFERS_buffers,
+				    SPA_POD_Int((int) cfg->n_buffers), 0);
+	if (cfg->buffer_size > 0)
+		spa_pod_builder_add(&b, SPA_PARAM_BUFFERS_blocks,
+				    SPA_POD_Int((int) blocks),
+				    SPA_PARAM_BUFFERS_size,
+				    SPA_POD_Int((int) cfg->buffer_size),
+				    SPA_PARAM_BUFFERS_stride,
+				    SPA_POD_Int((int) stride), 0);
+	if (cfg->buffer_align > 0)
+		spa_pod_builder_add(&b, SPA_PARAM_BUFFERS_align,
+				    SPA_POD_Int((int) cfg->buffer_align), 0);
+	if (cfg->data_types != 0)
+		spa_pod_builder_add(&b, SPA_PARAM_BUFFERS_dataType,
+				    SPA_POD_CHOICE_FLAGS_Int(
+					    (int) cfg->data_types),
+				    0);
+	params[0] = spa_pod_builder_pop(&b, &f);
+
+	if (pw_stream_update_params(bs->stream, params, 1) < 0)
+		fprintf(stderr, "warning: stream %s %u: buffer request "
+				"rejected\n",
+			stream_dir_name(bs), bs->index);
+}
+
 static void on_param_changed(void *data, uint32_t id,
 			     const struct spa_pod *param) {
-	struct bench_context *ctx = data;
+	struct bench_stream *bs = data;
 
 	if (param == NULL)
 		return;
@@ -365,132 +2474,964 @@ static void on_param_changed(void *data, uint32_t id,
 	if (id == SPA_PARAM_Format) {
 		struct spa_audio_info_raw info;
 		if (spa_format_audio_raw_parse(param, &info) >= 0) {
-			atomic_store(&ctx->stats.actual_rate, info.rate);
-			atomic_store(&ctx->stats.actual_format, info.format);
+			atomic_store(&bs->actual_rate, info.rate);
+			atomic_store(&bs->actual_format, info.format);
+			stream_update_buffers(bs, info.format);
 		}
 	}
 }
 
-static void on_process(void *data) {
-	struct bench_context *ctx = data;
-	struct bench_config *cfg = &ctx->config;
-	struct rt_stats *s = &ctx->stats;
+static void on_add_buffer(void *data, struct pw_buffer *b) {
+	struct bench_stream *bs = data;
+	struct buffer_layout *l = &bs->layout;
+	struct spa_buffer *buf = b->buffer;
 
-	uint64_t now = now_ns();
+	if (l->live++ == 0) {
+		l->sets++;
+		l->count = 0;
+		l->align = 0;
+	}
+	l->count++;
+	l->datas = buf->n_datas;
+	if (buf->n_datas == 0)
+		return;
 
-	struct pw_buffer *b = pw_stream_dequeue_buffer(ctx->stream);
-	if (b == NULL) {
-		atomic_fetch_add(&s->dequeue_fail, 1);
-		goto record;
+	struct spa_data *d = &buf->datas[0];
+	l->type = d->type;
+	l->maxsize = d->maxsize;
+	l->mapped = d->data != NULL;
+	if (d->data) {
+		uintptr_t p = (uintptr_t) d->data;
+		uint32_t align = (uint32_t) SPA_MIN(p & -p, (uintptr_t) 4096);
+
+		if (l->align == 0 || align < l->align)
+			l->align = align;
 	}
+}
 
-	struct spa_buffer *buf = b->buffer;
-	if (buf->datas[0].data == NULL) {
-		atomic_fetch_add(&s->null_buffer, 1);
-		pw_stream_queue_buffer(ctx->stream, b);
-		goto record;
+static void on_remove_buffer(void *data, struct pw_buffer *b) {
+	(void) b;
+	struct bench_stream *bs = data;
+
+	if (bs->layout.live > 0)
+		bs->layout.live--;
+}
+
+static void tone_check_init(struct tone_check *t, uint32_t rate,
+			    double freq) {
+	memset(t, 0, sizeof(*t));
+	t->coeff = (float) (2.0 * cos(2.0 * M_PI * freq / (double) rate));
+	/* about 20 ms to fall by 1/e */
+	t->decay = (float) exp(-1.0 / (0.02 * rate));
+}
+
+static float sample_to_float(const void *data, const struct format_desc *fd,
+			     uint32_t idx) {
+	const uint8_t *p = (const uint8_t *) data + (size_t) idx * fd->size;
+	union {
+		uint8_t b[8];
+		int8_t s8;
+		int16_t s16;
+		uint16_t u16;
+		int32_t s32;
+		uint32_t u32;
+		float f32;
+		double f64;
+	} v;
+
+	for (uint32_t i = 0; i < fd->size; i++)
+		v.b[fd->swap ? fd->size - 1 - i : i] = p[i];
+
+	switch (fd->kind) {
+	case SYNTH_F32:
+		return v.f32;
+	case SYNTH_F64:
+		return (float) v.f64;
+	case SYNTH_S8:
+		return v.s8 / 128.0f;
+	case SYNTH_U8:
+		return ((int) v.b[0] - 0x80) / 128.0f;
+	case SYNTH_S16:
+		return v.s16 / 32768.0f;
+	case SYNTH_U16:
+		return ((int32_t) v.u16 - 0x8000) / 32768.0f;
+	case SYNTH_S24_32:
+		/* only the low 24 bits count */
+		return (int32_t) (v.u32 << 8) / 2147483648.0f;
+	case SYNTH_U24_32:
+		return ((int32_t) (v.u32 & 0xffffff) - 0x800000) / 8388608.0f;
+	case SYNTH_S32:
+		return v.s32 / 2147483648.0f;
+	case SYNTH_U32:
+		return (int32_t) (v.u32 ^ 0x80000000u) / 2147483648.0f;
+	case SYNTH_S24:
+	case SYNTH_U24: {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		uint32_t u = (uint32_t) v.b[0] << 24 | (uint32_t) v.b[1] << 16 |
+			     (uint32_t) v.b[2] << 8;
+#else
+		uint32_t u = (uint32_t) v.b[2] << 24 | (uint32_t) v.b[1] << 16 |
+			     (uint32_t) v.b[0] << 8;
+#endif
+		if (fd->kind == SYNTH_U24)
+			u ^= 0x80000000u;
+		return (int32_t) u / 2147483648.0f;
 	}
+	}
+	return 0.0f;
+}
 
-	uint32_t format = atomic_load(&s->actual_format);
-	if (format == 0)
-		format = cfg->format;
+/* checks channel 0 of n_frames interleaved frames; history carries over
+ * between buffers, which is where a lost cycle shows up */
+static void tone_check_run(struct tone_check *t, struct rt_stats *s,
+			   const void *data, const struct format_desc *fd,
+			   uint32_t n_frames, uint32_t channels) {
+	bool silent = true;
 
-	uint32_t sample_size = format_sample_size(format);
-	if (sample_size == 0)
-		sample_size = sizeof(float);
+	for (uint32_t i = 0; i < n_frames; i++) {
+		float x = sample_to_float(data, fd, i * channels);
+		float mag = fabsf(x);
 
-	uint32_t stride = sample_size * cfg->channels;
-	uint32_t max_frames = buf->datas[0].maxsize / stride;
-	uint32_t n_frames = max_frames;
-	if (b->requested > 0 && b->requested < n_frames)
-		n_frames = (uint32_t) b->requested;
+		t->envelope = mag > t->envelope ? mag : t->envelope * t->decay;
+		if (t->envelope < TONE_FLOOR) {
+			t->primed = 0;
+			continue;
+		}
+		silent = false;
 
-	switch (format) {
-	case SPA_AUDIO_FORMAT_S16_LE:
-	case SPA_AUDIO_FORMAT_S16_BE:
-		synth_fill_s16(&ctx->synth, buf->datas[0].data, n_frames,
-			       cfg->channels);
-		break;
-	default:
-		synth_fill_f32(&ctx->synth, buf->datas[0].data, n_frames,
-			       cfg->channels);
-		break;
+		if (t->primed >= 2) {
+			float r = x - t->coeff * t->x1 + t->x2;
+			bool bad = fabsf(r) > TONE_TOLERANCE * t->envelope;
+
+			if (t->holdoff > 0) {
+				t->holdoff--;
+			} else if (bad && t->primed >= TONE_LOCK) {
+				s->discontinuities++;
+				t->holdoff = 2;
+			} else if (bad) {
+				/* noise or another signal: not locked */
+				t->primed = 2;
+			} else if (t->primed < TONE_LOCK) {
+				t->primed++;
+			}
+			if (t->primed >= TONE_LOCK)
+				s->tone_frames++;
+		} else {
+			t->primed++;
+		}
+		t->x2 = t->x1;
+		t->x1 = x;
+	}
+
+	s->capture_frames += n_frames;
+	if (silent)
+		s->silent_buffers++;
+}
+
+static void stats_record_align(struct rt_stats *s, int64_t offset_ns) {
+	if (s->align_count == 0 || offset_ns < s->align_min_ns)
+		s->align_min_ns = offset_ns;
+	if (s->align_count == 0 || offset_ns > s->align_max_ns)
+		s->align_max_ns = offset_ns;
+	s->align_count++;
+	s->align_sum_ns += offset_ns;
+	s->align_hdr[hdr_index((uint64_t) llabs(offset_ns))]++;
+}
+
+/* publish this callback's cycle and, when the peer already ran in the
+ * same graph cycle, record the offset between the two entries */
+static void stream_align(struct bench_stream *bs, uint64_t graph_ns,
+			 uint64_t now) {
+	struct bench_stream *peer = bs->peer;
+	struct bench_stream *out =
+		bs->direction == PW_DIRECTION_OUTPUT ? bs : peer;
+
+	atomic_store_explicit(&bs->cycle_graph_ns, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&bs->cycle_entry_ns, now, memory_order_relaxed);
+	atomic_store_explicit(&bs->cycle_graph_ns, graph_ns,
+			      memory_order_release);
+
+	uint64_t g1 = atomic_load_explicit(&peer->cycle_graph_ns,
+					   memory_order_acquire);
+	uint64_t peer_entry = atomic_load_explicit(&peer->cycle_entry_ns,
+						   memory_order_relaxed);
+	atomic_thread_fence(memory_order_acquire);
+	uint64_t g2 = atomic_load_explicit(&peer->cycle_graph_ns,
+					   memory_order_relaxed);
+	if (g1 != graph_ns || g2 != graph_ns)
+		return;
+
+	/* both streams may see the match; only one records it */
+	uint64_t seen = atomic_load(&out->aligned_graph_ns);
+	if (seen == graph_ns ||
+	    !atomic_compare_exchange_strong(&out->aligned_graph_ns, &seen,
+					    graph_ns))
+		return;
+
+	int64_t offset = (int64_t) now - (int64_t) peer_entry;
+	if (bs->direction == PW_DIRECTION_OUTPUT)
+		offset = -offset;
+	stats_record_align(&bs->stats, offset);
+}
+
+/* burn the synthetic load; returns the callback entry time */
+static uint64_t stream_begin(struct bench_stream *bs) {
+	uint64_t now = now_ns();
+	uint64_t load_ns =
+		atomic_load_explicit(&bs->ctx->load_ns, memory_order_relaxed);
+
+	if (load_ns > 0)
+		load_burn(now + load_ns);
+	return now;
+}
+
+/* what the process callback saw, for the trace */
+struct cycle_info {
+	uint32_t requested;
+	uint32_t size;
+	uint32_t flags;
+};
+
+/* plain stores into the pre-faulted mapping, no syscall */
+static void trace_append(struct bench_stream *bs, uint64_t now,
+			 uint64_t interval, uint64_t busy,
+			 const struct cycle_info *ci, const struct pw_time *t,
+			 uint32_t flags) {
+	struct trace_stream *ts = bs->trace_info;
+
+	if (ts->count == bs->trace_capacity) {
+		ts->dropped++;
+		return;
+	}
+
+	struct trace_record *r = &bs->trace[ts->count];
+	r->time_ns = now;
+	r->interval_ns = interval;
+	r->busy_ns = busy > UINT32_MAX ? UINT32_MAX : (uint32_t) busy;
+	r->requested = ci->requested;
+	r->size = ci->size;
+	r->flags = ci->flags | flags;
+	r->graph_ns = t->now;
+	r->ticks = t->ticks;
+	r->delay = t->delay;
+	r->queued = t->queued;
+	r->rate_num = t->rate.num;
+	r->rate_denom = t->rate.denom;
+	ts->count++;
+}
+
+/* no syscall once the thread id is known: sched_getcpu() is a vDSO
+ * call */
+static void late_push(struct bench_stream *bs, uint64_t now,
+		      uint64_t interval) {
+	unsigned int head =
+		atomic_load_explicit(&bs->late_head, memory_order_relaxed);
+	unsigned int tail =
+		atomic_load_explicit(&bs->late_tail, memory_order_acquire);
+
+	if (head - tail == LATE_QUEUE) {
+		bs->late_dropped++;
+		return;
 	}
+	if (bs->rt_tid == 0)
+		bs->rt_tid = (int32_t) syscall(SYS_gettid);
 
-	buf->datas[0].chunk->offset = 0;
-	buf->datas[0].chunk->stride = stride;
-	buf->datas[0].chunk->size = n_frames * stride;
-	pw_stream_queue_buffer(ctx->stream, b);
+	struct sched_late *l = &bs->late_queue[head % LATE_QUEUE];
+	l->time_ns = now;
+	l->interval_ns = interval;
+	l->cpu = sched_getcpu();
+	l->tid = bs->rt_tid;
+	atomic_store_explicit(&bs->late_head, head + 1, memory_order_release);
+}
+
+static void stream_record(struct bench_stream *bs, uint64_t now,
+			  const struct cycle_info *ci) {
+	struct rt_stats *s = &bs->stats;
+	uint64_t done = now_ns();
 
-record: {
-	uint64_t last = atomic_exchange(&s->last_callback_ns, now);
+	stats_record_busy(s, done - now);
+
+	const struct bench_config *cfg = &bs->ctx->config;
+	uint64_t late_before = s->over_threshold_3;
+	uint64_t last = s->last_callback_ns;
+	uint64_t interval = 0;
+	s->last_callback_ns = now;
 	if (last != 0) {
-		uint64_t interval = now - last;
+		interval = now - last;
 		stats_record_interval(s, interval, cfg);
 	} else {
 		s->test_start_ns = now;
 	}
+
+	bool late = s->over_threshold_3 != late_before;
+	uint32_t flags = late ? TRACE_LATE : 0;
+	struct spa_io_position *pos = bs->position;
+	uint64_t duration = pos ? pos->clock.duration : 0;
+	if (duration > 0 && duration <= UINT32_MAX &&
+	    duration != atomic_load_explicit(&bs->actual_quantum,
+					     memory_order_relaxed))
+		atomic_store_explicit(&bs->actual_quantum, (uint32_t) duration,
+				      memory_order_relaxed);
+	struct pw_time t;
+	if (pw_stream_get_time_n(bs->stream, &t, sizeof(t)) < 0) {
+		s->time_unavailable++;
+		memset(&t, 0, sizeof(t));
+		flags |= TRACE_NO_TIME;
+	} else {
+		stats_record_time(s, &t, now, late, duration);
+		if (bs->peer && t.now > 0)
+			stream_align(bs, (uint64_t) t.now, now);
+	}
+	if (bs->trace)
+		trace_append(bs, now, interval, done - now, ci, &t, flags);
+	if (late && bs->ctx->sched)
+		late_push(bs, now, interval);
+	snapshot_publish(&bs->snapshot, s);
+
+	unsigned int epoch =
+		atomic_load_explicit(&bs->window.epoch, memory_order_relaxed);
+	if (epoch != s->win_epoch)
+		window_publish(&bs->window, s, epoch);
+
+	/* accounted in the next snapshot */
+	uint64_t cost = now_ns() - done;
+	s->record_sum_ns += cost;
+	if (cost > s->record_max_ns)
+		s->record_max_ns = cost;
+}
+
+/* the negotiated format, the requested one until it is known */
+static const struct format_desc *stream_format(struct bench_stream *bs) {
+	uint32_t format = atomic_load_explicit(&bs->actual_format,
+					       memory_order_relaxed);
+	const struct format_desc *fd =
+		format != 0 ? format_desc_for(format) : NULL;
+
+	/* validate_config() accepted the requested one */
+	return fd ? fd : format_desc_for(bs->ctx->config.format);
+}
+
+static void on_process(void *data) {
+	struct bench_stream *bs = data;
+	const struct bench_config *cfg = &bs->ctx->config;
+	struct rt_stats *s = &bs->stats;
+	struct cycle_info ci = {0};
+
+	uint64_t now = stream_begin(bs);
+
+	struct pw_buffer *b = pw_stream_dequeue_buffer(bs->stream);
+	if (b == NULL) {
+		s->dequeue_fail++;
+		ci.flags = TRACE_DEQUEUE_FAIL;
+		goto record;
+	}
+
+	ci.requested = (uint32_t) b->requested;
+	struct spa_buffer *buf = b->buffer;
+	const struct format_desc *fd = stream_format(bs);
+	uint32_t n_planes = fd->planar ? cfg->channels : 1;
+	uint32_t channels = fd->planar ? 1 : cfg->channels;
+	uint32_t stride = fd->size * channels;
+	uint32_t n_frames = UINT32_MAX;
+	void *planes[SPA_AUDIO_MAX_CHANNELS];
+	bool mapped = true;
+
+	if (buf->n_datas < n_planes)
+		goto null_buffer;
+	for (uint32_t p = 0; p < n_planes; p++) {
+		planes[p] = buf->datas[p].data;
+		mapped = mapped && planes[p] != NULL;
+		n_frames = SPA_MIN(n_frames, buf->datas[p].maxsize / stride);
+	}
+	if (!mapped && !cfg->no_map)
+		goto null_buffer;
+	if (b->requested > 0 && b->requested < n_frames)
+		n_frames = (uint32_t) b->requested;
+
+	/* -M: the memory is passed on without touching it */
+	if (mapped)
+		synth_fill(&bs->synth, fd, planes, n_planes, n_frames,
+			   channels);
+	else
+		s->unmapped++;
+
+	for (uint32_t p = 0; p < n_planes; p++) {
+		struct spa_chunk *chunk = buf->datas[p].chunk;
+
+		chunk->offset = 0;
+		chunk->stride = (int32_t) stride;
+		chunk->size = n_frames * stride;
+	}
+	ci.size = n_frames * stride * n_planes;
+	pw_stream_queue_buffer(bs->stream, b);
+	goto record;
+
+null_buffer:
+	s->null_buffer++;
+	ci.flags = TRACE_NULL_BUFFER;
+	pw_stream_queue_buffer(bs->stream, b);
+record:
+	stream_record(bs, now, &ci);
 }
+
+static void on_capture_process(void *data) {
+	struct bench_stream *bs = data;
+	const struct bench_config *cfg = &bs->ctx->config;
+	struct rt_stats *s = &bs->stats;
+	struct cycle_info ci = {.flags = TRACE_CAPTURE};
+
+	uint64_t now = stream_begin(bs);
+
+	struct pw_buffer *b = pw_stream_dequeue_buffer(bs->stream);
+	if (b == NULL) {
+		s->dequeue_fail++;
+		ci.flags |= TRACE_DEQUEUE_FAIL;
+		goto record;
+	}
+
+	ci.requested = (uint32_t) b->requested;
+	struct spa_data *d = &b->buffer->datas[0];
+	if (d->data == NULL && !cfg->no_map) {
+		s->null_buffer++;
+		ci.flags |= TRACE_NULL_BUFFER;
+		pw_stream_queue_buffer(bs->stream, b);
+		goto record;
+	}
+
+	/* channel 0 leads the interleaved data or has the first plane */
+	const struct format_desc *fd = stream_format(bs);
+	uint32_t channels = fd->planar ? 1 : cfg->channels;
+	uint32_t stride = fd->size * channels;
+	uint32_t offset = d->chunk->offset % d->maxsize;
+	uint32_t size = d->chunk->size;
+	if (size > d->maxsize - offset)
+		size = d->maxsize - offset;
+
+	if (d->data)
+		tone_check_run(&bs->tone, s, (const uint8_t *) d->data + offset,
+			       fd, size / stride, channels);
+	else
+		s->unmapped++;
+	ci.size = size * (fd->planar ? cfg->channels : 1);
+	pw_stream_queue_buffer(bs->stream, b);
+
+record:
+	stream_record(bs, now, &ci);
 }
 
 static const struct pw_stream_events stream_events = {
 	PW_VERSION_STREAM_EVENTS,
 	.state_changed = on_stream_state_changed,
+	.io_changed = on_io_changed,
 	.param_changed = on_param_changed,
+	.add_buffer = on_add_buffer,
+	.remove_buffer = on_remove_buffer,
 	.process = on_process,
 };
 
-static int stream_create(struct bench_context *ctx) {
-	char latency_str[64];
-	char force_quantum_str[64];
-	char force_rate_str[64];
+static const struct pw_stream_events capture_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = on_stream_state_changed,
+	.io_changed = on_io_changed,
+	.param_changed = on_param_changed,
+	.add_buffer = on_add_buffer,
+	.remove_buffer = on_remove_buffer,
+	.process = on_capture_process,
+};
+
+struct profiler_block {
+	uint32_t id;
+	const char *name;
+	int64_t prev_signal;
+	int64_t signal;
+	int64_t awake;
+	int64_t finish;
+	int32_t status;
+	struct spa_fraction latency;
+	int32_t xrun_count;
+};
+
+/* driverBlock and followerBlock share the layout; xrun_count was added
+ * later and stays -1 on older servers */
+static int parse_profiler_block(const struct spa_pod *pod,
+				struct profiler_block *b) {
+	memset(b, 0, sizeof(*b));
+	b->xrun_count = -1;
+	return spa_pod_parse_struct(
+		pod, SPA_POD_Int(&b->id), SPA_POD_String(&b->name),
+		SPA_POD_Long(&b->prev_signal), SPA_POD_Long(&b->signal),
+		SPA_POD_Long(&b->awake), SPA_POD_Long(&b->finish),
+		SPA_POD_Int(&b->status), SPA_POD_Fraction(&b->latency),
+		SPA_POD_OPT_Int(&b->xrun_count));
+}
+
+static int parse_profiler_info(const struct spa_pod *pod,
+			       int32_t *xrun_count) {
+	int64_t counter;
+	float load_fast, load_medium, load_slow;
+
+	return spa_pod_parse_struct(pod, SPA_POD_Long(&counter),
+				    SPA_POD_Float(&load_fast),
+				    SPA_POD_Float(&load_medium),
+				    SPA_POD_Float(&load_slow),
+				    SPA_POD_Int(xrun_count));
+}
+
+static struct graph_node *graph_node_get(struct graph_monitor *m,
+					 const struct profiler_block *b) {
+	for (uint32_t i = 0; i < m->n_nodes; i++) {
+		if (m->nodes[i].id == b->id)
+			return &m->nodes[i];
+	}
+	if (m->n_nodes == MAX_GRAPH_NODES)
+		return NULL;
+
+	struct graph_node *n = &m->nodes[m->n_nodes++];
+	n->id = b->id;
+	snprintf(n->name, sizeof(n->name), "%s", b->name ? b->name : "");
+	n->xrun_count = -1;
+	return n;
+}
+
+/* returns how many xruns the node's own counter gained */
+static uint64_t graph_node_update(struct graph_node *n,
+				  const struct profiler_block *b) {
+	uint64_t gained = 0;
+
+	if (n == NULL || b->xrun_count < 0)
+		return 0;
+	if (n->xrun_count >= 0 && b->xrun_count > n->xrun_count)
+		gained = (uint64_t) (b->xrun_count - n->xrun_count);
+	n->xrun_count = b->xrun_count;
+	return gained;
+}
+
+static void monitor_record_own(struct graph_monitor *m,
+			       const struct profiler_block *b) {
+	if (b->signal <= 0 || b->awake < b->signal)
+		return;
+
+	uint64_t wake = (uint64_t) (b->awake - b->signal);
+	m->own_count++;
+	m->own_wake_sum_ns += wake;
+	if (wake > m->own_wake_max_ns)
+		m->own_wake_max_ns = wake;
+	if (b->finish >= b->awake &&
+	    (uint64_t) (b->finish - b->awake) > m->own_busy_max_ns)
+		m->own_busy_max_ns = (uint64_t) (b->finish - b->awake);
+	if (b->status != PROFILER_STATUS_FINISHED)
+		m->own_unfinished++;
+}
+
+/*
+ * one profiler object is one driver cycle. A rise of the driver's xrun
+ * counter is blamed on the followers whose own counter rose, else on
+ * those that had not finished, else on the slowest one.
+ */
+static void monitor_cycle(struct bench_context *ctx,
+			  const struct spa_pod_object *o) {
+	struct graph_monitor *m = &ctx->monitor;
+	struct profiler_block driver, followers[MAX_GRAPH_NODES];
+	uint32_t n_followers = 0;
+	int32_t xrun_count = -1;
+	bool have_driver = false, ours = false;
+	struct spa_pod_prop *p;
+
+	SPA_POD_OBJECT_FOREACH(o, p) {
+		switch (p->key) {
+		case SPA_PROFILER_info:
+			if (parse_profiler_info(&p->value, &xrun_count) < 0)
+				xrun_count = -1;
+			break;
+		case SPA_PROFILER_driverBlock:
+			have_driver =
+				parse_profiler_block(&p->value, &driver) >= 0;
+			break;
+		case SPA_PROFILER_followerBlock:
+			if (n_followers < MAX_GRAPH_NODES &&
+			    parse_profiler_block(&p->value,
+						 &followers[n_followers]) >= 0)
+				n_followers++;
+			break;
+		default:
+			break;
+		}
+	}
+	if (!have_driver)
+		return;
+
+	ours = is_own_node(ctx, driver.id);
+	for (uint32_t i = 0; i < n_followers; i++) {
+		if (is_own_node(ctx, followers[i].id)) {
+			monitor_record_own(m, &followers[i]);
+			ours = true;
+		}
+	}
+	if (!ours)
+		return;
+
+	m->cycles++;
+	if (m->driver_id != driver.id) {
+		m->driver_id = driver.id;
+		snprintf(m->driver_name, sizeof(m->driver_name), "%s",
+			 driver.name ? driver.name : "");
+		/* a new driver has its own counter */
+		m->driver_xrun_count = -1;
+	}
+
+	uint64_t xruns = 0;
+	if (xrun_count >= 0) {
+		if (m->driver_xrun_count >= 0 &&
+		    xrun_count > m->driver_xrun_count)
+			xruns = (uint64_t) (xrun_count - m->driver_xrun_count);
+		m->driver_xrun_count = xrun_count;
+	}
+
+	uint64_t blamed = 0;
+	for (uint32_t i = 0; i < n_followers; i++) {
+		struct graph_node *n = graph_node_get(m, &followers[i]);
+		uint64_t gained = graph_node_update(n, &followers[i]);
+
+		if (gained > 0 && xruns > 0) {
+			n->late += gained;
+			blamed += gained;
+		}
+	}
+	if (xruns == 0)
+		return;
+	m->xruns += xruns;
+	if (blamed > 0)
+		return;
+
+	const struct profiler_block *slowest = n_followers > 0 ? NULL : &driver;
+	for (uint32_t i = 0; i < n_followers; i++) {
+		const struct profiler_block *f = &followers[i];
+
+		if (f->status != PROFILER_STATUS_FINISHED) {
+			struct graph_node *n = graph_node_get(m, f);
+			if (n)
+				n->late++;
+			blamed++;
+		}
+		if (slowest == NULL ||
+		    f->finish - f->signal > slowest->finish - slowest->signal)
+			slowest = f;
+	}
+	if (blamed == 0) {
+		struct graph_node *n = graph_node_get(m, slowest);
+		if (n)
+			n->late++;
+	}
+}
+
+static void on_profile(void *data, const struct spa_pod *pod) {
+	struct bench_context *ctx = data;
+	struct spa_pod *o;
+
+	if (!spa_pod_is_struct(pod))
+		return;
+
+	SPA_POD_STRUCT_FOREACH(pod, o) {
+		if (spa_pod_is_object_type(o, SPA_TYPE_OBJECT_Profiler))
+			monitor_cycle(ctx, (const struct spa_pod_object *) o);
+	}
+}
+
+static const struct pw_profiler_events profiler_events = {
+	PW_VERSION_PROFILER_EVENTS,
+	.profile = on_profile,
+};
+
+static void on_registry_global(void *data, uint32_t id, uint32_t permissions,
+			       const char *type, uint32_t version,
+			       const struct spa_dict *props) {
+	(void) permissions;
+	(void) version;
+	(void) props;
+	struct bench_context *ctx = data;
+	struct graph_monitor *m = &ctx->monitor;
+
+	if (m->profiler || strcmp(type, PW_TYPE_INTERFACE_Profiler) != 0)
+		return;
+
+	m->profiler = pw_registry_bind(m->registry, id, type,
+				       PW_VERSION_PROFILER, 0);
+	if (m->profiler)
+		pw_profiler_add_listener(m->profiler, &m->profiler_listener,
+					 &profiler_events, ctx);
+}
+
+static const struct pw_registry_events registry_events = {
+	PW_VERSION_REGISTRY_EVENTS,
+	.global = on_registry_global,
+};
+
+/* a connection of its own: the streams each bring their own context */
+static int monitor_init(struct bench_context *ctx) {
+	struct graph_monitor *m = &ctx->monitor;
+
+	m->driver_xrun_count = -1;
+	m->context = pw_context_new(pw_main_loop_get_loop(ctx->loop), NULL, 0);
+	if (!m->context)
+		return -errno;
+
+	m->core = pw_context_connect(m->context, NULL, 0);
+	if (!m->core)
+		return -errno;
+
+	m->registry = pw_core_get_registry(m->core, PW_VERSION_REGISTRY, 0);
+	if (!m->registry)
+		return -errno;
+
+	pw_registry_add_listener(m->registry, &m->registry_listener,
+				 &registry_events, ctx);
+	return 0;
+}
+
+static void monitor_fini(struct graph_monitor *m) {
+	if (m->profiler) {
+		spa_hook_remove(&m->profiler_listener);
+		pw_proxy_destroy((struct pw_proxy *) m->profiler);
+		m->profiler = NULL;
+	}
+	if (m->registry) {
+		spa_hook_remove(&m->registry_listener);
+		pw_proxy_destroy((struct pw_proxy *) m->registry);
+		m->registry = NULL;
+	}
+	if (m->core) {
+		pw_core_disconnect(m->core);
+		m->core = NULL;
+	}
+	if (m->context) {
+		pw_context_destroy(m->context);
+		m->context = NULL;
+	}
+}
+
+static int stream_create(struct bench_context *ctx, struct bench_stream *bs) {
+	bool playback = bs->direction == PW_DIRECTION_OUTPUT;
+	char node_name[64];
+	char latency_str[64];
+	char force_quantum_str[64];
+	char force_rate_str[64];
+
+	snprintf(latency_str, sizeof(latency_str), "%u/%u", ctx->config.quantum,
+		 ctx->config.rate);
+	snprintf(force_quantum_str, sizeof(force_quantum_str), "%u",
+		 ctx->config.quantum);
+	snprintf(force_rate_str, sizeof(force_rate_str), "%u",
+		 ctx->config.rate);
+	if (ctx->n_streams == 1)
+		snprintf(node_name, sizeof(node_name), "pipewire-xrun");
+	else
+		snprintf(node_name, sizeof(node_name), "pipewire-xrun-%s-%u",
+			 stream_dir_name(bs), bs->index);
+
+	struct pw_properties *props = pw_properties_new(
+		PW_KEY_MEDIA_TYPE, "Audio", PW_KEY_MEDIA_CATEGORY,
+		playback ? "Playback" : "Capture", PW_KEY_MEDIA_ROLE, "Music",
+		PW_KEY_NODE_NAME, node_name, PW_KEY_NODE_LATENCY, latency_str,
+		PW_KEY_NODE_FORCE_QUANTUM, force_quantum_str,
+		PW_KEY_NODE_FORCE_RATE, force_rate_str, NULL);
+
+	/* duplex records the monitor of the sink we play to, so the tone
+	 * and both callbacks share one graph */
+	if (!playback && ctx->config.mode == MODE_DUPLEX)
+		pw_properties_set(props, PW_KEY_STREAM_CAPTURE_SINK, "true");
+
+	/* -D: no links, so the group keeps the unlinked streams scheduled
+	 * together under the driver stream */
+	enum pw_stream_flags flags = PW_STREAM_FLAG_RT_PROCESS;
+	if (!ctx->config.no_map)
+		flags |= PW_STREAM_FLAG_MAP_BUFFERS;
+	if (ctx->config.driver) {
+		pw_properties_setf(props, PW_KEY_NODE_GROUP, "pipewire-xrun-%d",
+				   (int) getpid());
+		pw_properties_set(props, PW_KEY_NODE_ALWAYS_PROCESS, "true");
+		if (bs == &ctx->streams[0])
+			flags |= PW_STREAM_FLAG_DRIVER;
+	} else {
+		flags |= PW_STREAM_FLAG_AUTOCONNECT;
+	}
+
+	/* a separate simple stream per node, so every stream is its own
+	 * client and graph node just like independent applications */
+	bs->stream = pw_stream_new_simple(
+		pw_main_loop_get_loop(ctx->loop), node_name, props,
+		playback ? &stream_events : &capture_events, bs);
+
+	if (!bs->stream)
+		return -errno;
+
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	const struct spa_pod *params[1];
+
+	params[0] = spa_format_audio_raw_build(
+		&b, SPA_PARAM_EnumFormat,
+		&SPA_AUDIO_INFO_RAW_INIT(.format = ctx->config.format,
+					 .channels = ctx->config.channels,
+					 .rate = ctx->config.rate));
+
+	int res = pw_stream_connect(bs->stream, bs->direction, PW_ID_ANY,
+				    flags, params, 1);
+
+	return res;
+}
+
+/* the timer lives on the data loop of the driver stream's own context,
+ * next to its process callback; the core exists once it connected */
+static int driver_init(struct bench_context *ctx) {
+	struct driver_timer *d = ctx->driver;
+	struct pw_core *core;
+
+	d->stream = &ctx->streams[0];
+	d->rate = ctx->config.rate;
+	d->duration = ctx->config.quantum;
+	d->period_ns = d->duration * SPA_NSEC_PER_SEC / d->rate;
+
+	core = pw_stream_get_core(d->stream->stream);
+	if (core == NULL)
+		return -EINVAL;
+	d->loop = pw_data_loop_get_loop(
+		pw_context_get_data_loop(pw_core_get_context(core)));
+	d->source = pw_loop_add_timer(d->loop, on_driver_timer, d);
+	if (d->source == NULL)
+		return -errno;
+	return 0;
+}
+
+static void driver_fini(struct bench_context *ctx) {
+	struct driver_timer *d = ctx->driver;
+
+	if (d == NULL)
+		return;
+	if (d->source)
+		pw_loop_destroy_source(d->loop, d->source);
+	free(d);
+	ctx->driver = NULL;
+}
+
+/*
+ * the whole file is allocated, mapped, written once and locked before
+ * the streams connect, so the RT callback neither allocates blocks nor
+ * takes first-write faults (pages written back during a long run can
+ * still take a minor fault on the next write)
+ */
+static int trace_open(struct bench_context *ctx) {
+	const struct bench_config *cfg = &ctx->config;
+	uint64_t cycles =
+		(uint64_t) cfg->duration_sec * cfg->rate / cfg->quantum;
+	uint64_t capacity = cycles + cycles / 4 + 1024;
+	size_t size = trace_file_size(ctx->n_streams, capacity);
+
+	int fd = open(cfg->trace_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+		      0644);
+	if (fd < 0)
+		return -errno;
+
+	int res = posix_fallocate(fd, 0, (off_t) size);
+	if (res != 0) {
+		close(fd);
+		return -res;
+	}
 
-	snprintf(latency_str, sizeof(latency_str), "%u/%u", ctx->config.quantum,
-		 ctx->config.rate);
-	snprintf(force_quantum_str, sizeof(force_quantum_str), "%u",
-		 ctx->config.quantum);
-	snprintf(force_rate_str, sizeof(force_rate_str), "%u",
-		 ctx->config.rate);
+	void *map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, fd, 0);
+	res = -errno;
+	close(fd);
+	if (map == MAP_FAILED)
+		return res;
 
-	struct pw_properties *props = pw_properties_new(
-		PW_KEY_MEDIA_TYPE, "Audio", PW_KEY_MEDIA_CATEGORY, "Playback",
-		PW_KEY_MEDIA_ROLE, "Music", PW_KEY_NODE_NAME, "pipewire-xrun",
-		PW_KEY_NODE_LATENCY, latency_str, PW_KEY_NODE_FORCE_QUANTUM,
-		force_quantum_str, PW_KEY_NODE_FORCE_RATE, force_rate_str,
-		NULL);
+	memset(map, 0, size);
+	if (mlock(map, size) < 0)
+		fprintf(stderr, "warning: cannot lock the trace in memory: "
+				"%s\n",
+			strerror(errno));
 
-	ctx->stream = pw_stream_new_simple(pw_main_loop_get_loop(ctx->loop),
-					   "pipewire-xrun", props,
-					   &stream_events, ctx);
+	struct trace_header *h = map;
+	memcpy(h->magic, TRACE_MAGIC, sizeof(h->magic));
+	h->version = TRACE_VERSION;
+	h->header_size = TRACE_HEADER_SIZE;
+	h->record_size = sizeof(struct trace_record);
+	h->n_streams = ctx->n_streams;
+	h->capacity = capacity;
+	h->rate = cfg->rate;
+	h->quantum = cfg->quantum;
+	h->channels = cfg->channels;
+	h->format = cfg->format;
+	h->threshold_3 = cfg->threshold_3;
 
-	if (!ctx->stream)
-		return -errno;
+	struct trace_record *records =
+		(struct trace_record *) ((uint8_t *) map + TRACE_HEADER_SIZE);
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		struct bench_stream *bs = &ctx->streams[i];
 
-	uint8_t buffer[1024];
-	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
-	const struct spa_pod *params[1];
+		h->streams[i].index = bs->index;
+		h->streams[i].capture = bs->direction == PW_DIRECTION_INPUT;
+		bs->trace = records + (uint64_t) i * capacity;
+		bs->trace_info = &h->streams[i];
+		bs->trace_capacity = capacity;
+	}
 
-	params[0] = spa_format_audio_raw_build(
-		&b, SPA_PARAM_EnumFormat,
-		&SPA_AUDIO_INFO_RAW_INIT(.format = ctx->config.format,
-					 .channels = ctx->config.channels,
-					 .rate = ctx->config.rate));
+	ctx->trace = h;
+	ctx->trace_size = size;
+	return 0;
+}
 
-	int res = pw_stream_connect(ctx->stream, PW_DIRECTION_OUTPUT, PW_ID_ANY,
-				    PW_STREAM_FLAG_AUTOCONNECT |
-					    PW_STREAM_FLAG_MAP_BUFFERS |
-					    PW_STREAM_FLAG_RT_PROCESS,
-				    params, 1);
+static void trace_close(struct bench_context *ctx) {
+	if (ctx->trace == NULL)
+		return;
 
-	return res;
+	munmap(ctx->trace, ctx->trace_size);
+	ctx->trace = NULL;
+	for (uint32_t i = 0; ctx->streams && i < ctx->n_streams; i++)
+		ctx->streams[i].trace = NULL;
 }
 
 static int bench_init(struct bench_context *ctx) {
 	pw_init(NULL, NULL);
 
-	stats_alloc(&ctx->stats, &ctx->config);
+	ctx->n_streams = ctx->config.n_output + ctx->config.n_input;
+	ctx->streams = calloc(ctx->n_streams, sizeof(*ctx->streams));
+	ctx->total = calloc(1, sizeof(*ctx->total));
+	if (ctx->config.driver)
+		ctx->driver = calloc(1, sizeof(*ctx->driver));
+	if (!ctx->streams || !ctx->total ||
+	    (ctx->config.driver && !ctx->driver))
+		return -ENOMEM;
+
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		struct bench_stream *bs = &ctx->streams[i];
+
+		bs->ctx = ctx;
+		if (i < ctx->config.n_output) {
+			bs->index = i;
+			bs->direction = PW_DIRECTION_OUTPUT;
+		} else {
+			bs->index = i - ctx->config.n_output;
+			bs->direction = PW_DIRECTION_INPUT;
+		}
+		synth_init(&bs->synth, ctx->config.rate, TONE_FREQ);
+		tone_check_init(&bs->tone, ctx->config.rate, TONE_FREQ);
+	}
+
+	/* duplex pairs out N with in N */
+	if (ctx->config.mode == MODE_DUPLEX) {
+		for (uint32_t i = 0; i < ctx->config.n_output; i++) {
+			struct bench_stream *out = &ctx->streams[i];
+			struct bench_stream *in =
+				&ctx->streams[ctx->config.n_output + i];
+
+			out->peer = in;
+			in->peer = out;
+		}
+	}
 
-	synth_init(&ctx->synth, ctx->config.rate, 440.0);
+	ctx->ramp_load_pct = ctx->config.load_pct;
+	load_set(ctx, ctx->config.load_pct);
 
 	ctx->loop = pw_main_loop_new(NULL);
 	if (!ctx->loop)
@@ -501,17 +3442,71 @@ static int bench_init(struct bench_context *ctx) {
 	pw_loop_add_signal(pw_main_loop_get_loop(ctx->loop), SIGTERM, on_signal,
 			   ctx);
 
-	if (stream_create(ctx) < 0)
-		return -errno;
+	int res = live_open(ctx);
+	if (res < 0) {
+		fprintf(stderr, "error: cannot open %s: %s\n",
+			ctx->config.live_path, strerror(-res));
+		return res;
+	}
+
+	if (ctx->config.trace_path && (res = trace_open(ctx)) < 0) {
+		fprintf(stderr, "error: cannot create trace %s: %s\n",
+			ctx->config.trace_path, strerror(-res));
+		return res;
+	}
+
+	/* asked for explicitly, so not optional like the monitor */
+	if (ctx->config.sched_path &&
+	    (res = sched_trace_open(&ctx->sched, ctx->config.sched_path)) <
+		    0) {
+		fprintf(stderr, "error: cannot trace the scheduler: %s (needs "
+				"CAP_PERFMON or kernel.perf_event_paranoid "
+				"<= -1, and a readable tracefs)\n",
+			strerror(-res));
+		return res;
+	}
+
+	/* without the monitor only the interval thresholds remain */
+	res = monitor_init(ctx);
+	if (res < 0) {
+		fprintf(stderr, "warning: graph monitor unavailable: %s\n",
+			strerror(-res));
+		monitor_fini(&ctx->monitor);
+	}
+
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		if (stream_create(ctx, &ctx->streams[i]) < 0)
+			return -errno;
+	}
+
+	if (ctx->driver && (res = driver_init(ctx)) < 0) {
+		fprintf(stderr, "error: cannot add the driver timer: %s\n",
+			strerror(-res));
+		return res;
+	}
 
 	return 0;
 }
 
 static void bench_fini(struct bench_context *ctx) {
-	if (ctx->stream) {
-		pw_stream_destroy(ctx->stream);
-		ctx->stream = NULL;
+	/* before the streams take their contexts and data loops along */
+	driver_fini(ctx);
+	for (uint32_t i = 0; ctx->streams && i < ctx->n_streams; i++) {
+		if (ctx->streams[i].stream) {
+			pw_stream_destroy(ctx->streams[i].stream);
+			ctx->streams[i].stream = NULL;
+		}
 	}
+	trace_close(ctx);
+	free(ctx->streams);
+	ctx->streams = NULL;
+	free(ctx->total);
+	ctx->total = NULL;
+
+	monitor_fini(&ctx->monitor);
+	live_close(ctx);
+	sched_trace_close(ctx->sched);
+	ctx->sched = NULL;
 
 	if (ctx->loop) {
 		pw_main_loop_destroy(ctx->loop);
@@ -519,8 +3514,6 @@ static void bench_fini(struct bench_context *ctx) {
 	}
 
 	pw_deinit();
-
-	stats_free(&ctx->stats);
 }
 
 static int bench_run(struct bench_context *ctx) {
@@ -544,6 +3537,22 @@ static int bench_run(struct bench_context *ctx) {
 		return -errno;
 	}
 
+	struct spa_source *sched_timer = NULL;
+	if (ctx->sched) {
+		sched_timer = pw_loop_add_timer(loop, on_sched_drain, ctx);
+		if (!sched_timer) {
+			pw_loop_destroy_source(loop, progress_timer);
+			pw_loop_destroy_source(loop, duration_timer);
+			return -errno;
+		}
+		struct timespec drain_ts = {
+			.tv_sec = 0,
+			.tv_nsec = (long) SCHED_DRAIN_NS,
+		};
+		pw_loop_update_timer(loop, sched_timer, &drain_ts, &drain_ts,
+				     false);
+	}
+
 	struct timespec ts;
 	memset(&ts, 0, sizeof(ts));
 	ts.tv_sec = (time_t) (timeout_ns / 1000000000ULL);
@@ -556,21 +3565,344 @@ static int bench_run(struct bench_context *ctx) {
 	pw_loop_update_timer(loop, progress_timer, &interval_ts, &interval_ts,
 			     false);
 
-	printf("\rremaining: %*d s", ctx->remaining_width,
-	       ctx->config.duration_sec);
-	fflush(stdout);
+	if (progress_shown(ctx)) {
+		printf("\rremaining: %*d s", ctx->remaining_width,
+		       ctx->config.duration_sec);
+		fflush(stdout);
+	}
 
 	pw_main_loop_run(ctx->loop);
 
-	ctx->stats.test_end_ns = now_ns();
+	uint64_t end_ns = now_ns();
+	driver_arm(ctx->driver, false);
+
+	/* removes the nodes from the data loop: on_process() has returned
+	 * for the last time and the RT-owned stats can be read directly */
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		struct bench_stream *bs = &ctx->streams[i];
+
+		bs->stats.test_end_ns = end_ns;
+		pw_stream_disconnect(bs->stream);
+		stats_merge(ctx->total, &bs->stats);
+	}
 
+	if (sched_timer) {
+		sched_drain(ctx);
+		pw_loop_destroy_source(loop, sched_timer);
+	}
 	pw_loop_destroy_source(loop, progress_timer);
 	pw_loop_destroy_source(loop, duration_timer);
 
-	printf("\n");
+	if (progress_shown(ctx))
+		printf("\n");
+	return 0;
+}
+
+#define SYNTH_BENCH_NS 200000000ULL
+
+/* ns per frame of one fill kernel; no format selects the libm reference.
+ * buf holds a quantum of channels 8-byte samples. */
+static double synth_bench_one(const struct bench_config *cfg,
+			      const struct format_desc *fd, void *buf) {
+	struct synth_state synth;
+	uint64_t frames = 0, elapsed;
+	bool planar = fd && fd->planar;
+	uint32_t n_planes = planar ? cfg->channels : 1;
+	uint32_t channels = planar ? 1 : cfg->channels;
+	void *planes[SPA_AUDIO_MAX_CHANNELS];
+
+	for (uint32_t p = 0; p < n_planes; p++)
+		planes[p] = (uint8_t *) buf + (size_t) p * cfg->quantum * 8;
+
+	uint64_t start = now_ns();
+	synth_init(&synth, cfg->rate, TONE_FREQ);
+	do {
+		for (int i = 0; i < 64; i++) {
+			if (fd == NULL)
+				synth_fill_libm_f32(&synth, buf, cfg->quantum,
+						    cfg->channels);
+			else
+				synth_fill(&synth, fd, planes, n_planes,
+					   cfg->quantum, channels);
+			/* keep the stores to buf */
+			__asm__ volatile("" : : "r"(buf) : "memory");
+			frames += cfg->quantum;
+		}
+		elapsed = now_ns() - start;
+	} while (elapsed < SYNTH_BENCH_NS);
+
+	return (double) elapsed / (double) frames;
+}
+
+/* the -F formats, or every format with a fill kernel */
+static uint32_t bench_formats(const struct bench_config *cfg,
+			      uint32_t *formats) {
+	if (cfg->n_matrix_formats > 0) {
+		memcpy(formats, cfg->matrix_formats,
+		       cfg->n_matrix_formats * sizeof(uint32_t));
+		return cfg->n_matrix_formats;
+	}
+	for (size_t i = 0; i < N_FORMATS; i++)
+		formats[i] = format_descs[i].format;
+	return N_FORMATS;
+}
+
+static int synth_bench(const struct bench_config *cfg) {
+	uint32_t formats[MAX_FORMATS];
+	uint32_t n_formats = bench_formats(cfg, formats);
+	void *buf = malloc((size_t) cfg->quantum * cfg->channels * 8);
+
+	if (buf == NULL)
+		return -errno;
+
+	printf("Synth micro-benchmark: %u channels, %u frames per fill\n",
+	       cfg->channels, cfg->quantum);
+	double ns = synth_bench_one(cfg, NULL, buf);
+	printf("  %-17s %6.2f ns/frame  (%.3f ns/sample)\n", "libm F32", ns,
+	       ns / cfg->channels);
+	for (uint32_t i = 0; i < n_formats; i++) {
+		ns = synth_bench_one(cfg, format_desc_for(formats[i]), buf);
+		printf("  %-17s %6.2f ns/frame  (%.3f ns/sample)\n",
+		       spa_type_audio_format_to_short_name(formats[i]), ns,
+		       ns / cfg->channels);
+	}
+	free(buf);
 	return 0;
 }
 
+struct sweep_result {
+	uint32_t rate;
+	uint32_t quantum;
+	/* negotiated, 0 if the format never arrived */
+	uint32_t format;
+	bool done;
+	uint64_t callbacks;
+	uint64_t busy_avg_ns;
+	uint64_t busy_p99_ns;
+	uint64_t p999_ns;
+	uint64_t max_ns;
+	uint64_t xruns;
+	uint64_t graph_xruns;
+	uint64_t errors;
+	bool stable;
+};
+
+/* a fresh context per step, so every step re-creates the streams and
+ * renegotiates quantum and rate */
+static int sweep_step(const struct bench_config *cfg, struct sweep_result *r) {
+	struct bench_context ctx = {0};
+	int res;
+
+	ctx.config = *cfg;
+	r->rate = cfg->rate;
+	r->quantum = cfg->quantum;
+
+	if ((res = bench_init(&ctx)) >= 0 && (res = bench_run(&ctx)) >= 0) {
+		const struct rt_stats *t = ctx.total;
+
+		r->done = true;
+		r->format = atomic_load(&ctx.streams[0].actual_format);
+		r->callbacks = t->callback_count;
+		r->busy_avg_ns = t->busy_count > 0
+					 ? t->busy_sum_ns / t->busy_count
+					 : 0;
+		r->busy_p99_ns = hdr_value_at_percentile(
+			t->busy_hdr, t->busy_count, 99.0);
+		r->p999_ns = hdr_value_at_percentile(t->hdr, t->callback_count,
+						     99.9);
+		r->max_ns = t->max_ns;
+		r->xruns = t->over_threshold_3;
+		r->graph_xruns = ctx.monitor.xruns;
+		r->errors = bench_state_errors(&ctx) + t->discontinuities;
+		r->stable = r->callbacks > 0 && r->xruns == 0 &&
+			    r->graph_xruns == 0 && r->errors == 0 &&
+			    r->p999_ns <= cfg->sweep_p999 * period_ns(cfg);
+		if (atomic_load(&ctx.should_stop))
+			res = -EINTR;
+	}
+	bench_fini(&ctx);
+	return res;
+}
+
+static const char *sweep_verdict(const struct sweep_result *r) {
+	if (!r->done)
+		return "not run";
+	if (r->stable)
+		return "stable";
+	if (r->errors > 0 || r->callbacks == 0)
+		return "errors";
+	if (r->xruns > 0 || r->graph_xruns > 0)
+		return "xruns";
+	return "jitter";
+}
+
+static void sweep_report(const struct bench_config *cfg,
+			 const struct sweep_result *results, uint32_t count) {
+	printf("\nSweep summary (%u s per step, p99.9 limit %.2fx "
+	       "period):\n",
+	       cfg->duration_sec, cfg->sweep_p999);
+	printf("    rate  quantum   period us  callbacks   p99.9 us     max us"
+	       "   xruns   graph  result\n");
+	for (uint32_t i = 0; i < count; i++) {
+		const struct sweep_result *r = &results[i];
+		double period = 1e6 * r->quantum / r->rate;
+
+		printf("  %6u  %7u  %10.2f  %9lu  %9.2f  %9.2f  %6lu  %6lu  "
+		       "%s\n",
+		       r->rate, r->quantum, period,
+		       (unsigned long) r->callbacks, r->p999_ns / 1000.0,
+		       r->max_ns / 1000.0, (unsigned long) r->xruns,
+		       (unsigned long) r->graph_xruns, sweep_verdict(r));
+	}
+	printf("\n");
+}
+
+/*
+ * every quantum at every rate, or with -b a binary search per rate that
+ * assumes stability only improves with the quantum. Returns the number
+ * of rates without a stable quantum, or a negative errno.
+ */
+static int sweep_run(const struct bench_config *base) {
+	uint32_t max_results = base->n_sweep_quanta * base->n_sweep_rates;
+	struct sweep_result *results = calloc(max_results, sizeof(*results));
+	uint32_t n_results = 0, unstable = 0, steps = 0;
+	uint32_t min_stable[MAX_SWEEP];
+	int res = 0;
+
+	if (results == NULL)
+		return -ENOMEM;
+
+	for (uint32_t ri = 0; ri < base->n_sweep_rates && res >= 0; ri++) {
+		struct bench_config cfg = *base;
+		uint32_t lo = 0, hi = base->n_sweep_quanta;
+		uint32_t found = base->n_sweep_quanta;
+
+		cfg.rate = base->sweep_rates[ri];
+		while (lo < hi) {
+			uint32_t qi = base->sweep_search ? lo + (hi - lo) / 2
+							 : lo;
+			struct sweep_result *r = &results[n_results++];
+
+			cfg.quantum = base->sweep_quanta[qi];
+			printf("[%u] %u Hz, quantum %u\n", ++steps, cfg.rate,
+			       cfg.quantum);
+			res = sweep_step(&cfg, r);
+			if (res < 0)
+				break;
+			printf("  -> %s\n", sweep_verdict(r));
+
+			if (r->stable && qi < found)
+				found = qi;
+			if (!base->sweep_search)
+				lo++;
+			else if (r->stable)
+				hi = qi;
+			else
+				lo = qi + 1;
+		}
+		min_stable[ri] = found;
+		if (found == base->n_sweep_quanta)
+			unstable++;
+	}
+
+	if (res < 0 && res != -EINTR)
+		fprintf(stderr, "error: sweep step failed: %s\n",
+			strerror(-res));
+
+	sweep_report(base, results, n_results);
+	if (res >= 0) {
+		for (uint32_t ri = 0; ri < base->n_sweep_rates; ri++) {
+			uint32_t rate = base->sweep_rates[ri];
+
+			if (min_stable[ri] == base->n_sweep_quanta) {
+				printf("Minimum stable quantum at %u Hz: "
+				       "none\n",
+				       rate);
+				continue;
+			}
+			uint32_t q = base->sweep_quanta[min_stable[ri]];
+			printf("Minimum stable quantum at %u Hz: %u frames "
+			       "(%.2f ms)\n",
+			       rate, q, 1000.0 * q / rate);
+		}
+	}
+
+	free(results);
+	return res < 0 ? res : (int) unstable;
+}
+
+static void format_matrix_report(const struct bench_config *cfg,
+				 const uint32_t *formats,
+				 const struct sweep_result *results,
+				 const double *fill_ns, uint32_t count) {
+	printf("\nFormat matrix (%u Hz, quantum %u, %u channels, %u s per "
+	       "format):\n",
+	       cfg->rate, cfg->quantum, cfg->channels, cfg->duration_sec);
+	printf("  format      negotiated  fill ns/frame  busy avg us  "
+	       "busy p99 us   p99.9 us  result\n");
+	for (uint32_t i = 0; i < count; i++) {
+		const struct sweep_result *r = &results[i];
+
+		printf("  %-10s  %-10s  %13.2f  %11.2f  %11.2f  %9.2f  %s\n",
+		       spa_type_audio_format_to_short_name(formats[i]),
+		       r->format ? spa_type_audio_format_to_short_name(
+					   r->format)
+				 : "-",
+		       fill_ns[i], r->busy_avg_ns / 1000.0,
+		       r->busy_p99_ns / 1000.0, r->p999_ns / 1000.0,
+		       sweep_verdict(r));
+	}
+	printf("\n");
+}
+
+/*
+ * one run per format with otherwise identical streams; the fill kernel
+ * is also timed alone, so the callback cost can be split into the
+ * format's own work and the rest. Returns the number of unstable
+ * formats, or a negative errno.
+ */
+static int format_matrix_run(const struct bench_config *base) {
+	uint32_t formats[MAX_FORMATS];
+	uint32_t n_formats = bench_formats(base, formats);
+	struct sweep_result *results = calloc(n_formats, sizeof(*results));
+	double *fill_ns = calloc(n_formats, sizeof(*fill_ns));
+	void *buf = malloc((size_t) base->quantum * base->channels * 8);
+	uint32_t done = 0, unstable = 0;
+	int res = 0;
+
+	if (results == NULL || fill_ns == NULL || buf == NULL) {
+		res = -ENOMEM;
+		goto out;
+	}
+
+	for (uint32_t i = 0; i < n_formats; i++) {
+		struct bench_config cfg = *base;
+
+		cfg.format = formats[i];
+		fill_ns[i] = synth_bench_one(&cfg, format_desc_for(cfg.format),
+					     buf);
+		printf("[%u] %s\n", i + 1,
+		       spa_type_audio_format_to_short_name(cfg.format));
+		res = sweep_step(&cfg, &results[i]);
+		done++;
+		if (res < 0)
+			break;
+		printf("  -> %s\n", sweep_verdict(&results[i]));
+		if (!results[i].stable)
+			unstable++;
+	}
+
+	if (res < 0 && res != -EINTR)
+		fprintf(stderr, "error: format run failed: %s\n",
+			strerror(-res));
+	format_matrix_report(base, formats, results, fill_ns, done);
+out:
+	free(buf);
+	free(fill_ns);
+	free(results);
+	return res < 0 ? res : (int) unstable;
+}
+
 static void print_usage(const char *prog) {
 	printf("Usage: %s [OPTIONS]\n\n", prog);
 	printf("Options:\n");
@@ -581,12 +3913,87 @@ static void print_usage(const char *prog) {
 	printf("  -d SECONDS     Test duration in seconds (default: 30)\n");
 	printf("  -f FORMAT      Sample format: F32, S16LE, S16, etc. "
 	       "(default: F32)\n");
+	printf("  -l PERCENT     Synthetic CPU load per cycle, in percent of "
+	       "the period\n"
+	       "                 (default: 0)\n");
+	printf("  -R PERCENT     Ramp the synthetic load up by PERCENT every "
+	       "second until\n"
+	       "                 xruns appear (default: 0, fixed load)\n");
+	printf("  -m MODE        playback, capture (check a %.0f Hz tone on "
+	       "the default\n"
+	       "                 source) or duplex (capture the sink monitor "
+	       "and align\n"
+	       "                 both callbacks) (default: playback)\n",
+	       TONE_FREQ);
+	printf("  -n STREAMS     Number of concurrent streams per direction "
+	       "(default: 1)\n");
+	printf("  -I STREAMS     Extra capture streams in playback mode "
+	       "(default: 0)\n");
+	printf("  -s QUANTA      Sweep these quanta, e.g. 32,64,128 or 32-1024 "
+	       "(powers of two)\n");
+	printf("  -S RATES       Sweep these rates, e.g. 44100,48000 "
+	       "(default: -r)\n");
+	printf("  -b             Binary search the smallest stable quantum "
+	       "instead of\n"
+	       "                 running every step of the sweep\n");
+	printf("  -F FORMATS     Run once per sample format, e.g. S16,S24,F32P "
+	       "or 'all',\n"
+	       "                 and compare the callback cost\n");
+	printf("  -P FACTOR      Sweep stability limit for the p99.9 interval, "
+	       "in periods\n"
+	       "                 (default: 1.5)\n");
+	printf("  -L FILE        Append the live per-second window as CSV to "
+	       "FILE, or print\n"
+	       "                 it instead of the progress line with "
+	       "'-'\n");
+	printf("  -T FILE        Record every cycle to a memory-mapped trace "
+	       "for\n"
+	       "                 pipewire-xrun-analyze\n");
+	printf("  -K FILE        Trace sched_switch, sched_wakeup and IRQ "
+	       "entry on every\n"
+	       "                 CPU and write what ran during each late "
+	       "callback to\n"
+	       "                 FILE ('-' for stdout); needs CAP_PERFMON\n");
+	printf("  -o FORMAT      Results as 'text' (default) or 'json' on "
+	       "stdout\n");
+	printf("  -C FILE        Compare against the -o json output of an "
+	       "earlier run; the\n"
+	       "                 exit status then reports regressions of the "
+	       "p99/p99.9/max\n"
+	       "                 interval and the violation rates instead of "
+	       "any xrun\n");
+	printf("  -B             Time the synth fill kernels (ns/frame) of "
+	       "every format,\n"
+	       "                 or of the -F formats, and exit\n");
+	printf("  -k BUFFERS     Request this many buffers per stream\n");
+	printf("  -z BYTES       Request buffers of this size\n");
+	printf("  -a ALIGN       Request this buffer alignment in bytes\n");
+	printf("  -t TYPES       Allowed buffer memory: memptr, memfd, dmabuf "
+	       "(comma list)\n");
+	printf("  -M             Don't map the buffers; unmapped memory is "
+	       "queued untouched\n");
+	printf("  -D             Drive the graph from the first stream with "
+	       "its own timer;\n"
+	       "                 the streams stay unlinked from any device "
+	       "(playback only)\n");
 	printf("  -h             Show this help message\n");
 	printf("\n");
 	printf("Examples:\n");
 	printf("  %s -r 48000 -q 256 -d 60\n", prog);
 	printf("  %s -q 64 -d 30\n", prog);
 	printf("  %s -f S16LE -q 256 -d 10\n", prog);
+	printf("  %s -q 128 -l 20 -R 5 -d 60\n", prog);
+	printf("  %s -B -c 8 -q 64\n", prog);
+	printf("  %s -q 128 -n 8 -I 2 -d 60\n", prog);
+	printf("  %s -m duplex -q 64 -d 30\n", prog);
+	printf("  %s -D -n 4 -q 32 -d 30\n", prog);
+	printf("  %s -F S16,S24,S32,F32,F32P -q 256 -d 10\n", prog);
+	printf("  %s -q 64 -k 2 -t memfd -M -d 30\n", prog);
+	printf("  %s -q 64 -K late.txt -d 60\n", prog);
+	printf("  %s -q 128 -d 60 -o json > base.json; %s -q 128 -d 60 "
+	       "-C base.json\n",
+	       prog, prog);
+	printf("  %s -s 16-1024 -S 44100,48000 -b -d 20\n", prog);
 }
 
 static bool is_power_of_two(uint32_t x) {
@@ -604,6 +4011,100 @@ static uint32_t parse_format(const char *name) {
 	return spa_type_audio_format_from_short_name(upper);
 }
 
+/* "memfd,dmabuf" as a mask of 1 << SPA_DATA_*, 0 when invalid */
+static uint32_t parse_data_types(const char *arg) {
+	size_t n_types = sizeof(data_types) / sizeof(data_types[0]);
+	uint32_t mask = 0;
+	const char *p = arg;
+
+	while (*p) {
+		size_t len = strcspn(p, ","), i;
+
+		for (i = 0; i < n_types; i++) {
+			if (strlen(data_types[i].name) == len &&
+			    strncmp(p, data_types[i].name, len) == 0)
+				break;
+		}
+		if (i == n_types)
+			return 0;
+		mask |= 1u << data_types[i].type;
+		p += len;
+		if (*p == ',')
+			p++;
+	}
+	return mask;
+}
+
+/* "S16,F32P" or "all"; only formats with a fill kernel */
+static int parse_formats(const char *arg, uint32_t *out, uint32_t max) {
+	char name[32];
+	uint32_t n = 0;
+	const char *p = arg;
+
+	if (strcmp(arg, "all") == 0) {
+		for (size_t i = 0; i < N_FORMATS && n < max; i++)
+			out[n++] = format_descs[i].format;
+		return (int) n;
+	}
+
+	while (*p) {
+		size_t len = strcspn(p, ",");
+
+		if (len == 0 || len >= sizeof(name) || n == max)
+			return -1;
+		memcpy(name, p, len);
+		name[len] = '\0';
+		out[n] = parse_format(name);
+		if (format_desc_for(out[n]) == NULL)
+			return -1;
+		n++;
+		p += len;
+		if (*p == ',')
+			p++;
+	}
+	return (int) n;
+}
+
+static int compare_u32(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+/* "a,b,c"; with pow2_ranges "lo-hi" adds the powers of two in between */
+static int parse_list(const char *arg, uint32_t *out, uint32_t max,
+		      bool pow2_ranges) {
+	uint32_t n = 0;
+	const char *p = arg;
+
+	while (*p) {
+		char *end;
+		unsigned long lo = strtoul(p, &end, 10), hi = lo;
+
+		if (end == p)
+			return -1;
+		if (*end == '-' && pow2_ranges) {
+			p = end + 1;
+			hi = strtoul(p, &end, 10);
+			if (end == p || hi < lo)
+				return -1;
+		}
+		for (unsigned long v = lo; v <= hi && v <= UINT32_MAX;
+		     v = v ? v * 2 : 1) {
+			if (n == max)
+				return -1;
+			out[n++] = (uint32_t) v;
+			if (v == hi)
+				break;
+		}
+		if (*end == ',')
+			end++;
+		else if (*end != '\0')
+			return -1;
+		p = end;
+	}
+	return (int) n;
+}
+
 static int parse_args(struct bench_config *cfg, int argc, char **argv) {
 	cfg->rate = 48000;
 	cfg->channels = 2;
@@ -613,9 +4114,18 @@ static int parse_args(struct bench_config *cfg, int argc, char **argv) {
 	cfg->threshold_1 = 1.1;
 	cfg->threshold_2 = 1.5;
 	cfg->threshold_3 = 2.0;
+	cfg->load_pct = 0.0;
+	cfg->ramp_step_pct = 0.0;
+	cfg->mode = MODE_PLAYBACK;
+	cfg->n_input = 0;
+
+	cfg->sweep_p999 = 1.5;
 
-	int opt;
-	while ((opt = getopt(argc, argv, "r:c:q:d:f:h")) != -1) {
+	uint32_t n_streams = 1;
+	const char *optstring =
+		"r:c:q:d:f:l:R:m:n:I:s:S:bP:F:L:T:K:o:C:BDk:z:a:t:Mh";
+	int opt, n;
+	while ((opt = getopt(argc, argv, optstring)) != -1) {
 		switch (opt) {
 		case 'r':
 			cfg->rate = (uint32_t) atoi(optarg);
@@ -639,6 +4149,119 @@ static int parse_args(struct bench_config *cfg, int argc, char **argv) {
 			cfg->format = fmt;
 			break;
 		}
+		case 'l':
+			cfg->load_pct = atof(optarg);
+			break;
+		case 'R':
+			cfg->ramp_step_pct = atof(optarg);
+			break;
+		case 'm':
+			if (strcmp(optarg, "playback") == 0) {
+				cfg->mode = MODE_PLAYBACK;
+			} else if (strcmp(optarg, "capture") == 0) {
+				cfg->mode = MODE_CAPTURE;
+			} else if (strcmp(optarg, "duplex") == 0) {
+				cfg->mode = MODE_DUPLEX;
+			} else {
+				fprintf(stderr, "error: unknown mode '%s'\n",
+					optarg);
+				return -1;
+			}
+			break;
+		case 'n':
+			n_streams = (uint32_t) atoi(optarg);
+			break;
+		case 'I':
+			cfg->n_input = (uint32_t) atoi(optarg);
+			break;
+		case 's':
+			n = parse_list(optarg, cfg->sweep_quanta, MAX_SWEEP,
+				       true);
+			if (n <= 0) {
+				fprintf(stderr, "error: invalid quantum list "
+						"'%s'\n",
+					optarg);
+				return -1;
+			}
+			cfg->n_sweep_quanta = (uint32_t) n;
+			break;
+		case 'S':
+			n = parse_list(optarg, cfg->sweep_rates, MAX_SWEEP,
+				       false);
+			if (n <= 0) {
+				fprintf(stderr, "error: invalid rate list "
+						"'%s'\n",
+					optarg);
+				return -1;
+			}
+			cfg->n_sweep_rates = (uint32_t) n;
+			break;
+		case 'b':
+			cfg->sweep_search = true;
+			break;
+		case 'P':
+			cfg->sweep_p999 = atof(optarg);
+			break;
+		case 'F':
+			n = parse_formats(optarg, cfg->matrix_formats,
+					  MAX_FORMATS);
+			if (n <= 0) {
+				fprintf(stderr, "error: invalid format list "
+						"'%s'\n",
+					optarg);
+				return -1;
+			}
+			cfg->n_matrix_formats = (uint32_t) n;
+			break;
+		case 'L':
+			cfg->live_path = optarg;
+			break;
+		case 'T':
+			cfg->trace_path = optarg;
+			break;
+		case 'K':
+			cfg->sched_path = optarg;
+			break;
+		case 'o':
+			if (strcmp(optarg, "json") == 0) {
+				cfg->json = true;
+			} else if (strcmp(optarg, "text") != 0) {
+				fprintf(stderr, "error: unknown output "
+						"'%s'\n",
+					optarg);
+				return -1;
+			}
+			break;
+		case 'C':
+			cfg->compare_path = optarg;
+			break;
+		case 'B':
+			cfg->synth_bench = true;
+			break;
+		case 'D':
+			cfg->driver = true;
+			break;
+		case 'k':
+			cfg->n_buffers = (uint32_t) atoi(optarg);
+			break;
+		case 'z':
+			cfg->buffer_size = (uint32_t) atoi(optarg);
+			break;
+		case 'a':
+			cfg->buffer_align = (uint32_t) atoi(optarg);
+			break;
+		case 't':
+			cfg->data_types = parse_data_types(optarg);
+			if (cfg->data_types == 0) {
+				fprintf(stderr, "error: invalid buffer types "
+						"'%s'\n",
+					optarg);
+				return -1;
+			}
+			break;
+		case 'M':
+			cfg->no_map = true;
+			break;
 		case 'h':
 			print_usage(argv[0]);
 			exit(0);
@@ -648,6 +4271,38 @@ static int parse_args(struct bench_config *cfg, int argc, char **argv) {
 		}
 	}
 
+	if (cfg->mode != MODE_PLAYBACK && cfg->n_input > 0) {
+		fprintf(stderr, "error: -I only applies to playback mode\n");
+		return -1;
+	}
+
+	/* a rate sweep alone runs the -q quantum; a quantum sweep alone
+	 * runs at -r */
+	if (cfg->n_sweep_rates > 0 && cfg->n_sweep_quanta == 0) {
+		cfg->sweep_quanta[0] = cfg->quantum;
+		cfg->n_sweep_quanta = 1;
+	}
+	if (cfg->n_sweep_quanta > 0 && cfg->n_sweep_rates == 0) {
+		cfg->sweep_rates[0] = cfg->rate;
+		cfg->n_sweep_rates = 1;
+	}
+	qsort(cfg->sweep_quanta, cfg->n_sweep_quanta, sizeof(uint32_t),
+	      compare_u32);
+
+	switch (cfg->mode) {
+	case MODE_PLAYBACK:
+		cfg->n_output = n_streams;
+		break;
+	case MODE_CAPTURE:
+		cfg->n_output = 0;
+		cfg->n_input = n_streams;
+		break;
+	case MODE_DUPLEX:
+		cfg->n_output = n_streams;
+		cfg->n_input = n_streams;
+		break;
+	}
+
 	return 0;
 }
 
@@ -664,6 +4319,104 @@ static int validate_config(const struct bench_config *cfg) {
 		return -1;
 	}
 
+	for (uint32_t i = 0; i < cfg->n_sweep_quanta; i++) {
+		if (!is_power_of_two(cfg->sweep_quanta[i])) {
+			fprintf(stderr, "error: swept quantum %u is not a "
+					"power of two\n",
+				cfg->sweep_quanta[i]);
+			return -1;
+		}
+	}
+	for (uint32_t i = 0; i < cfg->n_sweep_rates; i++) {
+		if (cfg->sweep_rates[i] == 0) {
+			fprintf(stderr, "error: swept rates must be "
+					"non-zero\n");
+			return -1;
+		}
+	}
+	if (cfg->n_sweep_quanta > 0 && cfg->ramp_step_pct > 0) {
+		fprintf(stderr, "error: a sweep cannot ramp the load\n");
+		return -1;
+	}
+	if (cfg->trace_path && cfg->n_sweep_quanta > 0) {
+		fprintf(stderr, "error: a sweep cannot write a trace\n");
+		return -1;
+	}
+	if (cfg->n_matrix_formats > 0 && !cfg->synth_bench &&
+	    (cfg->n_sweep_quanta > 0 || cfg->trace_path ||
+	     cfg->sched_path || cfg->ramp_step_pct > 0)) {
+		fprintf(stderr, "error: -F cannot be combined with a sweep, "
+				"a trace or a ramp\n");
+		return -1;
+	}
+	if ((cfg->json || cfg->compare_path) &&
+	    (cfg->n_sweep_quanta > 0 || cfg->n_matrix_formats > 0 ||
+	     cfg->synth_bench)) {
+		fprintf(stderr, "error: -o json and -C cover a single run, "
+				"not a sweep, -F or -B\n");
+		return -1;
+	}
+	bool live_stdout = cfg->live_path && strcmp(cfg->live_path, "-") == 0;
+	bool sched_stdout =
+		cfg->sched_path && strcmp(cfg->sched_path, "-") == 0;
+	if (cfg->json && (live_stdout || sched_stdout)) {
+		fprintf(stderr, "error: -o json needs stdout for itself\n");
+		return -1;
+	}
+	if (cfg->sched_path && cfg->n_sweep_quanta > 0) {
+		fprintf(stderr, "error: a sweep cannot trace the "
+				"scheduler\n");
+		return -1;
+	}
+	if (cfg->trace_path &&
+	    cfg->n_output + cfg->n_input > TRACE_MAX_STREAMS) {
+		fprintf(stderr, "error: a trace holds at most %d streams\n",
+			TRACE_MAX_STREAMS);
+		return -1;
+	}
+	if (cfg->driver && (cfg->mode != MODE_PLAYBACK || cfg->n_input > 0)) {
+		fprintf(stderr, "error: -D only drives playback streams\n");
+		return -1;
+	}
+	if (cfg->buffer_align > 0 && !is_power_of_two(cfg->buffer_align)) {
+		fprintf(stderr, "error: buffer alignment must be a power of "
+				"two\n");
+		return -1;
+	}
+	if (cfg->n_buffers > 64) {
+		fprintf(stderr, "error: at most 64 buffers per stream\n");
+		return -1;
+	}
+	if (cfg->sweep_search && cfg->n_sweep_quanta == 0) {
+		fprintf(stderr, "error: -b needs a quantum list (-s)\n");
+		return -1;
+	}
+	if (cfg->sweep_p999 <= 0) {
+		fprintf(stderr, "error: the p99.9 limit must be positive\n");
+		return -1;
+	}
+
+	if (cfg->load_pct < 0 || cfg->load_pct > 100 ||
+	    cfg->ramp_step_pct < 0 || cfg->ramp_step_pct > 100) {
+		fprintf(stderr, "error: load and ramp step must be between 0 "
+				"and 100 percent\n");
+		return -1;
+	}
+
+	if (cfg->n_output + cfg->n_input == 0 ||
+	    cfg->n_output + cfg->n_input > MAX_STREAMS) {
+		fprintf(stderr, "error: between 1 and %d streams are "
+				"supported\n",
+			MAX_STREAMS);
+		return -1;
+	}
+
+	if (cfg->channels > SPA_AUDIO_MAX_CHANNELS) {
+		fprintf(stderr, "error: at most %d channels are supported\n",
+			SPA_AUDIO_MAX_CHANNELS);
+		return -1;
+	}
+
 	if (format_sample_size(cfg->format) == 0) {
 		fprintf(stderr, "error: unsupported sample format '%s'\n",
 			spa_type_audio_format_to_short_name(cfg->format));
@@ -682,6 +4435,15 @@ int main(int argc, char **argv) {
 	if (validate_config(&ctx.config) < 0)
 		return 1;
 
+	if (ctx.config.synth_bench)
+		return synth_bench(&ctx.config) < 0 ? 1 : 0;
+
+	if (ctx.config.n_sweep_quanta > 0)
+		return sweep_run(&ctx.config) != 0 ? 1 : 0;
+
+	if (ctx.config.n_matrix_formats > 0)
+		return format_matrix_run(&ctx.config) != 0 ? 1 : 0;
+
 	if (bench_init(&ctx) < 0) {
 		fprintf(stderr, "error: failed to initialize benchmark\n");
 		return 1;
@@ -693,13 +4455,38 @@ int main(int argc, char **argv) {
 		return 1;
 	}
 
-	stats_compute_percentiles(&ctx.stats);
-	report_results(&ctx);
+	if (ctx.config.json)
+		report_json(&ctx);
+	else
+		report_results(&ctx);
+
+	int regressions = 0;
+	if (ctx.config.compare_path) {
+		regressions = compare_baseline(&ctx, ctx.config.json ? stderr
+								     : stdout);
+		if (regressions < 0)
+			fprintf(stderr, "error: cannot read baseline %s: %s\n",
+				ctx.config.compare_path,
+				strerror(-regressions));
+	}
+
+	uint64_t state_errors = bench_state_errors(&ctx);
+	uint64_t over_3 = ctx.total->over_threshold_3;
+	uint64_t discontinuities = ctx.total->discontinuities;
+	uint64_t graph_xruns = ctx.monitor.xruns;
 
 	bench_fini(&ctx);
 
-	uint64_t state_errors = atomic_load(&ctx.stats.state_errors);
-	uint64_t over_3 = atomic_load(&ctx.stats.over_threshold_3);
+	/* the baseline decides which xruns are expected */
+	if (ctx.config.compare_path)
+		return (state_errors > 0 || regressions != 0) ? 1 : 0;
+
+	/* a ramp runs into xruns on purpose */
+	if (ctx.config.ramp_step_pct > 0)
+		return state_errors > 0 ? 1 : 0;
 
-	return (state_errors > 0 || over_3 > 0) ? 1 : 0;
+	return (state_errors > 0 || over_3 > 0 || discontinuities > 0 ||
+		graph_xruns > 0)
+		       ? 1
+		       : 0;
 }
@@ -0,0 +1,373 @@
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "results.h"
+
+/* nesting the reader follows; the document itself is three deep */
+#define MAX_DEPTH 16
+
+static void json_member(struct json_writer *w, const char *key) {
+	fputs(w->empty ? "\n" : ",\n", w->f);
+	fprintf(w->f, "%*s", (int) w->depth * 2, "");
+	if (key)
+		fprintf(w->f, "\"%s\": ", key);
+	w->empty = false;
+}
+
+void json_begin(struct json_writer *w, FILE *f) {
+	w->f = f;
+	w->depth = 1;
+	w->empty = true;
+	fputc('{', f);
+}
+
+void json_end(struct json_writer *w) {
+	json_close(w, '}');
+	fputc('\n', w->f);
+	fflush(w->f);
+}
+
+void json_object(struct json_writer *w, const char *key) {
+	json_member(w, key);
+	fputc('{', w->f);
+	w->depth++;
+	w->empty = true;
+}
+
+void json_array(struct json_writer *w, const char *key) {
+	json_member(w, key);
+	fputc('[', w->f);
+	w->depth++;
+	w->empty = true;
+}
+
+void json_close(struct json_writer *w, char bracket) {
+	w->depth--;
+	if (!w->empty)
+		fprintf(w->f, "\n%*s", (int) w->depth * 2, "");
+	fputc(bracket, w->f);
+	w->empty = false;
+}
+
+void json_uint(struct json_writer *w, const char *key, uint64_t value) {
+	json_member(w, key);
+	fprintf(w->f, "%lu", (unsigned long) value);
+}
+
+void json_int(struct json_writer *w, const char *key, int64_t value) {
+	json_member(w, key);
+	fprintf(w->f, "%ld", (long) value);
+}
+
+/* JSON has no NaN or infinity */
+void json_double(struct json_writer *w, const char *key, double value) {
+	json_member(w, key);
+	if (isfinite(value))
+		fprintf(w->f, "%.9g", value);
+	else
+		fputs("null", w->f);
+}
+
+void json_bool(struct json_writer *w, const char *key, bool value) {
+	json_member(w, key);
+	fputs(value ? "true" : "false", w->f);
+}
+
+void json_string(struct json_writer *w, const char *key, const char *value) {
+	json_member(w, key);
+	fputc('"', w->f);
+	for (const unsigned char *c = (const unsigned char *) value; *c; c++) {
+		if (*c == '"' || *c == '\\')
+			fprintf(w->f, "\\%c", *c);
+		else if (*c < 0x20)
+			fprintf(w->f, "\\u%04x", *c);
+		else
+			fputc(*c, w->f);
+	}
+	fputc('"', w->f);
+}
+
+struct parser {
+	const char *p;
+	const char *end;
+	struct result_file *r;
+	uint32_t depth;
+};
+
+static void skip_space(struct parser *ps) {
+	while (ps->p < ps->end && isspace((unsigned char) *ps->p))
+		ps->p++;
+}
+
+static int result_add(struct result_file *r, const char *key,
+		      struct result_value **out) {
+	if (r->count == r->alloc) {
+		size_t alloc = r->alloc ? r->alloc * 2 : 64;
+		struct result_value *v =
+			realloc(r->values, alloc * sizeof(*v));
+		if (v == NULL)
+			return -ENOMEM;
+		r->values = v;
+		r->alloc = alloc;
+	}
+	*out = &r->values[r->count++];
+	memset(*out, 0, sizeof(**out));
+	snprintf((*out)->key, sizeof((*out)->key), "%s", key);
+	return 0;
+}
+
+/* escapes other than \" and \\ are kept as '?', the keys and values
+ * pipewire-xrun writes have none */
+static int parse_string(struct parser *ps, char *dst, size_t size) {
+	size_t n = 0;
+
+	if (ps->p == ps->end || *ps->p != '"')
+		return -EINVAL;
+	ps->p++;
+	while (ps->p < ps->end && *ps->p != '"') {
+		char c = *ps->p++;
+
+		if (c == '\\') {
+			if (ps->p == ps->end)
+				return -EINVAL;
+			c = *ps->p++;
+			if (c == 'u') {
+				if (ps->end - ps->p < 4)
+					return -EINVAL;
+				ps->p += 4;
+				c = '?';
+			} else if (c != '"' && c != '\\' && c != '/') {
+				c = '?';
+			}
+		}
+		if (n + 1 < size)
+			dst[n++] = c;
+	}
+	if (ps->p == ps->end)
+		return -EINVAL;
+	ps->p++;
+	if (size > 0)
+		dst[n] = '\0';
+	return 0;
+}
+
+static bool parse_literal(struct parser *ps, const char *word) {
+	size_t len = strlen(word);
+
+	if ((size_t) (ps->end - ps->p) < len ||
+	    strncmp(ps->p, word, len) != 0)
+		return false;
+	ps->p += len;
+	return true;
+}
+
+/* key is NULL inside arrays: the value is parsed but not kept */
+static int parse_value(struct parser *ps, const char *key);
+
+static int parse_object(struct parser *ps, const char *key) {
+	char member[RESULT_KEY_LEN];
+	char path[RESULT_KEY_LEN * 2];
+	int res;
+
+	ps->p++;
+	skip_space(ps);
+	if (ps->p < ps->end && *ps->p == '}') {
+		ps->p++;
+		return 0;
+	}
+	while (true) {
+		skip_space(ps);
+		if ((res = parse_string(ps, member, sizeof(member))) < 0)
+			return res;
+		skip_space(ps);
+		if (ps->p == ps->end || *ps->p != ':')
+			return -EINVAL;
+		ps->p++;
+
+		if (key && *key)
+			snprintf(path, sizeof(path), "%s.%s", key, member);
+		else
+			snprintf(path, sizeof(path), "%s", member);
+		if ((res = parse_value(ps, key ? path : NULL)) < 0)
+			return res;
+
+		skip_space(ps);
+		if (ps->p < ps->end && *ps->p == ',') {
+			ps->p++;
+			continue;
+		}
+		if (ps->p < ps->end && *ps->p == '}') {
+			ps->p++;
+			return 0;
+		}
+		return -EINVAL;
+	}
+}
+
+static int parse_array(struct parser *ps) {
+	int res;
+
+	ps->p++;
+	skip_space(ps);
+	if (ps->p < ps->end && *ps->p == ']') {
+		ps->p++;
+		return 0;
+	}
+	while (true) {
+		if ((res = parse_value(ps, NULL)) < 0)
+			return res;
+		skip_space(ps);
+		if (ps->p < ps->end && *ps->p == ',') {
+			ps->p++;
+			continue;
+		}
+		if (ps->p < ps->end && *ps->p == ']') {
+			ps->p++;
+			return 0;
+		}
+		return -EINVAL;
+	}
+}
+
+static int parse_value(struct parser *ps, const char *key) {
+	struct result_value *v;
+	char text[RESULT_TEXT_LEN];
+	int res;
+
+	skip_space(ps);
+	if (ps->p == ps->end)
+		return -EINVAL;
+
+	switch (*ps->p) {
+	case '{':
+	case '[':
+		if (ps->depth == MAX_DEPTH)
+			return -EINVAL;
+		ps->depth++;
+		res = *ps->p == '{' ? parse_object(ps, key) : parse_array(ps);
+		ps->depth--;
+		return res;
+	case '"':
+		if ((res = parse_string(ps, text, sizeof(text))) < 0)
+			return res;
+		if (key == NULL)
+			return 0;
+		if ((res = result_add(ps->r, key, &v)) < 0)
+			return res;
+		memcpy(v->text, text, sizeof(v->text));
+		v->is_text = true;
+		return 0;
+	}
+
+	double number;
+	if (parse_literal(ps, "true")) {
+		number = 1;
+	} else if (parse_literal(ps, "false")) {
+		number = 0;
+	} else if (parse_literal(ps, "null")) {
+		number = NAN;
+	} else {
+		char *end;
+		/* the document is NUL-terminated, strtod stops in time */
+		number = strtod(ps->p, &end);
+		if (end == ps->p)
+			return -EINVAL;
+		ps->p = end;
+	}
+	if (key == NULL)
+		return 0;
+	if ((res = result_add(ps->r, key, &v)) < 0)
+		return res;
+	v->number = number;
+	return 0;
+}
+
+int result_load(struct result_file *r, const char *path) {
+	memset(r, 0, sizeof(*r));
+
+	FILE *f = fopen(path, "re");
+	if (f == NULL)
+		return -errno;
+
+	char *text = NULL;
+	size_t len = 0, alloc = 0;
+	int res = 0;
+	while (true) {
+		if (alloc - len < 4096) {
+			alloc = alloc ? alloc * 2 : 16384;
+			char *t = realloc(text, alloc + 1);
+			if (t == NULL) {
+				res = -ENOMEM;
+				break;
+			}
+			text = t;
+		}
+		size_t n = fread(text + len, 1, alloc - len, f);
+		len += n;
+		if (n == 0) {
+			if (ferror(f))
+				res = -EIO;
+			break;
+		}
+	}
+	fclose(f);
+	if (res < 0) {
+		free(text);
+		return res;
+	}
+	if (text == NULL)
+		return -EINVAL;
+	text[len] = '\0';
+
+	struct parser ps = {
+		.p = text,
+		.end = text + len,
+		.r = r,
+	};
+	skip_space(&ps);
+	if (ps.p == ps.end || *ps.p != '{')
+		res = -EINVAL;
+	else
+		res = parse_value(&ps, "");
+	skip_space(&ps);
+	if (res == 0 && ps.p != ps.end)
+		res = -EINVAL;
+	free(text);
+	if (res < 0)
+		result_free(r);
+	return res;
+}
+
+void result_free(struct result_file *r) {
+	free(r->values);
+	memset(r, 0, sizeof(*r));
+}
+
+static const struct result_value *result_find(const struct result_file *r,
+					      const char *key) {
+	for (size_t i = 0; i < r->count; i++) {
+		if (strcmp(r->values[i].key, key) == 0)
+			return &r->values[i];
+	}
+	return NULL;
+}
+
+bool result_number(const struct result_file *r, const char *key,
+		   double *value) {
+	const struct result_value *v = result_find(r, key);
+
+	if (v == NULL || v->is_text || isnan(v->number))
+		return false;
+	*value = v->number;
+	return true;
+}
+
+const char *result_text(const struct result_file *r, const char *key) {
+	const struct result_value *v = result_find(r, key);
+
+	return v && v->is_text ? v->text : NULL;
+}
@@ -0,0 +1,65 @@
+/*
+ * results.h - the JSON result document of pipewire-xrun -o json, and the
+ * reader -C uses to load one back as a baseline.
+ *
+ * The writer streams members as they come; the reader flattens every
+ * number, boolean and string outside of arrays into "object.member"
+ * keys, which is all a baseline comparison needs. Arrays (the
+ * per-stream list) are parsed and skipped.
+ */
+
+#ifndef PIPEWIRE_XRUN_RESULTS_H
+#define PIPEWIRE_XRUN_RESULTS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define RESULTS_VERSION 1
+#define RESULT_KEY_LEN 64
+#define RESULT_TEXT_LEN 32
+
+struct json_writer {
+	FILE *f;
+	uint32_t depth;
+	/* nothing written yet inside the innermost object or array */
+	bool empty;
+};
+
+/* the root object; members inside arrays take a NULL key */
+void json_begin(struct json_writer *w, FILE *f);
+void json_end(struct json_writer *w);
+void json_object(struct json_writer *w, const char *key);
+void json_array(struct json_writer *w, const char *key);
+void json_close(struct json_writer *w, char bracket);
+void json_uint(struct json_writer *w, const char *key, uint64_t value);
+void json_int(struct json_writer *w, const char *key, int64_t value);
+void json_double(struct json_writer *w, const char *key, double value);
+void json_bool(struct json_writer *w, const char *key, bool value);
+void json_string(struct json_writer *w, const char *key, const char *value);
+
+struct result_value {
+	char key[RESULT_KEY_LEN];
+	double number;
+	/* strings keep their first RESULT_TEXT_LEN - 1 bytes */
+	char text[RESULT_TEXT_LEN];
+	bool is_text;
+};
+
+struct result_file {
+	struct result_value *values;
+	size_t count;
+	size_t alloc;
+};
+
+/* negative errno; -EINVAL for a document that is not valid JSON */
+int result_load(struct result_file *r, const char *path);
+void result_free(struct result_file *r);
+
+bool result_number(const struct result_file *r, const char *key,
+		   double *value);
+/* NULL when the key is missing or not a string */
+const char *result_text(const struct result_file *r, const char *key);
+
+#endif
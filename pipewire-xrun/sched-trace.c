@@ -0,0 +1,688 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sched-trace.h"
+
+/* data pages per CPU ring, a power of two */
+#define RING_PAGES 128
+/* decoded events kept per CPU; the main loop drains every 100 ms */
+#define HISTORY_SIZE 8192
+/* lines written per late window, the run-time summary follows */
+#define MAX_WINDOW_LINES 64
+#define MAX_TASKS 64
+#define MAX_FIELDS 5
+#define COMM_LEN 16
+
+static const char *const tracefs_roots[] = {
+	"/sys/kernel/tracing/events",
+	"/sys/kernel/debug/tracing/events",
+};
+#define N_ROOTS (sizeof(tracefs_roots) / sizeof(tracefs_roots[0]))
+
+enum sched_kind {
+	SCHED_SWITCH,
+	SCHED_WAKEUP,
+	SCHED_IRQ,
+	SCHED_N_KINDS,
+};
+
+struct tp_field {
+	const char *name;
+	uint32_t offset;
+	uint32_t size;
+	/* __data_loc: a u32 of offset | length << 16 into the raw data */
+	bool data_loc;
+};
+
+struct tp_event {
+	const char *system;
+	const char *name;
+	uint32_t id;
+	struct tp_field fields[MAX_FIELDS];
+};
+
+/* field order is what decode() indexes */
+static const struct tp_event tp_templates[SCHED_N_KINDS] = {
+	[SCHED_SWITCH] = {"sched", "sched_switch", 0,
+			  {{"prev_pid"},
+			   {"prev_state"},
+			   {"next_comm"},
+			   {"next_pid"},
+			   {"next_prio"}}},
+	[SCHED_WAKEUP] = {"sched", "sched_wakeup", 0,
+			  {{"comm"}, {"pid"}, {"prio"}, {"target_cpu"}}},
+	[SCHED_IRQ] = {"irq", "irq_handler_entry", 0, {{"irq"}, {"name"}}},
+};
+
+/* one decoded tracepoint hit */
+struct sched_event {
+	uint64_t time_ns;
+	uint8_t kind;
+	/* switch: next task; wakeup: woken task; irq: irq number */
+	int32_t pid;
+	int32_t prio;
+	/* switch only */
+	int32_t prev_pid;
+	uint32_t prev_state;
+	/* wakeup only */
+	int32_t target_cpu;
+	char comm[COMM_LEN];
+};
+
+struct sched_cpu {
+	int cpu;
+	int fds[SCHED_N_KINDS];
+	struct perf_event_mmap_page *ring;
+	size_t ring_size;
+
+	/* events ever decoded, the last HISTORY_SIZE of them kept */
+	struct sched_event *history;
+	uint64_t head;
+};
+
+/* run time inside late windows, per task */
+struct sched_task {
+	int32_t pid;
+	char comm[COMM_LEN];
+	uint64_t run_ns;
+	uint64_t windows;
+	uint64_t last_window;
+};
+
+struct sched_trace {
+	struct tp_event events[SCHED_N_KINDS];
+	struct sched_cpu *cpus;
+	uint32_t n_cpus;
+	size_t page_size;
+	FILE *out;
+	const char *path;
+
+	uint64_t read;
+	uint64_t lost;
+	uint64_t unknown;
+	/* late callbacks written with a complete window, cut short by an
+	 * overwritten history, or on a CPU that is not traced */
+	uint64_t explained;
+	uint64_t partial;
+	uint64_t untraced;
+	uint64_t irqs;
+
+	struct sched_task tasks[MAX_TASKS];
+	uint32_t n_tasks;
+	uint64_t other_ns;
+};
+
+/* "field:char next_comm[16];\toffset:40;\tsize:16;\tsigned:0;" */
+static void tp_parse_field(struct tp_event *ev, const char *line) {
+	const char *decl = strstr(line, "field:");
+	if (decl == NULL)
+		return;
+	decl += strlen("field:");
+	const char *semi = strchr(decl, ';');
+	if (semi == NULL)
+		return;
+
+	/* the name is the last word of the declaration, without its [] */
+	const char *start = semi;
+	while (start > decl && start[-1] != ' ')
+		start--;
+	const char *end = memchr(start, '[', (size_t) (semi - start));
+	if (end == NULL)
+		end = semi;
+
+	unsigned int offset, size;
+	const char *o = strstr(semi, "offset:");
+	const char *s = strstr(semi, "size:");
+	if (o == NULL || s == NULL || sscanf(o, "offset:%u", &offset) != 1 ||
+	    sscanf(s, "size:%u", &size) != 1)
+		return;
+
+	for (uint32_t i = 0; i < MAX_FIELDS && ev->fields[i].name; i++) {
+		struct tp_field *f = &ev->fields[i];
+
+		if (strlen(f->name) != (size_t) (end - start) ||
+		    strncmp(f->name, start, (size_t) (end - start)) != 0)
+			continue;
+		f->offset = offset;
+		f->size = size;
+		f->data_loc = strncmp(decl, "__data_loc", 10) == 0;
+	}
+}
+
+static int tp_load(struct tp_event *ev, const char *root) {
+	char path[256];
+	char line[512];
+
+	snprintf(path, sizeof(path), "%s/%s/%s/format", root, ev->system,
+		 ev->name);
+	FILE *f = fopen(path, "re");
+	if (f == NULL)
+		return -errno;
+
+	while (fgets(line, sizeof(line), f)) {
+		unsigned int id;
+
+		if (sscanf(line, "ID: %u", &id) == 1)
+			ev->id = id;
+		else
+			tp_parse_field(ev, line);
+	}
+	fclose(f);
+
+	if (ev->id == 0)
+		return -EINVAL;
+	for (uint32_t i = 0; i < MAX_FIELDS && ev->fields[i].name; i++) {
+		if (ev->fields[i].size == 0)
+			return -EINVAL;
+	}
+	return 0;
+}
+
+static int tp_load_all(struct sched_trace *st) {
+	int res = -ENOENT;
+
+	for (size_t r = 0; r < N_ROOTS; r++) {
+		memcpy(st->events, tp_templates, sizeof(st->events));
+		for (int k = 0; k < SCHED_N_KINDS; k++) {
+			res = tp_load(&st->events[k], tracefs_roots[r]);
+			if (res < 0)
+				break;
+		}
+		if (res == 0)
+			return 0;
+	}
+	return res;
+}
+
+static int64_t raw_int(const uint8_t *raw, uint32_t raw_size,
+		       const struct tp_field *f) {
+	if (f->offset + f->size > raw_size)
+		return 0;
+
+	switch (f->size) {
+	case 1:
+		return (int8_t) raw[f->offset];
+	case 2: {
+		int16_t v;
+		memcpy(&v, raw + f->offset, sizeof(v));
+		return v;
+	}
+	case 4: {
+		int32_t v;
+		memcpy(&v, raw + f->offset, sizeof(v));
+		return v;
+	}
+	case 8: {
+		int64_t v;
+		memcpy(&v, raw + f->offset, sizeof(v));
+		return v;
+	}
+	}
+	return 0;
+}
+
+static void raw_str(char *dst, const uint8_t *raw, uint32_t raw_size,
+		    const struct tp_field *f) {
+	uint32_t offset = f->offset, size = f->size;
+
+	if (f->data_loc) {
+		uint32_t loc = (uint32_t) raw_int(raw, raw_size, f);
+		offset = loc & 0xffff;
+		size = loc >> 16;
+	}
+	if (size > COMM_LEN - 1)
+		size = COMM_LEN - 1;
+	if (offset + size > raw_size)
+		size = offset < raw_size ? raw_size - offset : 0;
+	memcpy(dst, raw + offset, size);
+	dst[size] = '\0';
+}
+
+static void decode(struct sched_trace *st, struct sched_cpu *c,
+		   uint64_t time_ns, const uint8_t *raw, uint32_t raw_size) {
+	uint16_t type;
+	int kind;
+
+	if (raw_size < sizeof(type))
+		return;
+	memcpy(&type, raw, sizeof(type));
+	for (kind = 0; kind < SCHED_N_KINDS; kind++) {
+		if (st->events[kind].id == type)
+			break;
+	}
+	if (kind == SCHED_N_KINDS) {
+		st->unknown++;
+		return;
+	}
+
+	const struct tp_field *f = st->events[kind].fields;
+	struct sched_event *e = &c->history[c->head % HISTORY_SIZE];
+	memset(e, 0, sizeof(*e));
+	e->time_ns = time_ns;
+	e->kind = (uint8_t) kind;
+
+	switch (kind) {
+	case SCHED_SWITCH:
+		e->prev_pid = (int32_t) raw_int(raw, raw_size, &f[0]);
+		e->prev_state = (uint32_t) raw_int(raw, raw_size, &f[1]);
+		raw_str(e->comm, raw, raw_size, &f[2]);
+		e->pid = (int32_t) raw_int(raw, raw_size, &f[3]);
+		e->prio = (int32_t) raw_int(raw, raw_size, &f[4]);
+		break;
+	case SCHED_WAKEUP:
+		raw_str(e->comm, raw, raw_size, &f[0]);
+		e->pid = (int32_t) raw_int(raw, raw_size, &f[1]);
+		e->prio = (int32_t) raw_int(raw, raw_size, &f[2]);
+		e->target_cpu = (int32_t) raw_int(raw, raw_size, &f[3]);
+		break;
+	case SCHED_IRQ:
+		e->pid = (int32_t) raw_int(raw, raw_size, &f[0]);
+		raw_str(e->comm, raw, raw_size, &f[1]);
+		break;
+	}
+	c->head++;
+	st->read++;
+}
+
+/* sample_type TIME | RAW: u64 time, u32 size, size bytes of raw data */
+static void ring_drain(struct sched_trace *st, struct sched_cpu *c) {
+	struct perf_event_mmap_page *pg = c->ring;
+	const uint8_t *data = (const uint8_t *) pg + st->page_size;
+	uint64_t mask = RING_PAGES * st->page_size - 1;
+	uint64_t head = __atomic_load_n(&pg->data_head, __ATOMIC_ACQUIRE);
+	uint64_t tail = pg->data_tail;
+	uint8_t rec[512];
+
+	while (tail < head) {
+		struct perf_event_header h;
+
+		for (size_t i = 0; i < sizeof(h); i++)
+			((uint8_t *) &h)[i] = data[(tail + i) & mask];
+		if (h.size < sizeof(h))
+			break;
+
+		/* records wrap at the end of the ring */
+		uint32_t size = h.size < sizeof(rec) ? h.size : sizeof(rec);
+		for (uint32_t i = 0; i < size; i++)
+			rec[i] = data[(tail + i) & mask];
+		tail += h.size;
+
+		if (h.type == PERF_RECORD_LOST && size >= sizeof(h) + 16) {
+			uint64_t lost;
+			memcpy(&lost, rec + sizeof(h) + 8, sizeof(lost));
+			st->lost += lost;
+		} else if (h.type == PERF_RECORD_SAMPLE &&
+			   size >= sizeof(h) + 12) {
+			uint64_t time_ns;
+			uint32_t raw_size;
+			memcpy(&time_ns, rec + sizeof(h), sizeof(time_ns));
+			memcpy(&raw_size, rec + sizeof(h) + 8,
+			       sizeof(raw_size));
+			if (raw_size > size - sizeof(h) - 12)
+				raw_size = size - sizeof(h) - 12;
+			decode(st, c, time_ns, rec + sizeof(h) + 12, raw_size);
+		}
+	}
+	__atomic_store_n(&pg->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+void sched_trace_poll(struct sched_trace *st) {
+	for (uint32_t i = 0; i < st->n_cpus; i++)
+		ring_drain(st, &st->cpus[i]);
+}
+
+static int tp_open(const struct tp_event *ev, int cpu) {
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_TRACEPOINT;
+	attr.config = ev->id;
+	attr.sample_period = 1;
+	attr.sample_type = PERF_SAMPLE_TIME | PERF_SAMPLE_RAW;
+	attr.disabled = 1;
+	/* the same clock as now_ns() in the late callbacks */
+	attr.use_clockid = 1;
+	attr.clockid = CLOCK_MONOTONIC;
+
+	int fd = (int) syscall(SYS_perf_event_open, &attr, -1, cpu, -1,
+			       PERF_FLAG_FD_CLOEXEC);
+	return fd < 0 ? -errno : fd;
+}
+
+/* all three events of a CPU share the switch event's ring */
+static int cpu_open(struct sched_trace *st, struct sched_cpu *c) {
+	for (int k = 0; k < SCHED_N_KINDS; k++) {
+		c->fds[k] = tp_open(&st->events[k], c->cpu);
+		if (c->fds[k] < 0)
+			return c->fds[k];
+	}
+
+	c->ring_size = (1 + RING_PAGES) * st->page_size;
+	void *ring = mmap(NULL, c->ring_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED, c->fds[SCHED_SWITCH], 0);
+	if (ring == MAP_FAILED)
+		return -errno;
+	c->ring = ring;
+
+	for (int k = 0; k < SCHED_N_KINDS; k++) {
+		if (k != SCHED_SWITCH &&
+		    ioctl(c->fds[k], PERF_EVENT_IOC_SET_OUTPUT,
+			  c->fds[SCHED_SWITCH]) < 0)
+			return -errno;
+	}
+
+	c->history = calloc(HISTORY_SIZE, sizeof(*c->history));
+	if (c->history == NULL)
+		return -ENOMEM;
+	return 0;
+}
+
+static void cpu_enable(struct sched_cpu *c) {
+	for (int k = 0; k < SCHED_N_KINDS; k++)
+		ioctl(c->fds[k], PERF_EVENT_IOC_ENABLE, 0);
+}
+
+int sched_trace_open(struct sched_trace **stp, const char *path) {
+	struct sched_trace *st;
+	cpu_set_t set;
+	int res;
+
+	st = calloc(1, sizeof(*st));
+	if (st == NULL)
+		return -ENOMEM;
+	st->page_size = (size_t) sysconf(_SC_PAGESIZE);
+	st->path = path;
+
+	/* the data threads can run on any CPU the process may use */
+	if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+		res = -errno;
+		goto error;
+	}
+	st->cpus = calloc((size_t) CPU_COUNT(&set), sizeof(*st->cpus));
+	if (st->cpus == NULL) {
+		res = -ENOMEM;
+		goto error;
+	}
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &set))
+			continue;
+		struct sched_cpu *c = &st->cpus[st->n_cpus++];
+		c->cpu = cpu;
+		for (int k = 0; k < SCHED_N_KINDS; k++)
+			c->fds[k] = -1;
+	}
+
+	if ((res = tp_load_all(st)) < 0)
+		goto error;
+	for (uint32_t i = 0; i < st->n_cpus; i++) {
+		if ((res = cpu_open(st, &st->cpus[i])) < 0)
+			goto error;
+	}
+
+	st->out = strcmp(path, "-") == 0 ? stdout : fopen(path, "we");
+	if (st->out == NULL) {
+		res = -errno;
+		goto error;
+	}
+
+	for (uint32_t i = 0; i < st->n_cpus; i++)
+		cpu_enable(&st->cpus[i]);
+	*stp = st;
+	return 0;
+
+error:
+	sched_trace_close(st);
+	return res;
+}
+
+void sched_trace_close(struct sched_trace *st) {
+	if (st == NULL)
+		return;
+	for (uint32_t i = 0; st->cpus && i < st->n_cpus; i++) {
+		struct sched_cpu *c = &st->cpus[i];
+
+		if (c->ring)
+			munmap(c->ring, c->ring_size);
+		for (int k = 0; k < SCHED_N_KINDS; k++) {
+			if (c->fds[k] >= 0)
+				close(c->fds[k]);
+		}
+		free(c->history);
+	}
+	free(st->cpus);
+	if (st->out && st->out != stdout)
+		fclose(st->out);
+	free(st);
+}
+
+static struct sched_cpu *cpu_find(struct sched_trace *st, int cpu) {
+	for (uint32_t i = 0; i < st->n_cpus; i++) {
+		if (st->cpus[i].cpu == cpu)
+			return &st->cpus[i];
+	}
+	return NULL;
+}
+
+static const struct sched_event *history_at(const struct sched_cpu *c,
+					    uint64_t i) {
+	return &c->history[i % HISTORY_SIZE];
+}
+
+static uint64_t history_first(const struct sched_cpu *c) {
+	return c->head > HISTORY_SIZE ? c->head - HISTORY_SIZE : 0;
+}
+
+/* the culprit table keeps the first MAX_TASKS tasks, later ones only
+ * add to other_ns */
+static void task_add(struct sched_trace *st, int32_t pid, const char *comm,
+		     uint64_t run_ns, uint64_t window) {
+	if (pid == 0 || run_ns == 0)
+		return;
+
+	struct sched_task *t = NULL;
+	for (uint32_t i = 0; i < st->n_tasks; i++) {
+		if (st->tasks[i].pid == pid) {
+			t = &st->tasks[i];
+			break;
+		}
+	}
+	if (t == NULL) {
+		if (st->n_tasks == MAX_TASKS) {
+			st->other_ns += run_ns;
+			return;
+		}
+		t = &st->tasks[st->n_tasks++];
+		t->pid = pid;
+	}
+	snprintf(t->comm, sizeof(t->comm), "%s", comm);
+	t->run_ns += run_ns;
+	if (t->last_window != window) {
+		t->last_window = window;
+		t->windows++;
+	}
+}
+
+static char state_char(uint32_t state) {
+	/* TASK_* bits of prev_state; 0 is preempted while runnable */
+	static const char states[] = "SDTtXZPI";
+
+	if (state == 0)
+		return 'R';
+	for (uint32_t i = 0; i < sizeof(states) - 1; i++) {
+		if (state & (1u << i))
+			return states[i];
+	}
+	return '?';
+}
+
+static void event_write(FILE *f, const struct sched_event *e,
+			uint64_t start_ns, int32_t tid) {
+	double at_ms = ((double) e->time_ns - (double) start_ns) / 1e6;
+
+	switch (e->kind) {
+	case SCHED_SWITCH:
+		fprintf(f, "  %+9.3f ms  switch  %d (%c) -> %s/%d prio %d%s\n",
+			at_ms, e->prev_pid, state_char(e->prev_state), e->comm,
+			e->pid, e->prio,
+			e->pid == tid ? "  <- data thread" : "");
+		break;
+	case SCHED_WAKEUP:
+		fprintf(f, "  %+9.3f ms  wakeup  %s/%d prio %d on cpu %d%s\n",
+			at_ms, e->comm, e->pid, e->prio, e->target_cpu,
+			e->pid == tid ? "  <- data thread" : "");
+		break;
+	case SCHED_IRQ:
+		fprintf(f, "  %+9.3f ms  irq     %d %s\n", at_ms, e->pid,
+			e->comm);
+		break;
+	}
+}
+
+/* the data thread's wakeup is usually raised on the CPU of the thread
+ * that signalled it */
+static void wakeups_write(struct sched_trace *st, const struct sched_cpu *own,
+			  uint64_t start_ns, uint64_t end_ns, int32_t tid) {
+	for (uint32_t i = 0; i < st->n_cpus; i++) {
+		const struct sched_cpu *c = &st->cpus[i];
+
+		if (c == own)
+			continue;
+		for (uint64_t n = history_first(c); n < c->head; n++) {
+			const struct sched_event *e = history_at(c, n);
+
+			if (e->kind != SCHED_WAKEUP || e->pid != tid ||
+			    e->time_ns < start_ns || e->time_ns > end_ns)
+				continue;
+			fprintf(st->out, "  %+9.3f ms  wakeup  of the data "
+					 "thread from cpu %d\n",
+				((double) e->time_ns - (double) start_ns) / 1e6,
+				c->cpu);
+		}
+	}
+}
+
+void sched_trace_explain(struct sched_trace *st,
+			 const struct sched_late *late, const char *label) {
+	uint64_t end_ns = late->time_ns;
+	uint64_t start_ns =
+		late->interval_ns < end_ns ? end_ns - late->interval_ns : 0;
+	FILE *f = st->out;
+
+	fprintf(f, "late %s: interval %.3f ms ending at %.6f s, cpu %d, "
+		   "tid %d\n",
+		label, late->interval_ns / 1e6, end_ns / 1e9, late->cpu,
+		late->tid);
+
+	struct sched_cpu *c = cpu_find(st, late->cpu);
+	if (c == NULL) {
+		st->untraced++;
+		fprintf(f, "  cpu %d is not traced\n\n", late->cpu);
+		return;
+	}
+
+	/* the window starts with whatever the last switch before it put
+	 * on the CPU */
+	uint64_t first = history_first(c);
+	uint64_t n = c->head;
+	while (n > first && history_at(c, n - 1)->time_ns >= start_ns)
+		n--;
+	const struct sched_event *before = NULL;
+	for (uint64_t i = n; i > first; i--) {
+		if (history_at(c, i - 1)->kind == SCHED_SWITCH) {
+			before = history_at(c, i - 1);
+			break;
+		}
+	}
+	/* an overwritten history lost the start of the window */
+	bool complete = before != NULL || first == 0;
+	if (complete)
+		st->explained++;
+	else
+		st->partial++;
+
+	int32_t cur_pid = before ? before->pid : -1;
+	char cur_comm[COMM_LEN];
+	snprintf(cur_comm, sizeof(cur_comm), "%s", before ? before->comm : "?");
+	if (before)
+		fprintf(f, "  running: %s/%d prio %d\n", before->comm,
+			before->pid, before->prio);
+	else if (!complete)
+		fprintf(f, "  history starts inside the window\n");
+
+	uint64_t cursor = start_ns;
+	uint32_t lines = 0;
+	uint64_t skipped = 0;
+	uint64_t window = st->explained + st->partial;
+	for (; n < c->head; n++) {
+		const struct sched_event *e = history_at(c, n);
+
+		if (e->time_ns > end_ns)
+			break;
+		if (lines < MAX_WINDOW_LINES) {
+			event_write(f, e, start_ns, late->tid);
+			lines++;
+		} else {
+			skipped++;
+		}
+		if (e->kind == SCHED_IRQ)
+			st->irqs++;
+		if (e->kind != SCHED_SWITCH)
+			continue;
+		if (cur_pid >= 0 && cur_pid != late->tid)
+			task_add(st, cur_pid, cur_comm, e->time_ns - cursor,
+				 window);
+		cursor = e->time_ns;
+		cur_pid = e->pid;
+		snprintf(cur_comm, sizeof(cur_comm), "%s", e->comm);
+	}
+	if (cur_pid >= 0 && cur_pid != late->tid && end_ns > cursor)
+		task_add(st, cur_pid, cur_comm, end_ns - cursor, window);
+	if (skipped > 0)
+		fprintf(f, "  ... %lu more events\n", (unsigned long) skipped);
+
+	wakeups_write(st, c, start_ns, end_ns, late->tid);
+	fprintf(f, "\n");
+}
+
+static int compare_task(const void *a, const void *b) {
+	const struct sched_task *ta = a, *tb = b;
+	return ta->run_ns < tb->run_ns ? 1 : ta->run_ns > tb->run_ns ? -1 : 0;
+}
+
+void sched_trace_report(const struct sched_trace *st, uint64_t unqueued) {
+	printf("Scheduler trace:\n");
+	printf("  CPUs traced:      %u\n", st->n_cpus);
+	printf("  Events:           %lu  (%lu lost)\n",
+	       (unsigned long) st->read, (unsigned long) st->lost);
+	printf("  Late windows:     %lu  (%lu cut short, %lu untraced CPU, "
+	       "%lu not queued)\n",
+	       (unsigned long) st->explained, (unsigned long) st->partial,
+	       (unsigned long) st->untraced, (unsigned long) unqueued);
+	printf("  IRQs in windows:  %lu\n", (unsigned long) st->irqs);
+	printf("  Window file:      %s\n", st->path);
+
+	struct sched_task tasks[MAX_TASKS];
+	memcpy(tasks, st->tasks, st->n_tasks * sizeof(tasks[0]));
+	qsort(tasks, st->n_tasks, sizeof(tasks[0]), compare_task);
+	for (uint32_t i = 0; i < st->n_tasks && i < 5; i++)
+		printf("  %-18s%s/%d: %.3f ms in %lu windows\n",
+		       i == 0 ? "Ran instead:" : "", tasks[i].comm,
+		       tasks[i].pid, tasks[i].run_ns / 1e6,
+		       (unsigned long) tasks[i].windows);
+	if (st->other_ns > 0)
+		printf("  %-18sother tasks: %.3f ms\n", "", st->other_ns / 1e6);
+	printf("\n");
+}
@@ -0,0 +1,44 @@
+/*
+ * sched-trace.h - kernel scheduling events around late callbacks, for
+ * pipewire-xrun -K.
+ *
+ * The collector opens the sched_switch, sched_wakeup and irq_handler_entry
+ * tracepoints with perf_event_open() on every CPU the process may run on,
+ * one CLOCK_MONOTONIC stamped ring buffer per CPU. The main loop drains
+ * the rings into a short per-CPU history and, for every late callback the
+ * data threads queued, writes what ran on that CPU during the late
+ * interval.
+ */
+
+#ifndef PIPEWIRE_XRUN_SCHED_TRACE_H
+#define PIPEWIRE_XRUN_SCHED_TRACE_H
+
+#include <stdint.h>
+
+struct sched_trace;
+
+/* one late callback, as the data thread saw it */
+struct sched_late {
+	/* callback entry, CLOCK_MONOTONIC, and the interval that ended there */
+	uint64_t time_ns;
+	uint64_t interval_ns;
+	int32_t cpu;
+	int32_t tid;
+};
+
+/* path receives one block per late callback; negative errno on failure */
+int sched_trace_open(struct sched_trace **st, const char *path);
+
+/* main loop only: moves the kernel samples into the history */
+void sched_trace_poll(struct sched_trace *st);
+
+/* the history must have been polled after late->time_ns */
+void sched_trace_explain(struct sched_trace *st,
+			 const struct sched_late *late, const char *label);
+
+/* summary for the report; unqueued late callbacks found the queue full */
+void sched_trace_report(const struct sched_trace *st, uint64_t unqueued);
+
+void sched_trace_close(struct sched_trace *st);
+
+#endif
@@ -0,0 +1,433 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define MAX_BURSTS_SHOWN 10
+
+struct analyze_config {
+	const char *path;
+	const char *csv_path;
+	/* -1: every stream */
+	int stream;
+	/* late cycles closer than gap_ms belong to the same burst, which is
+	 * reported from min_late of them on */
+	double gap_ms;
+	uint32_t min_late;
+};
+
+struct burst {
+	uint32_t stream;
+	uint64_t start_ns;
+	uint64_t end_ns;
+	uint64_t late;
+	uint64_t worst_ns;
+};
+
+struct burst_list {
+	struct burst *items;
+	size_t count;
+	size_t alloc;
+};
+
+struct trace_file {
+	const struct trace_header *header;
+	const struct trace_record *records;
+	size_t size;
+};
+
+static int trace_map(struct trace_file *tf, const char *path) {
+	struct stat st;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st) < 0) {
+		int res = -errno;
+		close(fd);
+		return res;
+	}
+	if ((size_t) st.st_size < TRACE_HEADER_SIZE) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd,
+			 0);
+	int res = -errno;
+	close(fd);
+	if (map == MAP_FAILED)
+		return res;
+
+	const struct trace_header *h = map;
+	if (memcmp(h->magic, TRACE_MAGIC, sizeof(h->magic)) != 0 ||
+	    h->version != TRACE_VERSION ||
+	    h->header_size != TRACE_HEADER_SIZE ||
+	    h->record_size != sizeof(struct trace_record) ||
+	    h->n_streams == 0 || h->n_streams > TRACE_MAX_STREAMS ||
+	    trace_file_size(h->n_streams, h->capacity) >
+		    (uint64_t) st.st_size) {
+		munmap(map, (size_t) st.st_size);
+		return -EINVAL;
+	}
+
+	tf->header = h;
+	tf->records = (const struct trace_record *) ((const uint8_t *) map +
+						     TRACE_HEADER_SIZE);
+	tf->size = (size_t) st.st_size;
+	return 0;
+}
+
+static const struct trace_record *stream_records(const struct trace_file *tf,
+						 uint32_t stream,
+						 uint64_t *count) {
+	const struct trace_header *h = tf->header;
+
+	*count = h->streams[stream].count;
+	if (*count > h->capacity)
+		*count = h->capacity;
+	return tf->records + (uint64_t) stream * h->capacity;
+}
+
+static int compare_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+/* values must be sorted */
+static uint64_t percentile(const uint64_t *values, size_t count,
+			   double pct) {
+	if (count == 0)
+		return 0;
+
+	size_t rank = (size_t) ceil(pct / 100.0 * (double) count);
+	if (rank == 0)
+		rank = 1;
+	return values[rank - 1];
+}
+
+static void print_distribution(const char *label, uint64_t *values,
+			       size_t count) {
+	if (count == 0) {
+		printf("  %-18sno samples\n", label);
+		return;
+	}
+
+	qsort(values, count, sizeof(values[0]), compare_u64);
+	printf("  %-18sp50 %.2f, p99 %.2f, p99.9 %.2f, max %.2f us\n", label,
+	       percentile(values, count, 50.0) / 1000.0,
+	       percentile(values, count, 99.0) / 1000.0,
+	       percentile(values, count, 99.9) / 1000.0,
+	       values[count - 1] / 1000.0);
+}
+
+static int burst_push(struct burst_list *list, const struct burst *b) {
+	if (list->count == list->alloc) {
+		size_t alloc = list->alloc ? list->alloc * 2 : 64;
+		struct burst *items =
+			realloc(list->items, alloc * sizeof(*items));
+		if (items == NULL)
+			return -ENOMEM;
+		list->items = items;
+		list->alloc = alloc;
+	}
+	list->items[list->count++] = *b;
+	return 0;
+}
+
+static int find_bursts(const struct analyze_config *cfg, uint32_t stream,
+		       const struct trace_record *r, uint64_t count,
+		       struct burst_list *list) {
+	uint64_t gap_ns = (uint64_t) (cfg->gap_ms * 1e6);
+	struct burst cur = {0};
+	int res;
+
+	for (uint64_t i = 0; i < count; i++) {
+		if (!(r[i].flags & TRACE_LATE))
+			continue;
+
+		if (cur.late > 0 && r[i].time_ns - cur.end_ns > gap_ns) {
+			if (cur.late >= cfg->min_late &&
+			    (res = burst_push(list, &cur)) < 0)
+				return res;
+			cur.late = 0;
+		}
+		if (cur.late == 0) {
+			cur.stream = stream;
+			cur.start_ns = r[i].time_ns - r[i].interval_ns;
+			cur.worst_ns = 0;
+		}
+		cur.end_ns = r[i].time_ns;
+		cur.late++;
+		if (r[i].interval_ns > cur.worst_ns)
+			cur.worst_ns = r[i].interval_ns;
+	}
+	if (cur.late >= cfg->min_late && (res = burst_push(list, &cur)) < 0)
+		return res;
+	return 0;
+}
+
+static int compare_bursts(const void *a, const void *b) {
+	const struct burst *x = a, *y = b;
+	if (x->late != y->late)
+		return x->late < y->late ? 1 : -1;
+	return x->start_ns < y->start_ns ? -1 : x->start_ns > y->start_ns;
+}
+
+static uint64_t trace_start_ns(const struct trace_file *tf) {
+	uint64_t start = 0;
+
+	for (uint32_t i = 0; i < tf->header->n_streams; i++) {
+		uint64_t count;
+		const struct trace_record *r = stream_records(tf, i, &count);
+		if (count > 0 && (start == 0 || r[0].time_ns < start))
+			start = r[0].time_ns;
+	}
+	return start;
+}
+
+static int analyze_stream(const struct analyze_config *cfg,
+			  const struct trace_file *tf, uint32_t stream,
+			  struct burst_list *bursts) {
+	const struct trace_stream *ts = &tf->header->streams[stream];
+	uint64_t count;
+	const struct trace_record *r = stream_records(tf, stream, &count);
+	uint64_t *interval = malloc((count + 1) * sizeof(uint64_t));
+	uint64_t *busy = malloc((count + 1) * sizeof(uint64_t));
+	uint64_t *wake = malloc((count + 1) * sizeof(uint64_t));
+	uint64_t *delay = malloc((count + 1) * sizeof(uint64_t));
+	size_t n_interval = 0, n_wake = 0, n_delay = 0;
+	uint64_t late = 0, dequeue_fail = 0, null_buffer = 0;
+	int res = -ENOMEM;
+
+	if (!interval || !busy || !wake || !delay)
+		goto out;
+
+	for (uint64_t i = 0; i < count; i++) {
+		if (r[i].interval_ns > 0)
+			interval[n_interval++] = r[i].interval_ns;
+		busy[i] = r[i].busy_ns;
+		if (!(r[i].flags & TRACE_NO_TIME) && r[i].graph_ns > 0 &&
+		    r[i].time_ns >= (uint64_t) r[i].graph_ns)
+			wake[n_wake++] =
+				r[i].time_ns - (uint64_t) r[i].graph_ns;
+		if (r[i].rate_denom > 0 && r[i].delay > 0)
+			delay[n_delay++] = (uint64_t) ((double) r[i].delay *
+						       r[i].rate_num * 1e9 /
+						       r[i].rate_denom);
+		late += (r[i].flags & TRACE_LATE) != 0;
+		dequeue_fail += (r[i].flags & TRACE_DEQUEUE_FAIL) != 0;
+		null_buffer += (r[i].flags & TRACE_NULL_BUFFER) != 0;
+	}
+
+	printf("Stream %s %u:\n", ts->capture ? "in" : "out", ts->index);
+	printf("  Records:          %lu  (%lu dropped)\n",
+	       (unsigned long) count, (unsigned long) ts->dropped);
+	if (count > 1)
+		printf("  Span:             %.3f s\n",
+		       (r[count - 1].time_ns - r[0].time_ns) / 1e9);
+	print_distribution("Interval:", interval, n_interval);
+	print_distribution("Busy:", busy, (size_t) count);
+	print_distribution("Wakeup latency:", wake, n_wake);
+	print_distribution("Delay:", delay, n_delay);
+	printf("  Late cycles:      %lu\n", (unsigned long) late);
+	printf("  Dequeue failures: %lu\n", (unsigned long) dequeue_fail);
+	printf("  Null buffers:     %lu\n", (unsigned long) null_buffer);
+	printf("\n");
+
+	res = find_bursts(cfg, stream, r, count, bursts);
+out:
+	free(interval);
+	free(busy);
+	free(wake);
+	free(delay);
+	return res;
+}
+
+static void report_bursts(const struct analyze_config *cfg,
+			  const struct trace_file *tf,
+			  struct burst_list *bursts) {
+	uint64_t start = trace_start_ns(tf);
+
+	printf("Bursts (>= %u late cycles, gaps below %.0f ms):\n",
+	       cfg->min_late, cfg->gap_ms);
+	if (bursts->count == 0) {
+		printf("  none\n");
+		return;
+	}
+
+	qsort(bursts->items, bursts->count, sizeof(bursts->items[0]),
+	      compare_bursts);
+	printf("  stream    start s   length ms   late   worst us\n");
+	for (size_t i = 0; i < bursts->count && i < MAX_BURSTS_SHOWN; i++) {
+		const struct burst *b = &bursts->items[i];
+		const struct trace_stream *ts = &tf->header->streams[b->stream];
+
+		printf("  %-3s %3u  %9.3f  %10.2f  %5lu  %9.2f\n",
+		       ts->capture ? "in" : "out", ts->index,
+		       (b->start_ns - start) / 1e9,
+		       (b->end_ns - b->start_ns) / 1e6, (unsigned long) b->late,
+		       b->worst_ns / 1000.0);
+	}
+	if (bursts->count > MAX_BURSTS_SHOWN)
+		printf("  ... %zu more\n", bursts->count - MAX_BURSTS_SHOWN);
+}
+
+static int export_csv(const struct analyze_config *cfg,
+		      const struct trace_file *tf) {
+	bool to_stdout = strcmp(cfg->csv_path, "-") == 0;
+	FILE *f = to_stdout ? stdout : fopen(cfg->csv_path, "w");
+	uint64_t start = trace_start_ns(tf);
+
+	if (f == NULL)
+		return -errno;
+
+	fprintf(f, "stream,direction,time_s,interval_us,busy_us,requested,"
+		   "size,flags,graph_ns,ticks,delay,queued,rate\n");
+	for (uint32_t s = 0; s < tf->header->n_streams; s++) {
+		const struct trace_stream *ts = &tf->header->streams[s];
+		uint64_t count;
+		const struct trace_record *r = stream_records(tf, s, &count);
+
+		if (cfg->stream >= 0 && (uint32_t) cfg->stream != s)
+			continue;
+		for (uint64_t i = 0; i < count; i++)
+			fprintf(f,
+				"%u,%s,%.6f,%.3f,%.3f,%u,%u,%u,%lld,%llu,%lld,"
+				"%llu,%u/%u\n",
+				ts->index, ts->capture ? "in" : "out",
+				(r[i].time_ns - start) / 1e9,
+				r[i].interval_ns / 1000.0,
+				r[i].busy_ns / 1000.0, r[i].requested,
+				r[i].size, r[i].flags,
+				(long long) r[i].graph_ns,
+				(unsigned long long) r[i].ticks,
+				(long long) r[i].delay,
+				(unsigned long long) r[i].queued,
+				r[i].rate_num, r[i].rate_denom);
+	}
+
+	if (!to_stdout && fclose(f) != 0)
+		return -errno;
+	return 0;
+}
+
+static void print_usage(const char *prog) {
+	printf("Usage: %s [OPTIONS] TRACE\n\n", prog);
+	printf("Analyze a trace written by pipewire-xrun -T.\n\n");
+	printf("Options:\n");
+	printf("  -s STREAM      Only this stream (position in the trace, "
+	       "playback first)\n");
+	printf("  -g MS          Late cycles closer than MS belong to one "
+	       "burst (default: 1000)\n");
+	printf("  -n COUNT       Report bursts of at least COUNT late cycles "
+	       "(default: 2)\n");
+	printf("  -c FILE        Export every record as CSV ('-' for "
+	       "stdout)\n");
+	printf("  -h             Show this help message\n");
+}
+
+static int parse_args(struct analyze_config *cfg, int argc, char **argv) {
+	cfg->stream = -1;
+	cfg->gap_ms = 1000.0;
+	cfg->min_late = 2;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "s:g:n:c:h")) != -1) {
+		switch (opt) {
+		case 's':
+			cfg->stream = atoi(optarg);
+			break;
+		case 'g':
+			cfg->gap_ms = atof(optarg);
+			break;
+		case 'n':
+			cfg->min_late = (uint32_t) atoi(optarg);
+			break;
+		case 'c':
+			cfg->csv_path = optarg;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (optind != argc - 1) {
+		print_usage(argv[0]);
+		return -1;
+	}
+	cfg->path = argv[optind];
+
+	if (cfg->gap_ms <= 0 || cfg->min_late == 0) {
+		fprintf(stderr, "error: burst gap and count must be "
+				"positive\n");
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	struct analyze_config cfg = {0};
+	struct trace_file tf;
+	struct burst_list bursts = {0};
+	int res;
+
+	if (parse_args(&cfg, argc, argv) < 0)
+		return 1;
+
+	if ((res = trace_map(&tf, cfg.path)) < 0) {
+		fprintf(stderr, "error: cannot read trace %s: %s\n", cfg.path,
+			res == -EINVAL ? "not a pipewire-xrun trace"
+				       : strerror(-res));
+		return 1;
+	}
+
+	const struct trace_header *h = tf.header;
+	if (cfg.stream >= (int) h->n_streams) {
+		fprintf(stderr, "error: the trace has %u streams\n",
+			h->n_streams);
+		return 1;
+	}
+
+	/* with CSV on stdout the summary would corrupt it */
+	if (cfg.csv_path == NULL || strcmp(cfg.csv_path, "-") != 0) {
+		printf("Trace:              %s\n", cfg.path);
+		printf("Configuration:      %u Hz, quantum %u, %u channels\n",
+		       h->rate, h->quantum, h->channels);
+		printf("Period:             %.2f us  (late above %.1fx)\n",
+		       1e6 * h->quantum / h->rate, h->threshold_3);
+		printf("\n");
+
+		for (uint32_t s = 0; s < h->n_streams; s++) {
+			if (cfg.stream >= 0 && (uint32_t) cfg.stream != s)
+				continue;
+			if ((res = analyze_stream(&cfg, &tf, s, &bursts)) < 0)
+				break;
+		}
+		if (res >= 0)
+			report_bursts(&cfg, &tf, &bursts);
+	}
+
+	if (res >= 0 && cfg.csv_path && (res = export_csv(&cfg, &tf)) < 0)
+		fprintf(stderr, "error: cannot write %s: %s\n", cfg.csv_path,
+			strerror(-res));
+	else if (res < 0)
+		fprintf(stderr, "error: %s\n", strerror(-res));
+
+	free(bursts.items);
+	munmap((void *) h, tf.size);
+	return res < 0 ? 1 : 0;
+}
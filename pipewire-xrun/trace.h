@@ -0,0 +1,80 @@
+/*
+ * trace.h - per-cycle trace file written by pipewire-xrun -T and read by
+ * pipewire-xrun-analyze.
+ *
+ * The file is a page-sized header followed by one region of `capacity`
+ * fixed-size records per stream. pipewire-xrun maps it before the streams
+ * connect and the RT callback only stores into the mapping; a region that
+ * fills up stops recording and counts the dropped cycles instead. Native
+ * byte order: the analyzer runs on the machine that wrote the trace.
+ */
+
+#ifndef PIPEWIRE_XRUN_TRACE_H
+#define PIPEWIRE_XRUN_TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC "PWXTRACE"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 4096
+#define TRACE_MAX_STREAMS 128
+
+/* trace_record.flags */
+#define TRACE_LATE (1u << 0)         /* interval above threshold_3 */
+#define TRACE_DEQUEUE_FAIL (1u << 1) /* no buffer to dequeue */
+#define TRACE_NULL_BUFFER (1u << 2)  /* buffer without data */
+#define TRACE_NO_TIME (1u << 3)      /* pw_stream_get_time_n() failed */
+#define TRACE_CAPTURE (1u << 4)      /* record of a capture stream */
+
+struct trace_record {
+	/* on_process() entry, CLOCK_MONOTONIC; interval is 0 for the first
+	 * callback */
+	uint64_t time_ns;
+	uint64_t interval_ns;
+	uint32_t busy_ns;
+	/* pw_buffer.requested frames and the bytes filled or captured */
+	uint32_t requested;
+	uint32_t size;
+	uint32_t flags;
+	/* pw_time of the cycle */
+	int64_t graph_ns;
+	uint64_t ticks;
+	int64_t delay;
+	uint64_t queued;
+	uint32_t rate_num;
+	uint32_t rate_denom;
+};
+
+struct trace_stream {
+	uint32_t index;
+	uint32_t capture;
+	/* records written, updated by the RT callback after each record */
+	uint64_t count;
+	uint64_t dropped;
+};
+
+struct trace_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t record_size;
+	uint32_t n_streams;
+	/* records per stream region */
+	uint64_t capacity;
+	uint32_t rate;
+	uint32_t quantum;
+	uint32_t channels;
+	uint32_t format;
+	double threshold_3;
+	struct trace_stream streams[TRACE_MAX_STREAMS];
+};
+
+_Static_assert(sizeof(struct trace_header) <= TRACE_HEADER_SIZE,
+	       "trace header does not fit its page");
+
+static inline uint64_t trace_file_size(uint32_t n_streams, uint64_t capacity) {
+	return TRACE_HEADER_SIZE +
+	       (uint64_t) n_streams * capacity * sizeof(struct trace_record);
+}
+
+#endif
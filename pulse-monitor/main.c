@@ -2,21 +2,131 @@
 #include <pulse/pulseaudio.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #define STR_SIZE 256
+// introspection requests in flight at once; the server answers them in
+// order on the one connection, so this only bounds memory during storms
+#define MAX_INFLIGHT 128
+// default -w: change events of one object within this many ms become one
+// query and one line
+#define DEFAULT_WINDOW_MS 100
+
+// object state, as one introspection reply describes it
+
+struct sink_data {
+	char name[STR_SIZE];
+	char desc[STR_SIZE];
+	char port[STR_SIZE];
+	pa_volume_t volume;
+	int mute;
+	pa_sink_state_t state;
+};
+
+struct source_data {
+	char name[STR_SIZE];
+	char desc[STR_SIZE];
+	char port[STR_SIZE];
+	pa_volume_t volume;
+	int mute;
+	pa_source_state_t state;
+};
+
+struct si_data {
+	char name[STR_SIZE];
+	uint32_t sink;
+	uint32_t client;
+	pa_volume_t volume;
+	int mute;
+	int corked;
+};
+
+struct so_data {
+	char name[STR_SIZE];
+	uint32_t source;
+	uint32_t client;
+	pa_volume_t volume;
+	int mute;
+	int corked;
+};
+
+struct card_data {
+	char name[STR_SIZE];
+	char profile[STR_SIZE];
+	uint32_t n_profiles;
+};
+
+struct server_data {
+	char default_sink[STR_SIZE];
+	char default_source[STR_SIZE];
+};
+
+struct client_data {
+	char name[STR_SIZE];
+};
+
+struct module_data {
+	char name[STR_SIZE];
+	char argument[STR_SIZE];
+};
+
+union object_data {
+	struct sink_data sink;
+	struct source_data source;
+	struct si_data si;
+	struct so_data so;
+	struct card_data card;
+	struct server_data server;
+	struct client_data client;
+	struct module_data module;
+};
+
+// the last known state of one object; the server is kept under
+// PA_INVALID_INDEX
+struct object {
+	struct object *next;
+	uint32_t idx;
+	union object_data d;
+};
+
+// sync callback for subscribe / control ops
+
+struct sync {
+	bool done;
+	bool success;
+};
 
 // event queue
 
+// an event carries its own introspection request: the PA thread fills
+// `d` and sets `s` once the reply is complete, the main thread prints
+// events in the order they entered the pipeline as their replies come in
 struct event {
 	struct event *next;
 	int facility;
 	int type;
 	uint32_t idx;
+	// time of the last event folded into this one
 	struct timespec ts;
+	// coalescing, main thread only: change events folded into this one
+	// and the CLOCK_MONOTONIC end of its window
+	unsigned int repeat;
+	uint64_t deadline_ns;
+
+	// s.done is written under ev_mtx, d before it
+	struct sync s;
+	union object_data d;
+};
+
+// initial state requests, answered in the PA thread
+struct seed {
+	unsigned int left;
+	bool failed;
 };
 
 static pa_threaded_mainloop *mainloop;
@@ -25,10 +135,30 @@ static bool ready;
 static bool failed;
 static char errmsg[STR_SIZE];
 
-static struct event *ev_head;
-static struct event *ev_tail;
+struct ev_list {
+	struct event *head;
+	struct event *tail;
+};
+
+// subscription events, appended by the PA thread
+static struct ev_list incoming;
 static pthread_mutex_t ev_mtx = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t ev_cond = PTHREAD_COND_INITIALIZER;
+// CLOCK_MONOTONIC for the window deadlines, set up in main()
+static pthread_cond_t ev_cond;
+
+// main thread only: change events inside their coalescing window (in
+// window order), events waiting for a pipeline slot, and queried events
+// waiting to be printed (pushed under ev_mtx, the callbacks finish them)
+static struct ev_list held;
+static struct ev_list queued;
+static struct ev_list pending;
+static unsigned int n_pending;
+
+static uint64_t window_ns = DEFAULT_WINDOW_MS * 1000000ULL;
+
+// objects by facility: filled by the PA thread while main() waits for
+// the seed, main thread only afterwards
+static struct object *mirror[PA_SUBSCRIPTION_EVENT_FACILITY_MASK + 1];
 
 static volatile sig_atomic_t quit;
 
@@ -42,6 +172,44 @@ static void set_str(char *dst, const char *src) {
 	snprintf(dst, STR_SIZE, "%s", src ? src : "");
 }
 
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static void list_push(struct ev_list *l, struct event *ev) {
+	ev->next = NULL;
+	if (l->tail)
+		l->tail->next = ev;
+	else
+		l->head = ev;
+	l->tail = ev;
+}
+
+static struct event *list_pop(struct ev_list *l) {
+	struct event *ev = l->head;
+	if (!ev)
+		return NULL;
+	l->head = ev->next;
+	if (!l->head)
+		l->tail = NULL;
+	ev->next = NULL;
+	return ev;
+}
+
+// unlinks ev, found behind prev (NULL for the head)
+static void list_remove(struct ev_list *l, struct event *prev,
+			struct event *ev) {
+	if (prev)
+		prev->next = ev->next;
+	else
+		l->head = ev->next;
+	if (l->tail == ev)
+		l->tail = prev;
+	ev->next = NULL;
+}
+
 // PA callbacks
 
 static void state_cb(pa_context *ctx, void *userdata) {
@@ -74,22 +242,11 @@ static void sub_cb(pa_context *c, pa_subscription_event_type_t t, uint32_t idx,
 	clock_gettime(CLOCK_REALTIME, &ev->ts);
 
 	pthread_mutex_lock(&ev_mtx);
-	if (ev_tail)
-		ev_tail->next = ev;
-	else
-		ev_head = ev;
-	ev_tail = ev;
+	list_push(&incoming, ev);
 	pthread_cond_signal(&ev_cond);
 	pthread_mutex_unlock(&ev_mtx);
 }
 
-// sync callback for subscribe / control ops
-
-struct sync {
-	bool done;
-	bool success;
-};
-
 static void sync_cb(pa_context *c, int success, void *userdata) {
 	(void) c;
 	struct sync *s = userdata;
@@ -98,456 +255,474 @@ static void sync_cb(pa_context *c, int success, void *userdata) {
 	pa_threaded_mainloop_signal(mainloop, 0);
 }
 
-// query: sink
+// the reply of an event is complete; wakes the main thread
+static void event_done(struct event *ev) {
+	pthread_mutex_lock(&ev_mtx);
+	ev->s.done = true;
+	pthread_cond_signal(&ev_cond);
+	pthread_mutex_unlock(&ev_mtx);
+}
 
-struct sink_data {
-	char name[STR_SIZE];
-	char desc[STR_SIZE];
-	char port[STR_SIZE];
-	pa_volume_t volume;
-	int mute;
-	pa_sink_state_t state;
-};
+// list callbacks: eol < 0 is an error, eol > 0 the end of the reply
+static bool query_eol(struct event *ev, int eol) {
+	if (eol == 0)
+		return false;
+	if (eol < 0)
+		ev->s.success = false;
+	event_done(ev);
+	return true;
+}
 
-struct sink_query {
-	struct sync s;
-	struct sink_data d;
-};
+// object state from introspection replies
 
-static void sk_cb(pa_context *c, const pa_sink_info *i, int eol, void *ud) {
-	(void) c;
-	struct sink_query *q = ud;
-	if (eol < 0) {
-		q->s.success = false;
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
-		return;
-	}
-	if (eol > 0) {
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
-		return;
-	}
-	if (!i)
-		return;
-	q->s.success = true;
-	set_str(q->d.name, i->name);
-	set_str(q->d.desc, i->description);
-	q->d.volume = pa_cvolume_avg(&i->volume);
-	q->d.mute = i->mute;
-	q->d.state = i->state;
-	set_str(q->d.port, i->active_port ? i->active_port->name : NULL);
+static void sink_fill(struct sink_data *d, const pa_sink_info *i) {
+	set_str(d->name, i->name);
+	set_str(d->desc, i->description);
+	d->volume = pa_cvolume_avg(&i->volume);
+	d->mute = i->mute;
+	d->state = i->state;
+	set_str(d->port, i->active_port ? i->active_port->name : NULL);
 }
 
-static bool query_sink(uint32_t idx, struct sink_data *d) {
-	struct sink_query q = {0};
-	pa_threaded_mainloop_lock(mainloop);
-	pa_operation *op =
-		pa_context_get_sink_info_by_index(context, idx, sk_cb, &q);
-	if (!op) {
-		pa_threaded_mainloop_unlock(mainloop);
-		return false;
-	}
-	while (!q.s.done)
-		pa_threaded_mainloop_wait(mainloop);
-	pa_threaded_mainloop_unlock(mainloop);
-	pa_operation_unref(op);
-	if (q.s.success)
-		*d = q.d;
-	return q.s.success;
+static void source_fill(struct source_data *d, const pa_source_info *i) {
+	set_str(d->name, i->name);
+	set_str(d->desc, i->description);
+	d->volume = pa_cvolume_avg(&i->volume);
+	d->mute = i->mute;
+	d->state = i->state;
+	set_str(d->port, i->active_port ? i->active_port->name : NULL);
 }
 
-// query: source
-
-struct source_data {
-	char name[STR_SIZE];
-	char desc[STR_SIZE];
-	char port[STR_SIZE];
-	pa_volume_t volume;
-	int mute;
-	pa_source_state_t state;
-};
+static void si_fill(struct si_data *d, const pa_sink_input_info *i) {
+	set_str(d->name, i->name);
+	d->sink = i->sink;
+	d->client = i->client;
+	d->volume = pa_cvolume_avg(&i->volume);
+	d->mute = i->mute;
+	d->corked = i->corked;
+}
 
-struct source_query {
-	struct sync s;
-	struct source_data d;
-};
+static void so_fill(struct so_data *d, const pa_source_output_info *i) {
+	set_str(d->name, i->name);
+	d->source = i->source;
+	d->client = i->client;
+	d->volume = pa_cvolume_avg(&i->volume);
+	d->mute = i->mute;
+	d->corked = i->corked;
+}
 
-static void source_cb(pa_context *c, const pa_source_info *i, int eol,
-		      void *ud) {
-	(void) c;
-	struct source_query *q = ud;
-	if (eol < 0) {
-		q->s.success = false;
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
-		return;
-	}
-	if (eol > 0) {
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
-		return;
+static void card_fill(struct card_data *d, const pa_card_info *i) {
+	set_str(d->name, i->name);
+	set_str(d->profile,
+		i->active_profile2 ? i->active_profile2->name : NULL);
+	uint32_t n = 0;
+	if (i->profiles2) {
+		for (pa_card_profile_info2 **p = i->profiles2; *p; p++) {
+			if ((*p)->available == 0)
+				continue;
+			const char *name = (*p)->name;
+			if (strcmp(name, "off") == 0 ||
+			    strcmp(name, "pro-audio") == 0)
+				continue;
+			n++;
+		}
 	}
-	if (!i)
-		return;
-	q->s.success = true;
-	set_str(q->d.name, i->name);
-	set_str(q->d.desc, i->description);
-	q->d.volume = pa_cvolume_avg(&i->volume);
-	q->d.mute = i->mute;
-	q->d.state = i->state;
-	set_str(q->d.port, i->active_port ? i->active_port->name : NULL);
+	d->n_profiles = n;
 }
 
-static bool query_source(uint32_t idx, struct source_data *d) {
-	struct source_query q = {0};
-	pa_threaded_mainloop_lock(mainloop);
-	pa_operation *op = pa_context_get_source_info_by_index(context, idx,
-							       source_cb, &q);
-	if (!op) {
-		pa_threaded_mainloop_unlock(mainloop);
-		return false;
-	}
-	while (!q.s.done)
-		pa_threaded_mainloop_wait(mainloop);
-	pa_threaded_mainloop_unlock(mainloop);
-	pa_operation_unref(op);
-	if (q.s.success)
-		*d = q.d;
-	return q.s.success;
+static void server_fill(struct server_data *d, const pa_server_info *i) {
+	set_str(d->default_sink, i->default_sink_name);
+	set_str(d->default_source, i->default_source_name);
 }
 
-// query: sink input
+static void client_fill(struct client_data *d, const pa_client_info *i) {
+	set_str(d->name, i->name);
+}
 
-struct si_data {
-	char name[STR_SIZE];
-	uint32_t sink;
-	uint32_t client;
-	pa_volume_t volume;
-	int mute;
-	int corked;
-};
+static void module_fill(struct module_data *d, const pa_module_info *i) {
+	set_str(d->name, i->name);
+	set_str(d->argument, i->argument);
+}
 
-struct si_query {
-	struct sync s;
-	struct si_data d;
-};
+// query: one object per event
 
-static void si_cb(pa_context *c, const pa_sink_input_info *i, int eol,
-		  void *ud) {
+static void sk_cb(pa_context *c, const pa_sink_info *i, int eol, void *ud) {
 	(void) c;
-	struct si_query *q = ud;
-	if (eol < 0) {
-		q->s.success = false;
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
-		return;
-	}
-	if (eol > 0) {
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
-		return;
-	}
-	if (!i)
+	struct event *ev = ud;
+	if (query_eol(ev, eol) || !i)
 		return;
-	q->s.success = true;
-	set_str(q->d.name, i->name);
-	q->d.sink = i->sink;
-	q->d.client = i->client;
-	q->d.volume = pa_cvolume_avg(&i->volume);
-	q->d.mute = i->mute;
-	q->d.corked = i->corked;
+	ev->s.success = true;
+	sink_fill(&ev->d.sink, i);
 }
 
-static bool query_si(uint32_t idx, struct si_data *d) {
-	struct si_query q = {0};
-	pa_threaded_mainloop_lock(mainloop);
-	pa_operation *op =
-		pa_context_get_sink_input_info(context, idx, si_cb, &q);
-	if (!op) {
-		pa_threaded_mainloop_unlock(mainloop);
-		return false;
-	}
-	while (!q.s.done)
-		pa_threaded_mainloop_wait(mainloop);
-	pa_threaded_mainloop_unlock(mainloop);
-	pa_operation_unref(op);
-	if (q.s.success)
-		*d = q.d;
-	return q.s.success;
+static void source_cb(pa_context *c, const pa_source_info *i, int eol,
+		      void *ud) {
+	(void) c;
+	struct event *ev = ud;
+	if (query_eol(ev, eol) || !i)
+		return;
+	ev->s.success = true;
+	source_fill(&ev->d.source, i);
 }
 
-// query: source output
-
-struct so_data {
-	char name[STR_SIZE];
-	uint32_t source;
-	uint32_t client;
-	pa_volume_t volume;
-	int mute;
-	int corked;
-};
-
-struct so_query {
-	struct sync s;
-	struct so_data d;
-};
+static void si_cb(pa_context *c, const pa_sink_input_info *i, int eol,
+		  void *ud) {
+	(void) c;
+	struct event *ev = ud;
+	if (query_eol(ev, eol) || !i)
+		return;
+	ev->s.success = true;
+	si_fill(&ev->d.si, i);
+}
 
 static void so_cb(pa_context *c, const pa_source_output_info *i, int eol,
 		  void *ud) {
 	(void) c;
-	struct so_query *q = ud;
-	if (eol < 0) {
-		q->s.success = false;
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
+	struct event *ev = ud;
+	if (query_eol(ev, eol) || !i)
 		return;
-	}
-	if (eol > 0) {
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
+	ev->s.success = true;
+	so_fill(&ev->d.so, i);
+}
+
+static void card_cb(pa_context *c, const pa_card_info *i, int eol, void *ud) {
+	(void) c;
+	struct event *ev = ud;
+	if (query_eol(ev, eol) || !i)
 		return;
+	ev->s.success = true;
+	card_fill(&ev->d.card, i);
+}
+
+static void server_cb2(pa_context *c, const pa_server_info *i, void *ud) {
+	(void) c;
+	struct event *ev = ud;
+	if (i) {
+		ev->s.success = true;
+		server_fill(&ev->d.server, i);
 	}
-	if (!i)
+	event_done(ev);
+}
+
+static void client_cb(pa_context *c, const pa_client_info *i, int eol,
+		      void *ud) {
+	(void) c;
+	struct event *ev = ud;
+	if (query_eol(ev, eol) || !i)
 		return;
-	q->s.success = true;
-	set_str(q->d.name, i->name);
-	q->d.source = i->source;
-	q->d.client = i->client;
-	q->d.volume = pa_cvolume_avg(&i->volume);
-	q->d.mute = i->mute;
-	q->d.corked = i->corked;
+	ev->s.success = true;
+	client_fill(&ev->d.client, i);
 }
 
-static bool query_so(uint32_t idx, struct so_data *d) {
-	struct so_query q = {0};
-	pa_threaded_mainloop_lock(mainloop);
-	pa_operation *op =
-		pa_context_get_source_output_info(context, idx, so_cb, &q);
-	if (!op) {
-		pa_threaded_mainloop_unlock(mainloop);
-		return false;
+static void module_cb(pa_context *c, const pa_module_info *i, int eol,
+		      void *ud) {
+	(void) c;
+	struct event *ev = ud;
+	if (query_eol(ev, eol) || !i)
+		return;
+	ev->s.success = true;
+	module_fill(&ev->d.module, i);
+}
+
+// mirror
+
+// the link that holds the object, or the NULL one at the end
+static struct object **mirror_slot(int fac, uint32_t idx) {
+	struct object **o = &mirror[fac & PA_SUBSCRIPTION_EVENT_FACILITY_MASK];
+	while (*o && (*o)->idx != idx)
+		o = &(*o)->next;
+	return o;
+}
+
+// an object that cannot be allocated is printed in full on its next
+// change instead of as a diff
+static void mirror_put(int fac, uint32_t idx, const union object_data *d) {
+	struct object **o = mirror_slot(fac, idx);
+	if (!*o) {
+		*o = calloc(1, sizeof(**o));
+		if (!*o)
+			return;
+		(*o)->idx = idx;
 	}
-	while (!q.s.done)
-		pa_threaded_mainloop_wait(mainloop);
-	pa_threaded_mainloop_unlock(mainloop);
-	pa_operation_unref(op);
-	if (q.s.success)
-		*d = q.d;
-	return q.s.success;
+	(*o)->d = *d;
 }
 
-// query: card
+static void mirror_drop(struct object **o) {
+	struct object *obj = *o;
+	*o = obj->next;
+	free(obj);
+}
 
-struct card_data {
-	char name[STR_SIZE];
-	char profile[STR_SIZE];
-	uint32_t n_profiles;
-};
+static void mirror_free(void) {
+	for (size_t f = 0; f < sizeof(mirror) / sizeof(mirror[0]); f++) {
+		while (mirror[f])
+			mirror_drop(&mirror[f]);
+	}
+}
 
-struct card_query {
-	struct sync s;
-	struct card_data d;
-};
+// seed: every object once, before the first event is printed
 
-static void card_cb(pa_context *c, const pa_card_info *i, int eol, void *ud) {
+// eol < 0 is an error, eol > 0 the end of the list
+static bool seed_eol(struct seed *s, int eol) {
+	if (eol == 0)
+		return false;
+	if (eol < 0)
+		s->failed = true;
+	s->left--;
+	pa_threaded_mainloop_signal(mainloop, 0);
+	return true;
+}
+
+static void sk_list_cb(pa_context *c, const pa_sink_info *i, int eol,
+		       void *ud) {
 	(void) c;
-	struct card_query *q = ud;
-	if (eol < 0) {
-		q->s.success = false;
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
+	union object_data d;
+	if (seed_eol(ud, eol) || !i)
 		return;
-	}
-	if (eol > 0) {
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
-		return;
-	}
-	if (!i)
+	sink_fill(&d.sink, i);
+	mirror_put(PA_SUBSCRIPTION_EVENT_SINK, i->index, &d);
+}
+
+static void source_list_cb(pa_context *c, const pa_source_info *i, int eol,
+			   void *ud) {
+	(void) c;
+	union object_data d;
+	if (seed_eol(ud, eol) || !i)
 		return;
-	q->s.success = true;
-	set_str(q->d.name, i->name);
-	set_str(q->d.profile,
-		i->active_profile2 ? i->active_profile2->name : NULL);
-	uint32_t n = 0;
-	if (i->profiles2) {
-		for (pa_card_profile_info2 **p = i->profiles2; *p; p++) {
-			if ((*p)->available == 0)
-				continue;
-			const char *name = (*p)->name;
-			if (strcmp(name, "off") == 0 ||
-			    strcmp(name, "pro-audio") == 0)
-				continue;
-			n++;
-		}
-	}
-	q->d.n_profiles = n;
+	source_fill(&d.source, i);
+	mirror_put(PA_SUBSCRIPTION_EVENT_SOURCE, i->index, &d);
+}
+
+static void si_list_cb(pa_context *c, const pa_sink_input_info *i, int eol,
+		       void *ud) {
+	(void) c;
+	union object_data d;
+	if (seed_eol(ud, eol) || !i)
+		return;
+	si_fill(&d.si, i);
+	mirror_put(PA_SUBSCRIPTION_EVENT_SINK_INPUT, i->index, &d);
 }
 
-static bool query_card(uint32_t idx, struct card_data *d) {
-	struct card_query q = {0};
-	pa_threaded_mainloop_lock(mainloop);
-	pa_operation *op =
-		pa_context_get_card_info_by_index(context, idx, card_cb, &q);
-	if (!op) {
-		pa_threaded_mainloop_unlock(mainloop);
-		return false;
-	}
-	while (!q.s.done)
-		pa_threaded_mainloop_wait(mainloop);
-	pa_threaded_mainloop_unlock(mainloop);
-	pa_operation_unref(op);
-	if (q.s.success)
-		*d = q.d;
-	return q.s.success;
+static void so_list_cb(pa_context *c, const pa_source_output_info *i,
+		       int eol, void *ud) {
+	(void) c;
+	union object_data d;
+	if (seed_eol(ud, eol) || !i)
+		return;
+	so_fill(&d.so, i);
+	mirror_put(PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT, i->index, &d);
 }
 
-// query: server
+static void card_list_cb(pa_context *c, const pa_card_info *i, int eol,
+			 void *ud) {
+	(void) c;
+	union object_data d;
+	if (seed_eol(ud, eol) || !i)
+		return;
+	card_fill(&d.card, i);
+	mirror_put(PA_SUBSCRIPTION_EVENT_CARD, i->index, &d);
+}
 
-struct server_data {
-	char default_sink[STR_SIZE];
-	char default_source[STR_SIZE];
-};
+static void server_seed_cb(pa_context *c, const pa_server_info *i,
+			   void *ud) {
+	(void) c;
+	union object_data d;
+	if (i) {
+		server_fill(&d.server, i);
+		mirror_put(PA_SUBSCRIPTION_EVENT_SERVER, PA_INVALID_INDEX, &d);
+	}
+	seed_eol(ud, i ? 1 : -1);
+}
 
-struct server_query {
-	struct sync s;
-	struct server_data d;
-};
+static void client_list_cb(pa_context *c, const pa_client_info *i, int eol,
+			   void *ud) {
+	(void) c;
+	union object_data d;
+	if (seed_eol(ud, eol) || !i)
+		return;
+	client_fill(&d.client, i);
+	mirror_put(PA_SUBSCRIPTION_EVENT_CLIENT, i->index, &d);
+}
 
-static void server_cb2(pa_context *c, const pa_server_info *i, void *ud) {
+static void module_list_cb(pa_context *c, const pa_module_info *i, int eol,
+			   void *ud) {
 	(void) c;
-	struct server_query *q = ud;
-	if (!i) {
-		q->s.success = false;
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
+	union object_data d;
+	if (seed_eol(ud, eol) || !i)
 		return;
-	}
-	q->s.success = true;
-	set_str(q->d.default_sink, i->default_sink_name);
-	set_str(q->d.default_source, i->default_source_name);
-	q->s.done = true;
-	pa_threaded_mainloop_signal(mainloop, 0);
+	module_fill(&d.module, i);
+	mirror_put(PA_SUBSCRIPTION_EVENT_MODULE, i->index, &d);
 }
 
-static bool query_server(struct server_data *d) {
-	struct server_query q = {0};
+// sends all list requests at once and waits for the replies; called
+// after subscribing, so events racing the seed are queried after it
+static void seed(void) {
+	struct seed s = {0};
+	pa_operation *ops[8];
+	unsigned int n = 0;
+
 	pa_threaded_mainloop_lock(mainloop);
-	pa_operation *op = pa_context_get_server_info(context, server_cb2, &q);
-	if (!op) {
-		pa_threaded_mainloop_unlock(mainloop);
-		return false;
+	ops[n++] = pa_context_get_sink_info_list(context, sk_list_cb, &s);
+	ops[n++] =
+		pa_context_get_source_info_list(context, source_list_cb, &s);
+	ops[n++] =
+		pa_context_get_sink_input_info_list(context, si_list_cb, &s);
+	ops[n++] = pa_context_get_source_output_info_list(context,
+							  so_list_cb, &s);
+	ops[n++] = pa_context_get_card_info_list(context, card_list_cb, &s);
+	ops[n++] = pa_context_get_server_info(context, server_seed_cb, &s);
+	ops[n++] =
+		pa_context_get_client_info_list(context, client_list_cb, &s);
+	ops[n++] =
+		pa_context_get_module_info_list(context, module_list_cb, &s);
+	for (unsigned int k = 0; k < n; k++) {
+		if (ops[k])
+			s.left++;
+		else
+			s.failed = true;
 	}
-	while (!q.s.done)
+	while (s.left > 0)
 		pa_threaded_mainloop_wait(mainloop);
 	pa_threaded_mainloop_unlock(mainloop);
-	pa_operation_unref(op);
-	if (q.s.success)
-		*d = q.d;
-	return q.s.success;
+
+	for (unsigned int k = 0; k < n; k++) {
+		if (ops[k])
+			pa_operation_unref(ops[k]);
+	}
+	if (s.failed)
+		fprintf(stderr, "warning: initial state incomplete, the "
+				"first change of an unknown object prints "
+				"its full state\n");
 }
 
-// query: client
+// pipeline
 
-struct client_data {
-	char name[STR_SIZE];
-};
+// mainloop locked; NULL when the event needs no reply or the request
+// could not be sent
+static pa_operation *query_start(struct event *ev) {
+	uint32_t idx = ev->idx;
 
-struct client_query {
-	struct sync s;
-	struct client_data d;
-};
+	if (ev->type == PA_SUBSCRIPTION_EVENT_REMOVE)
+		return NULL;
 
-static void client_cb(pa_context *c, const pa_client_info *i, int eol,
-		      void *ud) {
-	(void) c;
-	struct client_query *q = ud;
-	if (eol < 0) {
-		q->s.success = false;
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
-		return;
-	}
-	if (eol > 0) {
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
-		return;
+	switch (ev->facility) {
+	case PA_SUBSCRIPTION_EVENT_SINK:
+		return pa_context_get_sink_info_by_index(context, idx, sk_cb,
+							 ev);
+	case PA_SUBSCRIPTION_EVENT_SOURCE:
+		return pa_context_get_source_info_by_index(context, idx,
+							   source_cb, ev);
+	case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+		return pa_context_get_sink_input_info(context, idx, si_cb, ev);
+	case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+		return pa_context_get_source_output_info(context, idx, so_cb,
+							 ev);
+	case PA_SUBSCRIPTION_EVENT_CARD:
+		return pa_context_get_card_info_by_index(context, idx, card_cb,
+							 ev);
+	case PA_SUBSCRIPTION_EVENT_SERVER:
+		return pa_context_get_server_info(context, server_cb2, ev);
+	case PA_SUBSCRIPTION_EVENT_CLIENT:
+		return pa_context_get_client_info(context, idx, client_cb, ev);
+	case PA_SUBSCRIPTION_EVENT_MODULE:
+		return pa_context_get_module_info(context, idx, module_cb, ev);
+	default:
+		return NULL;
 	}
-	if (!i)
-		return;
-	q->s.success = true;
-	set_str(q->d.name, i->name);
 }
 
-static bool query_client(uint32_t idx, struct client_data *d) {
-	struct client_query q = {0};
+// sends the requests of every queued event that fits into the pipeline
+// under one lock, without waiting for any reply
+static void query_queued(void) {
+	if (!queued.head || n_pending == MAX_INFLIGHT)
+		return;
+
 	pa_threaded_mainloop_lock(mainloop);
-	pa_operation *op =
-		pa_context_get_client_info(context, idx, client_cb, &q);
-	if (!op) {
-		pa_threaded_mainloop_unlock(mainloop);
-		return false;
+	while (queued.head && n_pending < MAX_INFLIGHT) {
+		struct event *ev = list_pop(&queued);
+
+		pa_operation *op = query_start(ev);
+		if (op)
+			pa_operation_unref(op);
+		else
+			ev->s.done = true;
+
+		// the callbacks only touch ev->s under ev_mtx
+		pthread_mutex_lock(&ev_mtx);
+		list_push(&pending, ev);
+		pthread_mutex_unlock(&ev_mtx);
+		n_pending++;
 	}
-	while (!q.s.done)
-		pa_threaded_mainloop_wait(mainloop);
 	pa_threaded_mainloop_unlock(mainloop);
-	pa_operation_unref(op);
-	if (q.s.success)
-		*d = q.d;
-	return q.s.success;
 }
 
-// query: module
+// coalescing
 
-struct module_data {
-	char name[STR_SIZE];
-	char argument[STR_SIZE];
-};
+static bool same_object(const struct event *a, const struct event *b) {
+	return a->facility == b->facility && a->idx == b->idx;
+}
 
-struct module_query {
-	struct sync s;
-	struct module_data d;
-};
+// a change joins the open window of its object or opens one; new and
+// remove events first close the window of their object, so they never
+// overtake a change of the same object
+static void coalesce(struct event *ev, uint64_t now) {
+	struct event *prev = NULL, *h = held.head;
 
-static void module_cb(pa_context *c, const pa_module_info *i, int eol,
-		      void *ud) {
-	(void) c;
-	struct module_query *q = ud;
-	if (eol < 0) {
-		q->s.success = false;
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
+	ev->repeat = 1;
+	if (window_ns == 0) {
+		list_push(&queued, ev);
 		return;
 	}
-	if (eol > 0) {
-		q->s.done = true;
-		pa_threaded_mainloop_signal(mainloop, 0);
-		return;
+
+	while (h && !same_object(h, ev)) {
+		prev = h;
+		h = h->next;
 	}
-	if (!i)
+
+	if (ev->type == PA_SUBSCRIPTION_EVENT_CHANGE) {
+		if (h) {
+			h->repeat++;
+			h->ts = ev->ts;
+			free(ev);
+		} else {
+			ev->deadline_ns = now + window_ns;
+			list_push(&held, ev);
+		}
 		return;
-	q->s.success = true;
-	set_str(q->d.name, i->name);
-	set_str(q->d.argument, i->argument);
+	}
+
+	if (h) {
+		list_remove(&held, prev, h);
+		list_push(&queued, h);
+	}
+	list_push(&queued, ev);
 }
 
-static bool query_module(uint32_t idx, struct module_data *d) {
-	struct module_query q = {0};
-	pa_threaded_mainloop_lock(mainloop);
-	pa_operation *op =
-		pa_context_get_module_info(context, idx, module_cb, &q);
-	if (!op) {
-		pa_threaded_mainloop_unlock(mainloop);
-		return false;
+// windows open in deadline order: the expired ones are at the head
+static void flush_held(uint64_t now) {
+	while (held.head && held.head->deadline_ns <= now)
+		list_push(&queued, list_pop(&held));
+}
+
+// ev_mtx locked
+static bool work_ready(uint64_t now) {
+	return incoming.head || (queued.head && n_pending < MAX_INFLIGHT) ||
+	       (pending.head && pending.head->s.done) ||
+	       (held.head && held.head->deadline_ns <= now);
+}
+
+// ev_mtx locked: sleeps until the PA thread or a signal wakes us, or
+// the oldest window closes
+static void wait_work(void) {
+	if (!held.head) {
+		pthread_cond_wait(&ev_cond, &ev_mtx);
+		return;
 	}
-	while (!q.s.done)
-		pa_threaded_mainloop_wait(mainloop);
-	pa_threaded_mainloop_unlock(mainloop);
-	pa_operation_unref(op);
-	if (q.s.success)
-		*d = q.d;
-	return q.s.success;
+	struct timespec ts = {
+		.tv_sec = (time_t) (held.head->deadline_ns / 1000000000ULL),
+		.tv_nsec = (long) (held.head->deadline_ns % 1000000000ULL),
+	};
+	pthread_cond_timedwait(&ev_cond, &ev_mtx, &ts);
 }
 
 // output
@@ -628,129 +803,274 @@ static void print_idx(uint32_t idx) {
 		printf("#%-5u", idx);
 }
 
-static void process_event(struct event *ev) {
-	int fac = ev->facility;
-	int typ = ev->type;
-	uint32_t idx = ev->idx;
-
-	print_time(&ev->ts);
-	printf(" %-6s %-13s ", type_str(typ), facility_str(fac));
-	print_idx(idx);
-
-	if (typ == PA_SUBSCRIPTION_EVENT_REMOVE) {
-		printf(" (deleted)\n");
-		fflush(stdout);
-		return;
+// the name an object is known by
+static void print_label(int fac, const union object_data *d) {
+	switch (fac) {
+	case PA_SUBSCRIPTION_EVENT_SINK:
+		printf(" [%s]", d->sink.desc);
+		break;
+	case PA_SUBSCRIPTION_EVENT_SOURCE:
+		printf(" [%s]", d->source.desc);
+		break;
+	case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+		printf(" [%s]", d->si.name);
+		break;
+	case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+		printf(" [%s]", d->so.name);
+		break;
+	case PA_SUBSCRIPTION_EVENT_CARD:
+		printf(" [%s]", d->card.name);
+		break;
+	case PA_SUBSCRIPTION_EVENT_SERVER:
+		printf(" (default)");
+		break;
+	case PA_SUBSCRIPTION_EVENT_CLIENT:
+		printf(" [%s]", d->client.name);
+		break;
+	case PA_SUBSCRIPTION_EVENT_MODULE:
+		printf(" [%s]", d->module.name);
+		break;
+	default:
+		break;
 	}
+}
 
+// the full state, after the label
+static void print_fields(int fac, const union object_data *d) {
 	switch (fac) {
-	case PA_SUBSCRIPTION_EVENT_SINK: {
-		struct sink_data d;
-		if (query_sink(idx, &d)) {
-			printf(" [%s]", d.desc);
-			printf(" %3d%% %s", vol_pct(d.volume),
-			       d.mute ? "  muted" : "unmuted");
-			if (d.port[0])
-				printf(" port:%s", d.port);
-			printf(" state:%s", sink_state_name(d.state));
-		} else {
-			printf(" (deleted)");
-		}
+	case PA_SUBSCRIPTION_EVENT_SINK:
+		printf(" %3d%% %s", vol_pct(d->sink.volume),
+		       d->sink.mute ? "  muted" : "unmuted");
+		if (d->sink.port[0])
+			printf(" port:%s", d->sink.port);
+		printf(" state:%s", sink_state_name(d->sink.state));
 		break;
-	}
-	case PA_SUBSCRIPTION_EVENT_SOURCE: {
-		struct source_data d;
-		if (query_source(idx, &d)) {
-			printf(" [%s]", d.desc);
-			if (d.port[0])
-				printf(" port:%s", d.port);
-			printf(" %3d%% %s state:%s", vol_pct(d.volume),
-			       d.mute ? "  muted" : "unmuted",
-			       source_state_name(d.state));
-		} else {
-			printf(" (deleted)");
-		}
+	case PA_SUBSCRIPTION_EVENT_SOURCE:
+		if (d->source.port[0])
+			printf(" port:%s", d->source.port);
+		printf(" %3d%% %s state:%s", vol_pct(d->source.volume),
+		       d->source.mute ? "  muted" : "unmuted",
+		       source_state_name(d->source.state));
 		break;
-	}
-	case PA_SUBSCRIPTION_EVENT_SINK_INPUT: {
-		struct si_data d;
-		if (query_si(idx, &d)) {
-			printf(" [%s]", d.name);
-			printf(" %3d%% %s %s", vol_pct(d.volume),
-			       d.mute ? "  muted" : "unmuted",
-			       d.corked ? "  corked" : "uncorked");
-			printf(" client");
-			print_idx(d.client);
-			printf(" sink");
-			print_idx(d.sink);
-		} else {
-			printf(" (deleted)");
-		}
+	case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+		printf(" %3d%% %s %s", vol_pct(d->si.volume),
+		       d->si.mute ? "  muted" : "unmuted",
+		       d->si.corked ? "  corked" : "uncorked");
+		printf(" client");
+		print_idx(d->si.client);
+		printf(" sink");
+		print_idx(d->si.sink);
 		break;
-	}
-	case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT: {
-		struct so_data d;
-		if (query_so(idx, &d)) {
-			printf(" [%s]", d.name);
-			printf(" %3d%% %s %s", vol_pct(d.volume),
-			       d.mute ? "  muted" : "unmuted",
-			       d.corked ? "  corked" : "uncorked");
-			printf(" client");
-			print_idx(d.client);
-			printf(" source");
-			print_idx(d.source);
-		} else {
-			printf(" (deleted)");
-		}
+	case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+		printf(" %3d%% %s %s", vol_pct(d->so.volume),
+		       d->so.mute ? "  muted" : "unmuted",
+		       d->so.corked ? "  corked" : "uncorked");
+		printf(" client");
+		print_idx(d->so.client);
+		printf(" source");
+		print_idx(d->so.source);
 		break;
-	}
-	case PA_SUBSCRIPTION_EVENT_CARD: {
-		struct card_data d;
-		if (query_card(idx, &d)) {
-			printf(" [%s]", d.name);
-			if (d.profile[0])
-				printf(" profile:%s (%u)", d.profile,
-				       d.n_profiles);
-		} else {
-			printf(" (deleted)");
-		}
+	case PA_SUBSCRIPTION_EVENT_CARD:
+		if (d->card.profile[0])
+			printf(" profile:%s (%u)", d->card.profile,
+			       d->card.n_profiles);
 		break;
-	}
-	case PA_SUBSCRIPTION_EVENT_SERVER: {
-		struct server_data d;
-		if (query_server(&d)) {
-			printf(" (default)");
-			printf(" sink:%s", d.default_sink);
-			printf(" source:%s", d.default_source);
-		} else {
-			printf(" (query failed)");
-		}
+	case PA_SUBSCRIPTION_EVENT_SERVER:
+		printf(" sink:%s", d->server.default_sink);
+		printf(" source:%s", d->server.default_source);
 		break;
-	}
-	case PA_SUBSCRIPTION_EVENT_CLIENT: {
-		struct client_data d;
-		if (query_client(idx, &d)) {
-			printf(" [%s]", d.name);
-		} else {
-			printf(" (deleted)");
-		}
+	case PA_SUBSCRIPTION_EVENT_MODULE:
+		if (d->module.argument[0])
+			printf(" %s", d->module.argument);
 		break;
-	}
-	case PA_SUBSCRIPTION_EVENT_MODULE: {
-		struct module_data d;
-		if (query_module(idx, &d)) {
-			printf(" [%s]", d.name);
-			if (d.argument[0])
-				printf(" %s", d.argument);
-		} else {
-			printf(" (deleted)");
-		}
+	default:
 		break;
 	}
+}
+
+// diff: each prints " field old→new" and returns true when the field
+// changed
+
+static bool diff_str(const char *field, const char *a, const char *b) {
+	if (strcmp(a, b) == 0)
+		return false;
+	printf(" %s %s→%s", field, a[0] ? a : "-", b[0] ? b : "-");
+	return true;
+}
+
+static bool diff_volume(pa_volume_t a, pa_volume_t b) {
+	if (vol_pct(a) == vol_pct(b))
+		return false;
+	printf(" volume %d%%→%d%%", vol_pct(a), vol_pct(b));
+	return true;
+}
+
+static bool diff_flag(int a, int b, const char *off, const char *on) {
+	if (!a == !b)
+		return false;
+	printf(" %s→%s", a ? on : off, b ? on : off);
+	return true;
+}
+
+static bool diff_idx(const char *field, uint32_t a, uint32_t b) {
+	if (a == b)
+		return false;
+	printf(" %s ", field);
+	if (a == PA_INVALID_INDEX)
+		printf("#-");
+	else
+		printf("#%u", a);
+	if (b == PA_INVALID_INDEX)
+		printf("→#-");
+	else
+		printf("→#%u", b);
+	return true;
+}
+
+static bool diff_uint(const char *field, uint32_t a, uint32_t b) {
+	if (a == b)
+		return false;
+	printf(" %s %u→%u", field, a, b);
+	return true;
+}
+
+static bool print_diff(int fac, const union object_data *a,
+		       const union object_data *b) {
+	bool changed = false;
+
+	switch (fac) {
+	case PA_SUBSCRIPTION_EVENT_SINK:
+		changed |= diff_str("desc", a->sink.desc, b->sink.desc);
+		changed |= diff_volume(a->sink.volume, b->sink.volume);
+		changed |= diff_flag(a->sink.mute, b->sink.mute, "unmuted",
+				     "muted");
+		changed |= diff_str("port", a->sink.port, b->sink.port);
+		changed |= diff_str("state", sink_state_name(a->sink.state),
+				    sink_state_name(b->sink.state));
+		break;
+	case PA_SUBSCRIPTION_EVENT_SOURCE:
+		changed |= diff_str("desc", a->source.desc, b->source.desc);
+		changed |= diff_str("port", a->source.port, b->source.port);
+		changed |= diff_volume(a->source.volume, b->source.volume);
+		changed |= diff_flag(a->source.mute, b->source.mute,
+				     "unmuted", "muted");
+		changed |= diff_str("state",
+				    source_state_name(a->source.state),
+				    source_state_name(b->source.state));
+		break;
+	case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+		changed |= diff_str("name", a->si.name, b->si.name);
+		changed |= diff_volume(a->si.volume, b->si.volume);
+		changed |= diff_flag(a->si.mute, b->si.mute, "unmuted",
+				     "muted");
+		changed |= diff_flag(a->si.corked, b->si.corked, "uncorked",
+				     "corked");
+		changed |= diff_idx("client", a->si.client, b->si.client);
+		changed |= diff_idx("sink", a->si.sink, b->si.sink);
+		break;
+	case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+		changed |= diff_str("name", a->so.name, b->so.name);
+		changed |= diff_volume(a->so.volume, b->so.volume);
+		changed |= diff_flag(a->so.mute, b->so.mute, "unmuted",
+				     "muted");
+		changed |= diff_flag(a->so.corked, b->so.corked, "uncorked",
+				     "corked");
+		changed |= diff_idx("client", a->so.client, b->so.client);
+		changed |= diff_idx("source", a->so.source, b->so.source);
+		break;
+	case PA_SUBSCRIPTION_EVENT_CARD:
+		changed |= diff_str("name", a->card.name, b->card.name);
+		changed |= diff_str("profile", a->card.profile,
+				    b->card.profile);
+		changed |= diff_uint("profiles", a->card.n_profiles,
+				     b->card.n_profiles);
+		break;
+	case PA_SUBSCRIPTION_EVENT_SERVER:
+		changed |= diff_str("sink", a->server.default_sink,
+				    b->server.default_sink);
+		changed |= diff_str("source", a->server.default_source,
+				    b->server.default_source);
+		break;
+	case PA_SUBSCRIPTION_EVENT_CLIENT:
+		changed |= diff_str("name", a->client.name, b->client.name);
+		break;
+	case PA_SUBSCRIPTION_EVENT_MODULE:
+		changed |= diff_str("name", a->module.name, b->module.name);
+		changed |= diff_str("argument", a->module.argument,
+				    b->module.argument);
+		break;
 	default:
 		break;
 	}
+	return changed;
+}
+
+// facilities with an introspection request, and so a mirror
+static bool mirrored(int fac) {
+	switch (fac) {
+	case PA_SUBSCRIPTION_EVENT_SINK:
+	case PA_SUBSCRIPTION_EVENT_SOURCE:
+	case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+	case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+	case PA_SUBSCRIPTION_EVENT_CARD:
+	case PA_SUBSCRIPTION_EVENT_SERVER:
+	case PA_SUBSCRIPTION_EVENT_CLIENT:
+	case PA_SUBSCRIPTION_EVENT_MODULE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// the reply is complete: nothing writes ev any more. New objects print
+// their full state, changes only the fields that differ from the
+// mirror, removes the name the object was last known by
+static void process_event(struct event *ev) {
+	int fac = ev->facility;
+	int typ = ev->type;
+	bool ok = ev->s.success;
+	uint32_t key = ev->idx;
+	if (fac == PA_SUBSCRIPTION_EVENT_SERVER)
+		key = PA_INVALID_INDEX;
+
+	print_time(&ev->ts);
+	printf(" %-6s %-13s ", type_str(typ), facility_str(fac));
+	print_idx(ev->idx);
+
+	if (mirrored(fac)) {
+		struct object **slot = mirror_slot(fac, key);
+		struct object *obj = *slot;
+
+		if (typ == PA_SUBSCRIPTION_EVENT_REMOVE) {
+			if (obj) {
+				print_label(fac, &obj->d);
+				mirror_drop(slot);
+			} else {
+				printf(" (deleted)");
+			}
+		} else if (!ok) {
+			// gone before the query, its remove event follows
+			if (fac == PA_SUBSCRIPTION_EVENT_SERVER) {
+				printf(" (query failed)");
+			} else {
+				if (obj)
+					print_label(fac, &obj->d);
+				printf(" (deleted)");
+			}
+		} else if (typ == PA_SUBSCRIPTION_EVENT_NEW || !obj) {
+			print_label(fac, &ev->d);
+			print_fields(fac, &ev->d);
+			mirror_put(fac, key, &ev->d);
+		} else {
+			print_label(fac, &ev->d);
+			if (!print_diff(fac, &obj->d, &ev->d))
+				printf(" (unchanged)");
+			obj->d = ev->d;
+		}
+	}
 
+	if (ev->repeat > 1)
+		printf(" (x%u)", ev->repeat);
 	printf("\n");
 	fflush(stdout);
 }
@@ -763,9 +1083,63 @@ static void sighandler(int signo) {
 	pthread_cond_signal(&ev_cond);
 }
 
+static void free_events(struct event *ev) {
+	while (ev) {
+		struct event *next = ev->next;
+		free(ev);
+		ev = next;
+	}
+}
+
 // main
 
-int main(void) {
+static void usage(const char *prog) {
+	printf("Usage: %s [-w MS]\n\n", prog);
+	printf("  -w MS  Fold change events of one object within MS "
+	       "milliseconds into one\n"
+	       "         line with a repeat count, 0 to print every event "
+	       "(default: %d)\n",
+	       DEFAULT_WINDOW_MS);
+	printf("  -h     Show this help message\n");
+}
+
+static int parse_args(int argc, char **argv) {
+	int opt;
+	while ((opt = getopt(argc, argv, "w:h")) != -1) {
+		switch (opt) {
+		case 'w': {
+			char *end;
+			long ms = strtol(optarg, &end, 10);
+			if (*optarg == '\0' || *end != '\0' || ms < 0 ||
+			    ms > 60000) {
+				fprintf(stderr, "error: invalid window '%s'\n",
+					optarg);
+				return -1;
+			}
+			window_ns = (uint64_t) ms * 1000000ULL;
+			break;
+		}
+		case 'h':
+			usage(argv[0]);
+			exit(0);
+		default:
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if (parse_args(argc, argv) < 0)
+		return 1;
+
+	pthread_condattr_t cond_attr;
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&ev_cond, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
+
 	signal(SIGINT, sighandler);
 	signal(SIGTERM, sighandler);
 
@@ -826,28 +1200,43 @@ int main(void) {
 		return 1;
 	}
 
+	seed();
+
 	fprintf(stderr, "PulseAudio event monitor, more details than pactl "
 			"subscribe. ^C to quit.\n");
 
+	// coalesce new events, queue them into the pipeline as soon as
+	// there is room, print completed ones from its head
 	while (!quit) {
 		pthread_mutex_lock(&ev_mtx);
-		while (!ev_head && !quit)
-			pthread_cond_wait(&ev_cond, &ev_mtx);
+		while (!work_ready(now_ns()) && !quit)
+			wait_work();
 		if (quit) {
 			pthread_mutex_unlock(&ev_mtx);
 			break;
 		}
-		struct event *ev = ev_head;
-		ev_head = ev->next;
-		if (!ev_head)
-			ev_tail = NULL;
+		struct ev_list in = incoming;
+		incoming.head = incoming.tail = NULL;
+		struct ev_list done = {0};
+		while (pending.head && pending.head->s.done) {
+			list_push(&done, list_pop(&pending));
+			n_pending--;
+		}
 		pthread_mutex_unlock(&ev_mtx);
 
-		ev->next = NULL;
-		process_event(ev);
-		free(ev);
+		uint64_t now = now_ns();
+		struct event *ev;
+		while ((ev = list_pop(&in)))
+			coalesce(ev, now);
+		flush_held(now);
+		query_queued();
+
+		for (ev = done.head; ev; ev = ev->next)
+			process_event(ev);
+		free_events(done.head);
 	}
 
+	// outstanding requests are cancelled without their callbacks
 	pa_threaded_mainloop_lock(mainloop);
 	pa_context_disconnect(context);
 	pa_context_unref(context);
@@ -857,13 +1246,12 @@ int main(void) {
 
 	// free any remaining events
 	pthread_mutex_lock(&ev_mtx);
-	struct event *ev = ev_head;
-	while (ev) {
-		struct event *next = ev->next;
-		free(ev);
-		ev = next;
-	}
+	free_events(incoming.head);
+	free_events(pending.head);
 	pthread_mutex_unlock(&ev_mtx);
+	free_events(held.head);
+	free_events(queued.head);
+	mirror_free();
 
 	fprintf(stderr, "stopped\n");
 	return 0;